@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <vulkan_helper.hpp>
+
+namespace vulkan_start {
+
+using namespace vulkan_hpp_helper;
+
+// heap allocations the calling thread made so far, only counted when the
+// executable is built with VULKAN_START_COUNT_ALLOCATIONS, which replaces
+// the global operator new
+extern constinit thread_local uint64_t heap_allocation_count;
+
+// throws if a frame after the first `warmup` ones allocates on the heap,
+// frames that recreated the swapchain are expected to allocate. only the
+// thread that draws is counted, the event thread, job system workers and
+// capture writer allocate as they like
+template<class T>
+class add_frame_allocation_check : public T{
+public:
+    using parent = T;
+    static constexpr uint64_t warmup = 16;
+    add_frame_allocation_check(const configure auto& conf) : parent{conf},
+        m_frame_index{}{
+    }
+    void draw() {
+#ifdef VULKAN_START_COUNT_ALLOCATIONS
+        vk::SwapchainKHR swapchain = parent::get_swapchain();
+        uint64_t before = heap_allocation_count;
+        parent::draw();
+        uint64_t count = heap_allocation_count - before;
+        if (m_frame_index >= warmup && count != 0 &&
+            swapchain == parent::get_swapchain()) {
+            throw std::runtime_error{"frame " + std::to_string(m_frame_index) +
+                " made " + std::to_string(count) + " heap allocations"};
+        }
+#else
+        parent::draw();
+#endif
+        m_frame_index++;
+    }
+private:
+    uint64_t m_frame_index;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,133 @@
+#define VK_USE_PLATFORM_WAYLAND_KHR
+
+#include "cube.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+
+// wayland, or with --headless a surface that shows nothing, for machines
+// without a compositor
+template <vulkan_start::platform PLATFORM>
+using draw_cube_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_physical_device_and_device_and_draw<PLATFORM>::
+        template add_cube_physical_device_and_device_and_draw
+	>
+	;
+template <vulkan_start::platform PLATFORM>
+using draw_mesh_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_mesh_physical_device_and_device_and_draw<PLATFORM>::
+        template add_mesh_physical_device_and_device_and_draw
+	>
+	;
+
+struct sweep_configure : vulkan_start::present_configure, vulkan_start::clock_configure,
+                         vulkan_start::benchmark_configure {};
+
+// geometry copies, indexed triangles for the cube and mesh shader lines
+// for the helix
+constexpr auto instance_counts = std::array<uint32_t, 4>{1, 16, 256, 4096};
+constexpr auto extents = std::array{
+    vk::Extent2D{640, 480}, vk::Extent2D{1280, 720}, vk::Extent2D{1920, 1080}};
+constexpr auto image_counts = std::array<uint32_t, 3>{2, 3, 4};
+
+// one run of N frames per configuration, each appends a row to the csv.
+// the clock steps by a fixed amount so every run draws the same frames;
+// immediate present and no frame pacing let the device set the rate. a
+// configuration that fails, e.g. mesh shaders on a device without them, is
+// logged and skipped
+template <class APP>
+void sweep(const char* label, sweep_configure conf) {
+  conf.benchmark_label = label;
+  for (auto instance_count : instance_counts) {
+    for (auto extent : extents) {
+      for (auto image_count : image_counts) {
+        conf.draw_instance_count = instance_count;
+        conf.image_width = extent.width;
+        conf.image_height = extent.height;
+        conf.image_count = image_count;
+        std::clog << label << " " << instance_count << " instances " << extent.width << "x"
+                  << extent.height << " " << image_count << " images" << std::endl;
+        try {
+          APP app{conf};
+        } catch (vulkan_start::run_finished&) {
+        } catch (std::exception& e) {
+          std::cerr << label << ": " << e.what() << std::endl;
+        }
+      }
+    }
+  }
+}
+
+template <vulkan_start::platform PLATFORM>
+void sweep_apps(bool cube, bool mesh, const sweep_configure& conf) {
+  if (cube)
+  {
+    sweep<draw_cube_app<PLATFORM>>("cube", conf);
+  }
+  if (mesh)
+  {
+    sweep<draw_mesh_app<PLATFORM>>("mesh", conf);
+  }
+}
+
+int main(int argc, const char* argv[]) {
+  try {
+    auto conf = sweep_configure{};
+    conf.benchmark_csv = "benchmark.csv";
+    conf.present_mode = vk::PresentModeKHR::eImmediate;
+    conf.frame_pacing = false;
+    conf.clock = vulkan_start::clock_mode::fixed_step;
+    conf.frame_limit = 300;
+    conf.warmup_frames = 60;
+    bool cube = true;
+    bool mesh = true;
+    bool headless = false;
+    for (int i = 1; i < argc; i++)
+    {
+      auto arg = std::string_view{argv[i]};
+      if (arg.starts_with("--frames="))
+      {
+        conf.frame_limit = std::stoull(std::string{arg.substr(arg.find('=') + 1)});
+      }
+      else if (arg.starts_with("--warmup="))
+      {
+        conf.warmup_frames = std::stoull(std::string{arg.substr(arg.find('=') + 1)});
+      }
+      else if (arg == "--cube-only")
+      {
+        mesh = false;
+      }
+      else if (arg == "--mesh-only")
+      {
+        cube = false;
+      }
+      else if (arg == "--headless")
+      {
+        headless = true;
+      }
+      else
+      {
+        conf.benchmark_csv = arg;
+      }
+    }
+    if (conf.frame_limit <= conf.warmup_frames)
+    {
+      throw std::runtime_error{"--frames must be more than --warmup"};
+    }
+    if (headless)
+    {
+      sweep_apps<vulkan_start::platform::headless>(cube, mesh, conf);
+    }
+    else
+    {
+      sweep_apps<vulkan_start::platform::wayland>(cube, mesh, conf);
+    }
+  } catch (std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
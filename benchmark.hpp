@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "memory.hpp"
+#include "vulkan_start.hpp"
+
+namespace vulkan_start {
+
+// workload and report settings of the benchmark, mixed into the app's
+// configure object
+struct benchmark_configure {
+    // add_draw_instance_count draws the geometry this many times per frame
+    uint32_t draw_instance_count = 1;
+    // add_frame_timing appends one row per run to this csv file
+    std::string benchmark_csv;
+    // first column of the row
+    std::string benchmark_label;
+    // frames before the measurement starts
+    uint64_t warmup_frames = 30;
+};
+
+// copies of the geometry drawn per frame. they share one transform and
+// overlap, which scales the vertex and primitive work without touching the
+// shaders
+template <class T> class add_draw_instance_count : public T {
+public:
+  using parent = T;
+  add_draw_instance_count(const configure auto& conf) : parent{conf}, m_count{1} {
+    if constexpr (requires { conf.draw_instance_count; }) {
+      m_count = std::max(conf.draw_instance_count, 1u);
+    }
+  }
+  uint32_t get_draw_instance_count() { return m_count; }
+
+private:
+  uint32_t m_count;
+};
+
+template <class T>
+concept frame_timed = requires(T t, uint32_t index, std::chrono::nanoseconds time) {
+  { t.begin_frame_timing(index) } -> std::same_as<std::array<vk::CommandBuffer, 2>>;
+  t.end_frame_timing(time);
+};
+
+// measures a run for the benchmark: cpu submit time, which add_dynamic_draw
+// takes from the frame data upload to the end of the submit, gpu time from
+// timestamps written by two small command buffers submitted around the
+// draw, from the acquired image being ready to the end of the frame, and
+// the frame and primitive rate. the timestamps of an image are
+// read once its fence signalled, when add_dynamic_draw reuses the image, so
+// nothing waits for them. the row is written when the app ends, with the
+// device memory of add_memory_statistics when the stack has it; without
+// benchmark_csv the layer does nothing
+template <class T> class add_frame_timing : public T {
+public:
+  using parent = T;
+  add_frame_timing(const configure auto& conf)
+      : parent{conf}, m_enabled{false}, m_warmup_frames{0}, m_frame{0},
+        m_timestamp_valid_bits{0}, m_timestamp_period{0}, m_submit_index{0},
+        m_measure_start{std::chrono::steady_clock::now()}, m_measure_end{},
+        m_measured_frames{0}, m_cpu_total{}, m_cpu_max{}, m_gpu_total{}, m_gpu_max{},
+        m_gpu_frames{0} {
+    if constexpr (requires { conf.benchmark_csv; conf.benchmark_label; conf.warmup_frames; }) {
+      if (!conf.benchmark_csv.empty()) {
+        m_enabled = true;
+        m_csv_path = conf.benchmark_csv;
+        m_label = conf.benchmark_label;
+        m_warmup_frames = conf.warmup_frames;
+        vk::PhysicalDevice physical_device = parent::get_physical_device();
+        m_timestamp_period = physical_device.getProperties().limits.timestampPeriod;
+        auto families = physical_device.getQueueFamilyProperties();
+        m_timestamp_valid_bits = families.at(parent::get_queue_family_index()).timestampValidBits;
+        if (m_timestamp_valid_bits == 0) {
+          std::clog << "queue has no timestamps, gpu time is not measured" << std::endl;
+        }
+        m_command_pool = parent::get_device().createCommandPool(
+            vk::CommandPoolCreateInfo{}.setQueueFamilyIndex(parent::get_queue_family_index()));
+        create(get_image_count());
+      }
+    }
+  }
+  ~add_frame_timing() {
+    if (!m_enabled) {
+      return;
+    }
+    // add_dynamic_draw waited for the queue, every timestamp is written
+    for (uint32_t i = 0; i < m_pending.size(); i++) {
+      collect(i);
+    }
+    try {
+      write_row();
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    destroy();
+    parent::get_device().destroyCommandPool(m_command_pool);
+  }
+  // the query pool and command buffers follow the swapchain. a new one can
+  // reuse the old handle, so they are made again on every recreate, once
+  // the queue is idle and the pending timestamps are read
+  void recreate_surface() {
+    parent::recreate_surface();
+    if (!m_enabled) {
+      return;
+    }
+    for (uint32_t i = 0; i < m_pending.size(); i++) {
+      collect(i);
+    }
+    destroy();
+    create(get_image_count());
+  }
+  // called after the image's fence wait, returns the command buffers to
+  // submit before and after the draw, null when nothing is timed
+  std::array<vk::CommandBuffer, 2> begin_frame_timing(uint32_t index) {
+    if (!m_enabled) {
+      return {};
+    }
+    collect(index);
+    m_submit_index = index;
+    if (m_timestamp_valid_bits == 0 || m_frame < m_warmup_frames) {
+      return {};
+    }
+    return {m_begin_command_buffers[index], m_end_command_buffers[index]};
+  }
+  void end_frame_timing(std::chrono::nanoseconds cpu_submit_time) {
+    if (!m_enabled) {
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (m_frame++ < m_warmup_frames) {
+      m_measure_start = now;
+      return;
+    }
+    m_pending[m_submit_index] = m_timestamp_valid_bits != 0;
+    m_measure_end = now;
+    m_measured_frames++;
+    m_cpu_total += cpu_submit_time;
+    m_cpu_max = std::max(m_cpu_max, cpu_submit_time);
+  }
+
+private:
+  uint32_t get_image_count() {
+    return parent::get_device().getSwapchainImagesKHR(parent::get_swapchain()).size();
+  }
+  void create(uint32_t image_count) {
+    vk::Device device = parent::get_device();
+    m_pending.assign(image_count, false);
+    if (m_timestamp_valid_bits == 0) {
+      return;
+    }
+    m_query_pool = device.createQueryPool(vk::QueryPoolCreateInfo{}
+                                              .setQueryType(vk::QueryType::eTimestamp)
+                                              .setQueryCount(2 * image_count));
+    auto allocate_info = vk::CommandBufferAllocateInfo{}
+                             .setCommandPool(m_command_pool)
+                             .setCommandBufferCount(image_count);
+    m_begin_command_buffers = device.allocateCommandBuffers(allocate_info);
+    m_end_command_buffers = device.allocateCommandBuffers(allocate_info);
+    for (uint32_t i = 0; i < image_count; i++) {
+      vk::CommandBuffer begin = m_begin_command_buffers[i];
+      begin.begin(vk::CommandBufferBeginInfo{});
+      begin.resetQueryPool(m_query_pool, 2 * i, 2);
+      // the submit waits for the acquire at this stage, at the top of the
+      // pipe the gpu time would include the wait for the image
+      begin.writeTimestamp(vk::PipelineStageFlagBits::eColorAttachmentOutput, m_query_pool,
+                           2 * i);
+      begin.end();
+      vk::CommandBuffer end = m_end_command_buffers[i];
+      end.begin(vk::CommandBufferBeginInfo{});
+      end.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_query_pool, 2 * i + 1);
+      end.end();
+    }
+  }
+  void destroy() {
+    if (!m_query_pool) {
+      return;
+    }
+    vk::Device device = parent::get_device();
+    device.freeCommandBuffers(m_command_pool, m_begin_command_buffers);
+    device.freeCommandBuffers(m_command_pool, m_end_command_buffers);
+    device.destroyQueryPool(m_query_pool);
+    m_query_pool = nullptr;
+  }
+  void collect(uint32_t index) {
+    if (!m_pending[index]) {
+      return;
+    }
+    m_pending[index] = false;
+    std::array<uint64_t, 2> stamps{};
+    vk::Result res = parent::get_device().getQueryPoolResults(
+        m_query_pool, 2 * index, 2, sizeof(stamps), stamps.data(), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64);
+    if (res != vk::Result::eSuccess) {
+      return;
+    }
+    uint64_t mask = m_timestamp_valid_bits >= 64 ? ~uint64_t{0}
+                                                 : (uint64_t{1} << m_timestamp_valid_bits) - 1;
+    uint64_t ticks = (stamps[1] - stamps[0]) & mask;
+    auto time = std::chrono::nanoseconds{static_cast<int64_t>(ticks * double(m_timestamp_period))};
+    m_gpu_total += time;
+    m_gpu_max = std::max(m_gpu_max, time);
+    m_gpu_frames++;
+  }
+  void write_row() {
+    std::ofstream csv{m_csv_path, std::ios::app};
+    if (!csv) {
+      throw std::runtime_error{"failed to open " + m_csv_path};
+    }
+    if (csv.tellp() == 0) {
+      csv << "label,width,height,images,instances,primitives_per_frame,frames,"
+             "frames_per_s,primitives_per_s,cpu_submit_mean_us,cpu_submit_max_us,"
+             "gpu_mean_us,gpu_max_us,memory_bytes,memory_allocations,heap_budget_bytes,"
+             "heap_usage_bytes\n";
+    }
+    auto us = [](std::chrono::nanoseconds t) { return t.count() / 1000.0; };
+    auto seconds = std::chrono::duration<double>{m_measure_end - m_measure_start}.count();
+    // from the end of the warm-up to the last submit
+    double frames_per_s = seconds > 0 ? m_measured_frames / seconds : 0;
+    uint64_t primitives = 0;
+    if constexpr (requires { parent::get_primitive_count(); }) {
+      primitives = parent::get_primitive_count();
+    }
+    uint32_t instances = 1;
+    if constexpr (requires { parent::get_draw_instance_count(); }) {
+      instances = parent::get_draw_instance_count();
+    }
+    vk::Extent2D extent = parent::get_swapchain_image_extent();
+    csv << m_label << ',' << extent.width << ',' << extent.height << ','
+        << m_pending.size() << ',' << instances << ',' << primitives << ','
+        << m_measured_frames << ',' << frames_per_s << ',' << primitives * frames_per_s << ','
+        << (m_measured_frames ? us(m_cpu_total / m_measured_frames) : 0) << ','
+        << us(m_cpu_max) << ',';
+    if (m_gpu_frames > 0) {
+      csv << us(m_gpu_total / m_gpu_frames) << ',' << us(m_gpu_max);
+    } else {
+      csv << ',';
+    }
+    // device memory at the end of the run, budget and usage summed over
+    // the heaps
+    if constexpr (requires { parent::get_memory_snapshot(); }) {
+      memory_snapshot memory = parent::get_memory_snapshot();
+      vk::DeviceSize budget = 0;
+      vk::DeviceSize usage = 0;
+      for (auto& heap : memory.heaps) {
+        budget += heap.budget;
+        usage += heap.usage;
+      }
+      csv << ',' << memory.total.bytes << ',' << memory.total.allocations << ',' << budget << ','
+          << usage;
+    } else {
+      csv << ",,,,";
+    }
+    csv << '\n';
+  }
+
+  bool m_enabled;
+  std::string m_csv_path;
+  std::string m_label;
+  uint64_t m_warmup_frames;
+  uint64_t m_frame;
+  uint32_t m_timestamp_valid_bits;
+  float m_timestamp_period;
+  vk::CommandPool m_command_pool;
+  vk::QueryPool m_query_pool;
+  std::vector<vk::CommandBuffer> m_begin_command_buffers;
+  std::vector<vk::CommandBuffer> m_end_command_buffers;
+  // images whose timestamps were submitted and not read yet
+  std::vector<bool> m_pending;
+  uint32_t m_submit_index;
+  std::chrono::steady_clock::time_point m_measure_start;
+  std::chrono::steady_clock::time_point m_measure_end;
+  uint64_t m_measured_frames;
+  std::chrono::nanoseconds m_cpu_total;
+  std::chrono::nanoseconds m_cpu_max;
+  std::chrono::nanoseconds m_gpu_total;
+  std::chrono::nanoseconds m_gpu_max;
+  uint64_t m_gpu_frames;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,437 @@
+#pragma once
+
+#include "gpu_driven.hpp"
+
+namespace vulkan_start {
+
+// throws while the stack is built when the device can't index a partially
+// bound storage buffer array with a push constant, as
+// shaders/cube_bindless.vert does
+template <class T> class check_bindless_support : public T {
+public:
+  using parent = T;
+  check_bindless_support(const configure auto& conf) : parent{conf} {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    auto features = physical_device.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    auto& features2 = features.get<vk::PhysicalDeviceFeatures2>();
+    auto& vulkan12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+    if (!features2.features.shaderStorageBufferArrayDynamicIndexing ||
+        !vulkan12.descriptorIndexing || !vulkan12.runtimeDescriptorArray ||
+        !vulkan12.descriptorBindingPartiallyBound ||
+        !vulkan12.descriptorBindingStorageBufferUpdateAfterBind ||
+        !vulkan12.descriptorBindingUpdateUnusedWhilePending) {
+      throw std::runtime_error{"device does not support bindless storage buffers"};
+    }
+  }
+};
+
+// matches the push constant block in shaders/cube_bindless.vert
+struct bindless_constants {
+    uint32_t object_buffer;
+};
+
+// one descriptor set for every storage buffer of the app: a partially bound
+// array of CAPACITY storage buffer descriptors that can be written while
+// command buffers using the set are pending. draws select their buffers by
+// index, so the set is bound once per command buffer and adding a buffer
+// only writes its slot
+template <uint32_t CAPACITY, class T> class add_bindless_descriptor_set_layout : public T {
+public:
+  using parent = T;
+  add_bindless_descriptor_set_layout(const configure auto& conf) : parent{conf} {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    auto properties = physical_device.getProperties2<
+        vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+    auto& vulkan12 = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+    if (vulkan12.maxPerStageDescriptorUpdateAfterBindStorageBuffers < CAPACITY ||
+        vulkan12.maxDescriptorSetUpdateAfterBindStorageBuffers < CAPACITY) {
+      throw std::runtime_error{"device can't bind " + std::to_string(CAPACITY) +
+                               " update after bind storage buffers"};
+    }
+    vk::Device device = parent::get_device();
+    auto binding = vk::DescriptorSetLayoutBinding{}
+                       .setBinding(0)
+                       .setDescriptorCount(CAPACITY)
+                       .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                       .setStageFlags(vk::ShaderStageFlagBits::eVertex);
+    vk::DescriptorBindingFlags binding_flags =
+        vk::DescriptorBindingFlagBits::ePartiallyBound |
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+        vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+    auto binding_flags_info =
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo{}.setBindingFlags(binding_flags);
+    m_layout = device.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo{}
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+            .setBindings(binding)
+            .setPNext(&binding_flags_info));
+  }
+  ~add_bindless_descriptor_set_layout() {
+    vk::Device device = parent::get_device();
+    device.destroyDescriptorSetLayout(m_layout);
+  }
+  auto get_descriptor_set_layout() { return m_layout; }
+  uint32_t get_bindless_capacity() { return CAPACITY; }
+
+private:
+  vk::DescriptorSetLayout m_layout;
+};
+
+// the bindless set and the constants every draw's shaders read
+template <class T> class add_bindless_pipeline_layout : public T {
+public:
+  using parent = T;
+  add_bindless_pipeline_layout(const configure auto& conf) : parent{conf} {
+    vk::Device device = parent::get_device();
+    vk::DescriptorSetLayout set_layout = parent::get_descriptor_set_layout();
+    auto push_constant_range = vk::PushConstantRange{}
+                                   .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+                                   .setOffset(0)
+                                   .setSize(sizeof(bindless_constants));
+    m_layout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo{}
+            .setSetLayouts(set_layout)
+            .setPushConstantRanges(push_constant_range));
+  }
+  ~add_bindless_pipeline_layout() {
+    vk::Device device = parent::get_device();
+    device.destroyPipelineLayout(m_layout);
+  }
+  auto get_pipeline_layout() { return m_layout; }
+
+private:
+  vk::PipelineLayout m_layout;
+};
+
+// allocates the bindless set and hands out its slots. slots are never
+// reused, a slot that was not written is never read thanks to partial
+// binding
+template <class T> class add_bindless_descriptor_set : public T {
+public:
+  using parent = T;
+  add_bindless_descriptor_set(const configure auto& conf) : parent{conf}, m_next_slot{0} {
+    vk::Device device = parent::get_device();
+    auto pool_size = vk::DescriptorPoolSize{}
+                         .setDescriptorCount(parent::get_bindless_capacity())
+                         .setType(vk::DescriptorType::eStorageBuffer);
+    m_pool = device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo{}
+            .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
+            .setMaxSets(1)
+            .setPoolSizes(pool_size));
+    vk::DescriptorSetLayout layout = parent::get_descriptor_set_layout();
+    m_set = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{}
+                                              .setDescriptorPool(m_pool)
+                                              .setSetLayouts(layout))[0];
+  }
+  ~add_bindless_descriptor_set() {
+    vk::Device device = parent::get_device();
+    device.destroyDescriptorPool(m_pool);
+  }
+  // writes the buffer into the next free slot and returns its index
+  uint32_t add_bindless_storage_buffer(vk::Buffer buffer) {
+    if (m_next_slot == parent::get_bindless_capacity()) {
+      throw std::runtime_error{"bindless descriptor set is full"};
+    }
+    set_bindless_storage_buffer(m_next_slot, buffer);
+    return m_next_slot++;
+  }
+  // points a slot handed out before at another buffer
+  void set_bindless_storage_buffer(uint32_t slot, vk::Buffer buffer) {
+    vk::Device device = parent::get_device();
+    auto buffer_info =
+        vk::DescriptorBufferInfo{}.setBuffer(buffer).setRange(vk::WholeSize);
+    device.updateDescriptorSets(vk::WriteDescriptorSet{}
+                                    .setDstSet(m_set)
+                                    .setDstBinding(0)
+                                    .setDstArrayElement(slot)
+                                    .setDescriptorCount(1)
+                                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                                    .setBufferInfo(buffer_info),
+                                {});
+  }
+  auto get_bindless_descriptor_set() { return m_set; }
+
+private:
+  vk::DescriptorPool m_pool;
+  vk::DescriptorSet m_set;
+  uint32_t m_next_slot;
+};
+
+// slots of the per swapchain image object buffers. the buffers are
+// recreated with the swapchain, their slots are kept and rewritten, and
+// only images beyond the slots' count take new ones
+template <class T> class add_object_buffers_to_bindless_set : public T {
+public:
+  using parent = T;
+  add_object_buffers_to_bindless_set(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    std::vector<vk::Buffer> buffers = parent::get_object_buffer_vector();
+    for (uint32_t i = 0; i < buffers.size(); i++) {
+      if (i < m_slots.size()) {
+        parent::set_bindless_storage_buffer(m_slots[i], buffers[i]);
+      } else {
+        m_slots.push_back(parent::add_bindless_storage_buffer(buffers[i]));
+      }
+    }
+  }
+  void destroy() {}
+  const auto& get_object_buffer_slots() { return m_slots; }
+
+private:
+  std::vector<uint32_t> m_slots;
+};
+
+template<>
+class use_app<app::cube_bindless> {
+public:
+
+// recorded once per image: the set is bound once, the image's object buffer
+// slot is pushed once and every object is a draw whose first instance is
+// its index, the same draws an indirect buffer would hold
+template <class T> class record_swapchain_command_buffers : public T {
+public:
+  using parent = T;
+  record_swapchain_command_buffers(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    auto buffers = parent::get_swapchain_command_buffers();
+    auto swapchain_images = parent::get_swapchain_images();
+    auto framebuffers = parent::get_framebuffers();
+    vk::DescriptorSet descriptor_set = parent::get_bindless_descriptor_set();
+    auto object_buffer_slots = parent::get_object_buffer_slots();
+    uint32_t object_count = parent::get_object_count();
+    uint32_t index_count = 3 * 2 * 3 * 2;
+
+    auto clear_values = get_clear_values(this);
+
+    if (buffers.size() != swapchain_images.size()) {
+      throw std::runtime_error{
+          "swapchain images count != command buffers count"};
+    }
+    if (object_buffer_slots.size() < buffers.size()) {
+      throw std::runtime_error{"swapchain images count > object buffers count"};
+    }
+    for (uint32_t index = 0; index < buffers.size(); index++) {
+      vk::CommandBuffer cmd = buffers[index];
+
+      cmd.begin(vk::CommandBufferBeginInfo{});
+
+      vk::RenderPass render_pass = parent::get_render_pass();
+      vk::Extent2D swapchain_image_extent =
+          parent::get_swapchain_image_extent();
+      auto render_area = vk::Rect2D{}
+                             .setOffset(vk::Offset2D{0, 0})
+                             .setExtent(swapchain_image_extent);
+      cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                              .setRenderPass(render_pass)
+                              .setRenderArea(render_area)
+                              .setFramebuffer(framebuffers[index])
+                              .setClearValues(clear_values),
+                          vk::SubpassContents::eInline);
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, parent::get_pipeline());
+      vk::Buffer vertex_buffer = parent::get_vertex_buffer();
+      cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+      vk::Buffer index_buffer = parent::get_index_buffer();
+      cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
+
+      vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+      cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                             0, descriptor_set, {});
+      auto constants = bindless_constants{.object_buffer = object_buffer_slots[index]};
+      cmd.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eVertex,
+                        0, sizeof(constants), &constants);
+      for (uint32_t i = 0; i < object_count; i++) {
+        cmd.drawIndexed(index_count, 1, 0, 0, i);
+      }
+      cmd.endRenderPass();
+      cmd.end();
+    }
+  }
+  void destroy() {}
+}; // class record_swapchain_command_buffers in use_app<app::cube_bindless>
+
+template <class T>
+class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
+};
+
+template <class T> class add_resources_and_draw
+  : public
+    profiled<
+    add_frame_allocation_check<
+    add_frame_time_analyser<
+    add_dynamic_draw <
+    add_process_suboptimal_image<
+        decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_queue_wait_idle_to_recreate_surface<
+    add_recreate_surface_for<
+    add_object_buffer_upload <
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_clock <
+    add_acquire_next_image_semaphores <
+    add_acquire_next_image_semaphore_fences <
+    add_draw_semaphores <
+    add_recreate_surface_for<
+    vulkan_start::use_app<vulkan_start::app::cube_bindless>::record_swapchain_command_buffers<
+    add_get_format_clear_color_value_type <
+    add_recreate_surface_for<
+    add_swapchain_command_buffers <
+    add_recreate_surface_for<
+    add_object_buffers_to_bindless_set<
+    add_bindless_descriptor_set<
+    add_buffer_memory_with_data_copy<
+    rename_buffer_to_index_buffer<
+    add_buffer_as_member<
+    set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
+    add_optimized_cube_index_buffer_data<
+    rename_buffer_vector_to_object_buffer_vector <
+    rename_buffer_memory_vector_to_object_buffer_memory_vector<
+    rename_buffer_memory_ptr_vector_to_object_buffer_memory_ptr_vector<
+    add_recreate_surface_for<
+    map_buffer_memory_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties < vk::MemoryPropertyFlagBits::eHostVisible,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count<
+    set_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    set_buffer_size_to_object_matrices<
+    add_buffer_memory_with_data_copy <
+    rename_buffer_to_vertex_buffer<
+    add_buffer_as_member <
+    set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
+    add_optimized_cube_vertex_buffer_data <
+    add_recreate_surface_for<
+    add_graphics_pipeline <
+    add_pipeline_vertex_input_state <
+    add_vertex_binding_description <
+    add_empty_binding_descriptions <
+    add_vertex_attribute_description <
+    set_vertex_input_attribute_format<vk::Format::eR16G16B16A16Snorm,
+    add_empty_vertex_attribute_descriptions <
+    set_binding < 0,
+    set_stride < sizeof(int16_t) * 4,
+    set_input_rate < vk::VertexInputRate::eVertex,
+    set_subpass < 0,
+    add_recreate_surface_for<
+    add_framebuffers_cube <
+    add_render_pass_cube <
+    add_subpasses <
+    add_subpass_dependency <
+    add_empty_subpass_dependencies <
+    add_depth_attachment<
+    add_attachment <
+    add_empty_attachments <
+    add_pipeline_viewport_state <
+    add_scissor_equal_swapchain_extent<
+    add_empty_scissors <
+    add_viewport_equal_swapchain_image_rect <
+    add_empty_viewports <
+    set_tessellation_patch_control_point_count < 1,
+    set_object_count < 1024,
+    T
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+{};
+}; // class use_app<app::cube_bindless>
+
+template <class T> class add_bindless_swapchain_and_pipeline_layout
+  : public
+  profiled<
+  add_bindless_pipeline_layout<
+	add_bindless_descriptor_set_layout< 4096,
+	set_pipeline_rasterization_polygon_mode< vk::PolygonMode::eFill,
+	disable_pipeline_multisample<
+	set_pipeline_input_topology< vk::PrimitiveTopology::eTriangleList,
+	disable_pipeline_dynamic<
+	enable_pipeline_depth_test<
+	add_pipeline_color_blend_state_create_info<
+	disable_pipeline_attachment_color_blend< 0, // disable index 0 attachment
+	add_pipeline_color_blend_attachment_states< 1, // 1 attachment
+	rename_images_views_to_depth_images_views<
+	add_recreate_surface_for<
+	barrier_depth_image_layout<
+	add_recreate_surface_for<
+	add_depth_images_views_cube<
+	add_recreate_surface_for<
+	add_images_memories<
+	add_image_memory_property<vk::MemoryPropertyFlagBits::eDeviceLocal,
+	add_empty_image_memory_properties<
+	add_recreate_surface_for<
+	add_images<
+	add_image_type<vk::ImageType::e2D,
+	set_image_tiling<vk::ImageTiling::eOptimal,
+	set_image_samples<vk::SampleCountFlagBits::e1,
+	add_image_extent_equal_swapchain_image_extent<
+	add_image_usage<vk::ImageUsageFlagBits::eDepthStencilAttachment,
+	add_empty_image_usages<
+	rename_image_format_to_depth_image_format<
+	add_image_format<vk::Format::eD32Sfloat,
+	add_image_count_equal_swapchain_image_count<
+	add_recreate_surface_for<
+	add_swapchain_images_views<
+	add_recreate_surface_for<
+	add_swapchain_images<
+	add_recreate_surface_for<
+	add_configured_swapchain<
+	add_swapchain_image_format<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+{};
+
+template<platform PLATFORM>
+class use_platform_add_cube_bindless_physical_device_and_device_and_draw {
+public:
+template<class T>
+class add_cube_bindless_physical_device_and_device_and_draw
+    : public
+    profiled<
+    use_app<app::cube_bindless>::add_resources_and_draw<
+	add_bindless_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+    add_deferred_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_bindless_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
+    add_deferred_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
+	add_empty_pipeline_stages <
+	add_job_system <
+	add_command_pool <
+	add_queue <
+	add_device_with_features <
+        decltype(
+            []() {
+                auto features = vk::StructureChain<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceVulkan12Features
+                >{};
+                auto& [features2, vulkan12_features] = features;
+                features2.features.shaderStorageBufferArrayDynamicIndexing = vk::True;
+                vulkan12_features.descriptorIndexing = vk::True;
+                vulkan12_features.runtimeDescriptorArray = vk::True;
+                vulkan12_features.descriptorBindingPartiallyBound = vk::True;
+                vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = vk::True;
+                vulkan12_features.descriptorBindingUpdateUnusedWhilePending = vk::True;
+                return features;
+            }
+        )
+        ,
+	add_swapchain_extension <
+	add_empty_extensions <
+	check_bindless_support <
+	add_find_properties <
+	cache_physical_device_memory_properties<
+	add_recreate_surface_for<
+	cache_surface_capabilities<
+	add_recreate_surface_for<
+	test_physical_device_support_surface<
+	add_queue_family_index <
+  typename set_app_and_platform<app::cube_bindless, PLATFORM>::template add_physical_device_and_surface<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>
+{};
+}; // class use_platform_*
+
+} // namespace vulkan_start
@@ -0,0 +1,450 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "vulkan_start.hpp"
+
+namespace vulkan_start {
+
+enum class capture_format {
+    // the pixels as the swapchain has them, frame after frame in one file
+    raw,
+    // one binary ppm file per frame, capture_path is the file name prefix
+    ppm,
+    // one yuv4mpeg2 stream in 4:4:4, which most video tools read
+    y4m,
+};
+
+// capture settings, mixed into the app's configure object. an empty path
+// leaves capturing off
+struct capture_configure {
+    std::string capture_path;
+    capture_format capture_file_format = capture_format::raw;
+    // capture every Nth frame
+    uint32_t capture_every = 1;
+    // only written to the y4m header
+    uint32_t capture_frame_rate = 60;
+};
+
+inline capture_format parse_capture_format(std::string_view name) {
+    if (name == "raw") {
+        return capture_format::raw;
+    } else if (name == "ppm") {
+        return capture_format::ppm;
+    } else if (name == "y4m") {
+        return capture_format::y4m;
+    }
+    throw std::runtime_error{"unknown capture format " + std::string{name}};
+}
+
+// writes captured frames, owned by the writer thread of add_frame_capture.
+// frames arrive as 4 byte pixels, bgra or rgba, and are converted in a
+// scratch buffer that only grows, so a steady stream allocates nothing
+class capture_writer {
+public:
+    capture_writer(std::string path, capture_format format, uint32_t frame_rate)
+        : m_path{std::move(path)}, m_format{format}, m_frame_rate{frame_rate},
+          m_file{nullptr}, m_stream_extent{}, m_frame_count{0} {
+        if (m_format != capture_format::ppm) {
+            m_file = open(m_path.c_str());
+        }
+    }
+    capture_writer(const capture_writer&) = delete;
+    ~capture_writer() {
+        if (m_file) {
+            std::fclose(m_file);
+        }
+    }
+    void write(const uint8_t* pixels, vk::Extent2D extent, bool bgra) {
+        switch (m_format) {
+        case capture_format::raw:
+            put(m_file, pixels, 4ull * extent.width * extent.height);
+            break;
+        case capture_format::ppm:
+            write_ppm(pixels, extent, bgra);
+            break;
+        case capture_format::y4m:
+            write_y4m(pixels, extent, bgra);
+            break;
+        }
+        m_frame_count++;
+    }
+
+private:
+    static constexpr size_t file_buffer_size = 8 << 20;
+    static std::FILE* open(const char* path) {
+        std::FILE* file = std::fopen(path, "wb");
+        if (!file) {
+            throw std::runtime_error{std::string{"failed to open capture file "} + path};
+        }
+        // few large sequential writes instead of one per row
+        std::setvbuf(file, nullptr, _IOFBF, file_buffer_size);
+        return file;
+    }
+    static void put(std::FILE* file, const void* data, size_t size) {
+        if (std::fwrite(data, 1, size, file) != size) {
+            throw std::runtime_error{"failed to write capture"};
+        }
+    }
+    void write_ppm(const uint8_t* pixels, vk::Extent2D extent, bool bgra) {
+        size_t count = size_t{extent.width} * extent.height;
+        m_scratch.resize(std::max(m_scratch.size(), 3 * count));
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* p = pixels + 4 * i;
+            m_scratch[3 * i + 0] = bgra ? p[2] : p[0];
+            m_scratch[3 * i + 1] = p[1];
+            m_scratch[3 * i + 2] = bgra ? p[0] : p[2];
+        }
+        char name[4096];
+        std::snprintf(name, sizeof(name), "%s%06llu.ppm", m_path.c_str(),
+                      static_cast<unsigned long long>(m_frame_count));
+        std::FILE* file = open(name);
+        std::fprintf(file, "P6\n%u %u\n255\n", extent.width, extent.height);
+        put(file, m_scratch.data(), 3 * count);
+        std::fclose(file);
+    }
+    // bt.601 full range, the planes are written whole
+    void write_y4m(const uint8_t* pixels, vk::Extent2D extent, bool bgra) {
+        if (m_stream_extent.width == 0) {
+            m_stream_extent = extent;
+            std::fprintf(m_file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n",
+                         extent.width, extent.height, m_frame_rate);
+        }
+        if (extent != m_stream_extent) {
+            // a y4m stream has one size, frames after a resize are dropped
+            return;
+        }
+        size_t count = size_t{extent.width} * extent.height;
+        m_scratch.resize(std::max(m_scratch.size(), 3 * count));
+        uint8_t* y = m_scratch.data();
+        uint8_t* u = y + count;
+        uint8_t* v = u + count;
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* p = pixels + 4 * i;
+            int r = bgra ? p[2] : p[0];
+            int g = p[1];
+            int b = bgra ? p[0] : p[2];
+            y[i] = std::clamp((77 * r + 150 * g + 29 * b + 128) >> 8, 0, 255);
+            u[i] = std::clamp(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128, 0, 255);
+            v[i] = std::clamp(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128, 0, 255);
+        }
+        put(m_file, "FRAME\n", 6);
+        put(m_file, m_scratch.data(), 3 * count);
+    }
+
+    std::string m_path;
+    capture_format m_format;
+    uint32_t m_frame_rate;
+    std::FILE* m_file;
+    vk::Extent2D m_stream_extent;
+    uint64_t m_frame_count;
+    std::vector<uint8_t> m_scratch;
+};
+
+template <class T>
+concept frame_capturable = requires(T t, uint32_t index, vk::Semaphore semaphore) {
+    { t.capture_frame(index, semaphore) } -> std::same_as<vk::Semaphore>;
+};
+
+// copies rendered swapchain images into a ring of host visible buffers and
+// streams them to disk from a writer thread. add_dynamic_draw calls
+// capture_frame() after the draw submit; the copy waits on the draw and
+// present waits on the copy. a slot goes to the writer once its fence
+// signalled, which is polled, never waited for, and back to the ring when
+// written; with every slot busy the frame is not captured, so capturing
+// never stalls the frame loop
+template <class T> class add_frame_capture : public T {
+public:
+  using parent = T;
+  static constexpr uint32_t slot_count = 4;
+  add_frame_capture(const configure auto& conf)
+      : parent{conf}, m_every{1}, m_frame{0}, m_dropped_frame_count{0},
+        m_ready_sequence{0} {
+    if constexpr (requires { conf.capture_path; conf.capture_file_format; conf.capture_every; }) {
+      if (!conf.capture_path.empty()) {
+        m_every = std::max(conf.capture_every, 1u);
+        m_writer.emplace(conf.capture_path, conf.capture_file_format, conf.capture_frame_rate);
+        create();
+        create_image_semaphores();
+        m_thread = std::jthread{[this](std::stop_token stop) { write_frames(stop); }};
+      }
+    }
+  }
+  ~add_frame_capture() {
+    if (!m_writer) {
+      return;
+    }
+    // the queue is idle by now, add_dynamic_draw waited for it
+    collect_finished_copies();
+    m_thread.request_stop();
+    m_thread.join();
+    destroy_image_semaphores();
+    destroy();
+  }
+  // a new swapchain can reuse the old handle, so the images are taken again
+  // on every recreate, while the queue is idle
+  void recreate_surface() {
+    parent::recreate_surface();
+    if (m_writer) {
+      destroy_image_semaphores();
+      create_image_semaphores();
+    }
+  }
+  // returns the semaphore present has to wait for
+  vk::Semaphore capture_frame(uint32_t index, vk::Semaphore draw_image_semaphore) {
+    if (!m_writer) {
+      return draw_image_semaphore;
+    }
+    collect_finished_copies();
+    uint64_t frame = m_frame++;
+    if (frame % m_every != 0) {
+      return draw_image_semaphore;
+    }
+    auto free_slot = std::ranges::find_if(m_slots, [](auto& s) {
+      return s.state.load(std::memory_order_acquire) == slot_state::free;
+    });
+    if (free_slot == m_slots.end()) {
+      m_dropped_frame_count++;
+      return draw_image_semaphore;
+    }
+    vk::Extent2D extent = parent::get_swapchain_image_extent();
+    reserve(*free_slot, vk::DeviceSize{4} * extent.width * extent.height);
+    free_slot->extent = extent;
+
+    vk::Device device = parent::get_device();
+    vk::Image image = m_images[index];
+    vk::CommandBuffer cmd = free_slot->command_buffer;
+    cmd.reset();
+    cmd.begin(vk::CommandBufferBeginInfo{}.setFlags(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    auto range = vk::ImageSubresourceRange{}
+                     .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                     .setLevelCount(1)
+                     .setLayerCount(1);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                        vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+                        vk::ImageMemoryBarrier{}
+                            .setImage(image)
+                            .setSubresourceRange(range)
+                            .setOldLayout(vk::ImageLayout::ePresentSrcKHR)
+                            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+                            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eTransferRead));
+    cmd.copyImageToBuffer(
+        image, vk::ImageLayout::eTransferSrcOptimal, free_slot->buffer,
+        vk::BufferImageCopy{}
+            .setImageSubresource(vk::ImageSubresourceLayers{}
+                                     .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                                     .setLayerCount(1))
+            .setImageExtent(vk::Extent3D{extent.width, extent.height, 1}));
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eBottomOfPipe, {}, {},
+                        vk::BufferMemoryBarrier{}
+                            .setBuffer(free_slot->buffer)
+                            .setSize(vk::WholeSize)
+                            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eHostRead),
+                        vk::ImageMemoryBarrier{}
+                            .setImage(image)
+                            .setSubresourceRange(range)
+                            .setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+                            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+                            .setSrcAccessMask(vk::AccessFlagBits::eTransferRead));
+    cmd.end();
+
+    device.resetFences(free_slot->fence);
+    vk::Semaphore capture_semaphore = m_semaphores[index];
+    vk::PipelineStageFlags wait_stage{vk::PipelineStageFlagBits::eTransfer};
+    parent::get_queue().submit(vk::SubmitInfo{}
+                                   .setCommandBuffers(cmd)
+                                   .setWaitSemaphores(draw_image_semaphore)
+                                   .setWaitDstStageMask(wait_stage)
+                                   .setSignalSemaphores(capture_semaphore),
+                               free_slot->fence);
+    free_slot->state.store(slot_state::in_flight, std::memory_order_release);
+    return capture_semaphore;
+  }
+  // frames not captured because every slot was busy
+  auto get_dropped_capture_count() { return m_dropped_frame_count; }
+
+private:
+  enum class slot_state : uint8_t { free, in_flight, writing };
+  struct slot {
+    std::atomic<slot_state> state{slot_state::free};
+    vk::Buffer buffer;
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    void* pixels = nullptr;
+    vk::Extent2D extent;
+    vk::CommandBuffer command_buffer;
+    vk::Fence fence;
+  };
+
+  void create() {
+    vk::Device device = parent::get_device();
+    vk::Format format = parent::get_swapchain_image_format();
+    if (format == vk::Format::eB8G8R8A8Unorm || format == vk::Format::eB8G8R8A8Srgb) {
+      m_bgra = true;
+    } else if (format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb) {
+      m_bgra = false;
+    } else {
+      throw std::runtime_error{"capture needs an 8 bit rgba or bgra swapchain, not " +
+                               vk::to_string(format)};
+    }
+    m_command_pool = device.createCommandPool(
+        vk::CommandPoolCreateInfo{}
+            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+            .setQueueFamilyIndex(parent::get_queue_family_index()));
+    auto command_buffers = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo{}
+            .setCommandPool(m_command_pool)
+            .setCommandBufferCount(slot_count));
+    for (uint32_t i = 0; i < slot_count; i++) {
+      m_slots[i].command_buffer = command_buffers[i];
+      m_slots[i].fence = device.createFence(vk::FenceCreateInfo{});
+    }
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    for (auto& s : m_slots) {
+      release(s);
+      device.destroyFence(s.fence);
+    }
+    device.destroyCommandPool(m_command_pool);
+  }
+  // the swapchain images and a semaphore for each
+  void create_image_semaphores() {
+    vk::Device device = parent::get_device();
+    m_images = device.getSwapchainImagesKHR(parent::get_swapchain());
+    for (size_t i = 0; i < m_images.size(); i++) {
+      m_semaphores.push_back(device.createSemaphore(vk::SemaphoreCreateInfo{}));
+    }
+  }
+  void destroy_image_semaphores() {
+    vk::Device device = parent::get_device();
+    for (auto semaphore : m_semaphores) {
+      device.destroySemaphore(semaphore);
+    }
+    m_semaphores.clear();
+    m_images.clear();
+  }
+  // grows the buffer of a free slot, only after the swapchain grew
+  void reserve(slot& s, vk::DeviceSize size) {
+    if (s.size >= size) {
+      return;
+    }
+    release(s);
+    vk::Device device = parent::get_device();
+    s.buffer = device.createBuffer(vk::BufferCreateInfo{}.setSize(size).setUsage(
+        vk::BufferUsageFlagBits::eTransferDst));
+    auto requirements = device.getBufferMemoryRequirements(s.buffer);
+    s.memory = device.allocateMemory(
+        vk::MemoryAllocateInfo{}
+            .setAllocationSize(requirements.size)
+            .setMemoryTypeIndex(find_readback_memory_type(requirements.memoryTypeBits)));
+    device.bindBufferMemory(s.buffer, s.memory, 0);
+    s.pixels = device.mapMemory(s.memory, 0, vk::WholeSize);
+    s.size = size;
+  }
+  void release(slot& s) {
+    if (s.size == 0) {
+      return;
+    }
+    vk::Device device = parent::get_device();
+    device.unmapMemory(s.memory);
+    device.destroyBuffer(s.buffer);
+    device.freeMemory(s.memory);
+    s.size = 0;
+  }
+  // cached memory makes the writer's reads fast, coherent is the fallback
+  uint32_t find_readback_memory_type(uint32_t memory_type_bits) {
+    auto memory_properties = parent::get_physical_device().getMemoryProperties();
+    for (auto flags : {vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached,
+                       vk::MemoryPropertyFlags{vk::MemoryPropertyFlagBits::eHostVisible}}) {
+      for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        if ((memory_type_bits & (1u << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags & flags) == flags) {
+          return i;
+        }
+      }
+    }
+    throw std::runtime_error{"no host visible memory for capture"};
+  }
+  // hands slots whose copy finished to the writer
+  void collect_finished_copies() {
+    vk::Device device = parent::get_device();
+    for (uint32_t i = 0; i < slot_count; i++) {
+      auto& s = m_slots[i];
+      if (s.state.load(std::memory_order_acquire) != slot_state::in_flight ||
+          device.getFenceStatus(s.fence) != vk::Result::eSuccess) {
+        continue;
+      }
+      device.invalidateMappedMemoryRanges(
+          vk::MappedMemoryRange{}.setMemory(s.memory).setSize(vk::WholeSize));
+      s.state.store(slot_state::writing, std::memory_order_release);
+      // never full, there are more ring entries than slots
+      m_ready.try_push(i);
+      m_ready_sequence.fetch_add(1, std::memory_order_release);
+      m_ready_sequence.notify_one();
+    }
+  }
+  // drains the ready slots before it stops
+  void write_frames(std::stop_token stop) {
+    std::stop_callback wake_on_stop{stop, [this] {
+      m_ready_sequence.fetch_add(1, std::memory_order_release);
+      m_ready_sequence.notify_one();
+    }};
+    while (true) {
+      uint32_t seen = m_ready_sequence.load(std::memory_order_acquire);
+      uint32_t index;
+      while (m_ready.try_pop(index)) {
+        auto& s = m_slots[index];
+        try {
+          if (!m_write_failed) {
+            m_writer->write(static_cast<const uint8_t*>(s.pixels), s.extent, m_bgra);
+          }
+        } catch (std::exception& e) {
+          // the app keeps running, only the capture stops
+          std::cerr << e.what() << std::endl;
+          m_write_failed = true;
+        }
+        s.state.store(slot_state::free, std::memory_order_release);
+      }
+      if (stop.stop_requested()) {
+        return;
+      }
+      m_ready_sequence.wait(seen, std::memory_order_acquire);
+    }
+  }
+
+  uint32_t m_every;
+  uint64_t m_frame;
+  uint64_t m_dropped_frame_count;
+  bool m_bgra = false;
+  // only touched by the writer thread
+  bool m_write_failed = false;
+  std::optional<capture_writer> m_writer;
+  std::array<slot, slot_count> m_slots;
+  vk::CommandPool m_command_pool;
+  std::vector<vk::Image> m_images;
+  std::vector<vk::Semaphore> m_semaphores;
+  spsc_ring<uint32_t, 2 * slot_count> m_ready;
+  std::atomic<uint32_t> m_ready_sequence;
+  // joined first, before the state it uses is destroyed
+  std::jthread m_thread;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,125 @@
+// compares the cpu times a demo logged against a baseline, for checking
+// `./demo ... --headless --fixed-step=60 --frames=N` runs. the startup time
+// and the frame time p50 and p99 of the report with the most frames are
+// checked; exits with 1 when one is more than the threshold above its
+// baseline. --update writes the run's times as the new baseline
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using timings = std::map<std::string, double>;
+
+// "startup 12.3ms" and "frame time p50 1.2ms p99 3.4ms max 5.6ms (789)" lines
+timings read_log(const std::string& path) {
+    std::ifstream file{path};
+    if (!file) {
+        throw std::runtime_error{"failed to open " + path};
+    }
+    auto startup = std::regex{R"(^startup ([0-9.]+)ms)"};
+    auto frame_time = std::regex{R"(^frame time p50 ([0-9.]+)ms p99 ([0-9.]+)ms max [0-9.]+ms \(([0-9]+)\))"};
+    timings result;
+    uint64_t most_frames = 0;
+    std::string line;
+    std::smatch match;
+    while (std::getline(file, line)) {
+        if (std::regex_search(line, match, startup)) {
+            result["startup"] = std::stod(match[1]);
+        } else if (std::regex_search(line, match, frame_time)) {
+            uint64_t frames = std::stoull(match[3]);
+            if (frames >= most_frames) {
+                most_frames = frames;
+                result["frame_time_p50"] = std::stod(match[1]);
+                result["frame_time_p99"] = std::stod(match[2]);
+            }
+        }
+    }
+    if (!result.contains("startup") || most_frames == 0) {
+        throw std::runtime_error{"no startup or frame time report in " + path};
+    }
+    return result;
+}
+
+// one "name milliseconds" pair per line, # starts a comment
+timings read_baseline(const std::string& path) {
+    std::ifstream file{path};
+    if (!file) {
+        throw std::runtime_error{"failed to open " + path};
+    }
+    timings result;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line.starts_with('#')) {
+            continue;
+        }
+        auto space = line.find(' ');
+        if (space == std::string::npos) {
+            throw std::runtime_error{"not a baseline line: " + line};
+        }
+        result[line.substr(0, space)] = std::stod(line.substr(space + 1));
+    }
+    return result;
+}
+
+void write_baseline(const std::string& path, const timings& times) {
+    std::ofstream file{path};
+    if (!file) {
+        throw std::runtime_error{"failed to open " + path};
+    }
+    file << "# cpu times in ms, written by check_timings --update\n";
+    for (auto& [name, time] : times) {
+        file << name << " " << time << "\n";
+    }
+}
+
+using namespace std::literals;
+
+int main(int argc, const char* argv[]) {
+    try {
+        if (argc < 3) {
+            std::cerr << "usage: check_timings baseline.txt run.log"
+                         " [--threshold=0.25] [--update]" << std::endl;
+            return 2;
+        }
+        double threshold = 0.25;
+        bool update = false;
+        for (int i = 3; i < argc; i++) {
+            auto arg = std::string_view{argv[i]};
+            if (arg.starts_with("--threshold=")) {
+                threshold = std::stod(std::string{arg.substr(arg.find('=') + 1)});
+            } else if (arg == "--update") {
+                update = true;
+            } else {
+                throw std::runtime_error{"unknown option "s + argv[i]};
+            }
+        }
+        auto measured = read_log(argv[2]);
+        if (update) {
+            write_baseline(argv[1], measured);
+            return 0;
+        }
+        auto baseline = read_baseline(argv[1]);
+        int result = 0;
+        for (auto& [name, time] : measured) {
+            if (!baseline.contains(name)) {
+                continue;
+            }
+            double limit = baseline[name] * (1 + threshold);
+            std::clog << name << " " << time << "ms, baseline " << baseline[name]
+                << "ms, limit " << limit << "ms" << std::endl;
+            if (time > limit) {
+                std::cerr << name << " regressed" << std::endl;
+                result = 1;
+            }
+        }
+        return result;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan_helper.hpp>
+
+#include "input_queue.hpp"
+
+namespace vulkan_start {
+
+using namespace vulkan_hpp_helper;
+
+enum class clock_mode {
+    // steady_clock since the app started
+    wall,
+    // exactly 1 / fixed_step_rate seconds more on every frame
+    fixed_step,
+    // whatever set_time() set last, add_replay drives it
+    manual,
+};
+
+// clock and replay settings, mixed into the app's configure object
+struct clock_configure {
+    clock_mode clock = clock_mode::wall;
+    uint32_t fixed_step_rate = 60;
+    // add_replay writes the sampled times and the input to this file
+    std::string record_log;
+    // and replays them from this one, which also selects the manual clock
+    std::string replay_log;
+    // add_replay ends the run after this many frames, 0 runs until closed
+    uint64_t frame_limit = 0;
+};
+
+// the animation time of the app. layers sample get_time() once per frame,
+// which is what moves the fixed step clock forward
+template <class T> class add_clock : public T {
+public:
+    using parent = T;
+    add_clock(const configure auto& conf) : parent{conf},
+        m_mode{clock_mode::wall}, m_step{}, m_start_time{std::chrono::steady_clock::now()},
+        m_time{}, m_frame{0} {
+        if constexpr (requires { conf.clock; conf.fixed_step_rate; conf.replay_log; }) {
+            m_mode = conf.replay_log.empty() ? conf.clock : clock_mode::manual;
+            if (conf.fixed_step_rate == 0) {
+                throw std::runtime_error{"fixed step rate must not be 0"};
+            }
+            m_step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>{1.0 / conf.fixed_step_rate});
+        }
+    }
+    std::chrono::steady_clock::duration get_time() {
+        switch (m_mode) {
+        case clock_mode::wall:
+            m_time = std::chrono::steady_clock::now() - m_start_time;
+            break;
+        case clock_mode::fixed_step:
+            m_time = m_frame * m_step;
+            m_frame++;
+            break;
+        case clock_mode::manual:
+            break;
+        }
+        return m_time;
+    }
+    void set_time(std::chrono::steady_clock::duration time) {
+        m_time = time;
+    }
+    // what get_time() returned last, without sampling again
+    std::chrono::steady_clock::duration get_sampled_time() {
+        return m_time;
+    }
+private:
+    clock_mode m_mode;
+    std::chrono::steady_clock::duration m_step;
+    std::chrono::steady_clock::time_point m_start_time;
+    std::chrono::steady_clock::duration m_time;
+    uint64_t m_frame;
+};
+
+// thrown by add_replay's draw() to end the run, at the frame limit or when
+// the replayed log has no frames left
+class run_finished : public std::runtime_error {
+public:
+    explicit run_finished(uint64_t frames)
+        : std::runtime_error{"run finished after " + std::to_string(frames) + " frames"} {}
+};
+
+// ends the run at the frame limit, and records or replays it frame for
+// frame: the time the clock gave each frame and the input events that
+// arrived before it. the log is text, one
+// line per frame, `f <frame> <time ns>`, and per event,
+// `e <frame> <type> <a> <b>`. a replay hands the events of a frame to the
+// app right before its draw() and sets the manual clock to the recorded time
+template <class T> class add_replay : public T {
+public:
+    using parent = T;
+    add_replay(const configure auto& conf) : parent{conf}, m_frame{0}, m_frame_limit{0}, m_next_event{0} {
+        if constexpr (requires { conf.record_log; conf.replay_log; conf.frame_limit; }) {
+            m_frame_limit = conf.frame_limit;
+            if (!conf.record_log.empty()) {
+                m_record.open(conf.record_log);
+                if (!m_record) {
+                    throw std::runtime_error{"failed to open " + conf.record_log};
+                }
+            }
+            if (!conf.replay_log.empty()) {
+                load(conf.replay_log);
+            }
+        }
+    }
+    void draw() {
+        if (m_frame_limit != 0 && m_frame == m_frame_limit) {
+            throw run_finished{m_frame};
+        }
+        if (m_replaying) {
+            if (m_frame == m_times.size()) {
+                throw run_finished{m_frame};
+            }
+            while (m_next_event < m_events.size() && m_events[m_next_event].frame == m_frame) {
+                deliver(m_events[m_next_event].event);
+                m_next_event++;
+            }
+            if constexpr (requires { parent::set_time(std::chrono::steady_clock::duration{}); }) {
+                parent::set_time(m_times[m_frame]);
+            }
+        }
+        parent::draw();
+        if (m_record.is_open()) {
+            auto time = std::chrono::steady_clock::duration{};
+            if constexpr (requires { parent::get_sampled_time(); }) {
+                time = parent::get_sampled_time();
+            }
+            m_record << "f " << m_frame << ' '
+                     << std::chrono::nanoseconds{time}.count() << '\n';
+        }
+        m_frame++;
+    }
+    void process_input_event(const input_event& event) {
+        record(event);
+        if constexpr (input_event_processable<parent>) {
+            parent::process_input_event(event);
+        }
+    }
+    void process_key_event(int key, int state) {
+        record(input_event{input_event_type::key, std::chrono::steady_clock::now(), key, state});
+        if constexpr (requires { parent::process_key_event(key, state); }) {
+            parent::process_key_event(key, state);
+        }
+    }
+    void process_pointer_motion_event(uint32_t x, uint32_t y) {
+        record(input_event{input_event_type::pointer_motion, std::chrono::steady_clock::now(),
+                           static_cast<int32_t>(x), static_cast<int32_t>(y)});
+        if constexpr (requires { parent::process_pointer_motion_event(x, y); }) {
+            parent::process_pointer_motion_event(x, y);
+        }
+    }
+    void process_pointer_button_event(int button, int button_state) {
+        record(input_event{input_event_type::pointer_button, std::chrono::steady_clock::now(),
+                           button, button_state});
+        if constexpr (requires { parent::process_pointer_button_event(button, button_state); }) {
+            parent::process_pointer_button_event(button, button_state);
+        }
+    }
+    void process_pointer_axis_event(uint32_t axis, int value) {
+        record(input_event{input_event_type::pointer_axis, std::chrono::steady_clock::now(),
+                           static_cast<int32_t>(axis), value});
+        if constexpr (requires { parent::process_pointer_axis_event(axis, value); }) {
+            parent::process_pointer_axis_event(axis, value);
+        }
+    }
+private:
+    struct recorded_event {
+        uint64_t frame;
+        input_event event;
+    };
+    void record(const input_event& event) {
+        if (m_record.is_open()) {
+            m_record << "e " << m_frame << ' ' << static_cast<uint32_t>(event.type) << ' '
+                     << event.a << ' ' << event.b << '\n';
+        }
+    }
+    void load(const std::string& path) {
+        std::ifstream log{path};
+        if (!log) {
+            throw std::runtime_error{"failed to open " + path};
+        }
+        char kind;
+        while (log >> kind) {
+            uint64_t frame;
+            if (kind == 'f') {
+                int64_t time;
+                log >> frame >> time;
+                if (frame != m_times.size()) {
+                    throw std::runtime_error{"replay log frames out of order in " + path};
+                }
+                m_times.push_back(std::chrono::nanoseconds{time});
+            } else if (kind == 'e') {
+                uint32_t type;
+                int32_t a, b;
+                log >> frame >> type >> a >> b;
+                m_events.push_back(recorded_event{frame,
+                    input_event{static_cast<input_event_type>(type), {}, a, b}});
+            } else {
+                throw std::runtime_error{"unknown replay log line in " + path};
+            }
+            if (!log) {
+                throw std::runtime_error{"malformed replay log " + path};
+            }
+        }
+        m_replaying = true;
+    }
+    // stamped now, the recorded stamps are meaningless in another run
+    void deliver(input_event event) {
+        event.timestamp = std::chrono::steady_clock::now();
+        if (event.type == input_event_type::resize) {
+            return;
+        }
+        if constexpr (input_event_processable<parent>) {
+            parent::process_input_event(event);
+        }
+    }
+
+    uint64_t m_frame;
+    uint64_t m_frame_limit;
+    std::ofstream m_record;
+    bool m_replaying = false;
+    std::vector<std::chrono::steady_clock::duration> m_times;
+    std::vector<recorded_event> m_events;
+    size_t m_next_event;
+};
+
+} // namespace vulkan_start
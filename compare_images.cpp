@@ -0,0 +1,93 @@
+// compares a captured ppm frame against a reference one, for checking
+// `./demo ... --fixed-step=60 --frames=N --capture=out_ --capture-format=ppm`
+// runs. exits with 1 when more than the allowed fraction of pixels differ
+// by more than the tolerance in any channel
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct image {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> pixels;
+};
+
+image read_ppm(const std::string& path) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+        throw std::runtime_error{"failed to open " + path};
+    }
+    std::string magic;
+    uint32_t max_value;
+    image result{};
+    file >> magic >> result.width >> result.height >> max_value;
+    if (!file || magic != "P6" || max_value != 255) {
+        throw std::runtime_error{"not an 8 bit binary ppm: " + path};
+    }
+    file.get();
+    result.pixels.resize(size_t{result.width} * result.height * 3);
+    file.read(reinterpret_cast<char*>(result.pixels.data()), result.pixels.size());
+    if (!file) {
+        throw std::runtime_error{"truncated ppm: " + path};
+    }
+    return result;
+}
+
+using namespace std::literals;
+
+int main(int argc, const char* argv[]) {
+    try {
+        if (argc < 3) {
+            std::cerr << "usage: compare_images reference.ppm captured.ppm"
+                         " [--tolerance=2] [--max-differing=0.001]" << std::endl;
+            return 2;
+        }
+        uint32_t tolerance = 2;
+        double max_differing = 0.001;
+        for (int i = 3; i < argc; i++) {
+            auto arg = std::string_view{argv[i]};
+            auto value = std::string{arg.substr(arg.find('=') + 1)};
+            if (arg.starts_with("--tolerance=")) {
+                tolerance = std::stoul(value);
+            } else if (arg.starts_with("--max-differing=")) {
+                max_differing = std::stod(value);
+            } else {
+                throw std::runtime_error{"unknown option "s + argv[i]};
+            }
+        }
+        auto reference = read_ppm(argv[1]);
+        auto captured = read_ppm(argv[2]);
+        if (reference.width != captured.width || reference.height != captured.height) {
+            std::cerr << "size differs: " << reference.width << "x" << reference.height
+                << " vs " << captured.width << "x" << captured.height << std::endl;
+            return 1;
+        }
+        uint64_t differing = 0;
+        uint32_t max_difference = 0;
+        for (size_t i = 0; i < reference.pixels.size(); i += 3) {
+            uint32_t difference = 0;
+            for (size_t c = 0; c < 3; c++) {
+                auto d = std::abs(int{reference.pixels[i + c]} - int{captured.pixels[i + c]});
+                difference = std::max<uint32_t>(difference, d);
+            }
+            max_difference = std::max(max_difference, difference);
+            if (difference > tolerance) {
+                differing++;
+            }
+        }
+        auto pixel_count = uint64_t{reference.width} * reference.height;
+        auto fraction = pixel_count == 0 ? 0.0 : double(differing) / pixel_count;
+        std::clog << differing << " of " << pixel_count << " pixels differ by more than "
+            << tolerance << ", max difference " << max_difference << std::endl;
+        return fraction > max_differing ? 1 : 0;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -5,7 +5,16 @@
 #define VK_USE_PLATFORM_WAYLAND_KHR
 #endif
 
+#include "bindless.hpp"
 #include "cube.hpp"
+#include "descriptor_buffer.hpp"
+#include "dynamic_uniform.hpp"
+#include "gpu_driven.hpp"
+#include "occlusion_culling.hpp"
+#include "parallel_recording.hpp"
+
+#include <string_view>
+#include <vector>
 
 #ifdef WIN32
 constexpr auto PLATFORM = vulkan_start::platform::win32;
@@ -25,21 +34,221 @@ using draw_mesh_app =
         add_mesh_physical_device_and_device_and_draw
 	>
 	;
+using draw_cube_gpu_driven_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_gpu_driven_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_gpu_driven_physical_device_and_device_and_draw
+	>
+	;
+using draw_cube_occlusion_culled_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_occlusion_culled_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_occlusion_culled_physical_device_and_device_and_draw
+	>
+	;
+
+using draw_cube_parallel_recorded_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_parallel_recorded_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_parallel_recorded_physical_device_and_device_and_draw
+	>
+	;
+
+using draw_cube_dynamic_uniform_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_dynamic_uniform_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_dynamic_uniform_physical_device_and_device_and_draw
+	>
+	;
+
+using draw_cube_bindless_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_bindless_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_bindless_physical_device_and_device_and_draw
+	>
+	;
+
+using draw_cube_descriptor_buffer_app =
+	vulkan_start::run_on_platform<PLATFORM,
+      vulkan_start::use_platform_add_cube_descriptor_buffer_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_descriptor_buffer_physical_device_and_device_and_draw
+	>
+	;
+
+using draw_cube_render_thread_app =
+	vulkan_start::run_on_platform_with_render_thread<PLATFORM,
+      vulkan_start::use_platform_add_cube_physical_device_and_device_and_draw<PLATFORM>::
+        add_cube_physical_device_and_device_and_draw
+	>
+	;
+
+using draw_cube_on_demand_app =
+	vulkan_start::run_on_platform_with_render_thread<PLATFORM,
+      vulkan_start::on_demand<
+        vulkan_start::use_platform_add_cube_physical_device_and_device_and_draw<PLATFORM>::
+          add_cube_physical_device_and_device_and_draw
+      >::app
+	>
+	;
+
+struct demo_configure : vulkan_start::present_configure, vulkan_start::clock_configure,
+                        vulkan_start::capture_configure {};
 
 using namespace std::literals;
 
+#ifndef WIN32
+constexpr auto HEADLESS = vulkan_start::platform::headless;
+
+using draw_cube_headless_app =
+	vulkan_start::run_on_platform<HEADLESS,
+      vulkan_start::use_platform_add_cube_physical_device_and_device_and_draw<HEADLESS>::
+        add_cube_physical_device_and_device_and_draw
+	>
+	;
+using draw_mesh_headless_app =
+	vulkan_start::run_on_platform<HEADLESS,
+      vulkan_start::use_platform_add_mesh_physical_device_and_device_and_draw<HEADLESS>::
+        add_mesh_physical_device_and_device_and_draw
+	>
+	;
+#endif
+
+// the cube and mesh demos on a surface that shows nothing, for the render
+// regression tests on lavapipe without a compositor
+void draw_headless(std::string_view name, const demo_configure& conf) {
+#ifdef WIN32
+  throw std::runtime_error{"--headless is not supported on windows"};
+#else
+  if (name == "cube")
+  {
+    draw_cube_headless_app app{conf};
+  }
+  else if (name == "mesh")
+  {
+    draw_mesh_headless_app app{conf};
+  }
+  else
+  {
+    throw std::runtime_error{"--headless draws the cube and mesh demos only"};
+  }
+#endif
+}
+
 int main(int argc, const char* argv[]) {
   try {
-    if (argc < 2 || "cube"s == argv[1])
+    auto conf = demo_configure{};
+    bool headless = false;
+    std::vector<std::string_view> positional;
+    for (int i = 2; i < argc; i++)
+    {
+      auto arg = std::string_view{argv[i]};
+      if (arg.starts_with("--fixed-step="))
+      {
+        conf.clock = vulkan_start::clock_mode::fixed_step;
+        conf.fixed_step_rate = std::stoul(std::string{arg.substr(arg.find('=') + 1)});
+      }
+      else if (arg.starts_with("--frames="))
+      {
+        conf.frame_limit = std::stoull(std::string{arg.substr(arg.find('=') + 1)});
+      }
+      else if (arg.starts_with("--record="))
+      {
+        conf.record_log = arg.substr(arg.find('=') + 1);
+      }
+      else if (arg.starts_with("--replay="))
+      {
+        conf.replay_log = arg.substr(arg.find('=') + 1);
+      }
+      else if (arg.starts_with("--capture="))
+      {
+        conf.capture_path = arg.substr(arg.find('=') + 1);
+      }
+      else if (arg.starts_with("--capture-format="))
+      {
+        conf.capture_file_format = vulkan_start::parse_capture_format(arg.substr(arg.find('=') + 1));
+      }
+      else if (arg.starts_with("--capture-every="))
+      {
+        conf.capture_every = std::stoul(std::string{arg.substr(arg.find('=') + 1)});
+      }
+      else if (arg.starts_with("--synthetic-input="))
+      {
+        conf.synthetic_input_every = std::stoul(std::string{arg.substr(arg.find('=') + 1)});
+      }
+      else if (arg == "--headless")
+      {
+        headless = true;
+      }
+      else
+      {
+        positional.push_back(arg);
+      }
+    }
+    if (positional.size() > 0)
+    {
+      conf.present_mode = vulkan_start::parse_present_mode(positional[0]);
+    }
+    if (positional.size() > 1)
+    {
+      conf.image_count = std::stoul(std::string{positional[1]});
+    }
+    if (headless)
+    {
+      draw_headless(argc < 2 ? "cube"sv : std::string_view{argv[1]}, conf);
+    }
+    else if (argc < 2 || "cube"s == argv[1])
+    {
+      draw_cube_app app{conf};
+    }
+    else if ("render_thread"s == argv[1])
+    {
+      draw_cube_render_thread_app app{conf};
+    }
+    else if ("on_demand"s == argv[1])
+    {
+      draw_cube_on_demand_app app{conf};
+    }
+    else if ("gpu_driven"s == argv[1])
+    {
+      draw_cube_gpu_driven_app app{conf};
+    }
+    else if ("occlusion_culled"s == argv[1])
+    {
+      draw_cube_occlusion_culled_app app{conf};
+    }
+    else if ("parallel_recorded"s == argv[1])
+    {
+      draw_cube_parallel_recorded_app app{conf};
+    }
+    else if ("dynamic_uniform"s == argv[1])
+    {
+      draw_cube_dynamic_uniform_app app{conf};
+    }
+    else if ("bindless"s == argv[1])
+    {
+      draw_cube_bindless_app app{conf};
+    }
+    else if ("descriptor_buffer"s == argv[1])
     {
-      draw_cube_app app{vulkan_hpp_helper::empty_configure{}};
+      try
+      {
+        draw_cube_descriptor_buffer_app app{conf};
+      }
+      catch (vulkan_start::descriptor_buffer_unsupported &e)
+      {
+        std::clog << e.what() << ", drawing with descriptor sets" << std::endl;
+        draw_cube_app app{conf};
+      }
     }
     else
     {
-      draw_mesh_app app{vulkan_hpp_helper::empty_configure{}};
+      draw_mesh_app app{conf};
     }
+  } catch (vulkan_start::run_finished &e) {
+    std::clog << e.what() << std::endl;
   } catch (std::exception &e) {
     std::cerr << e.what() << std::endl;
+    return 1;
   }
   return 0;
 }
@@ -1,9 +1,20 @@
+#pragma once
+
 #include <iostream>
 #include <map>
 #include <numeric>
+#include <span>
 #include <string>
 #include <vulkan_helper.hpp>
 
+#include "benchmark.hpp"
+#include "capture.hpp"
+#include "memory.hpp"
+#include "mesh_optimizer.hpp"
+#include "present.hpp"
+#include "procedural.hpp"
+#include "render_graph.hpp"
+#include "transform.hpp"
 #include "vulkan_start.hpp"
 
 namespace vulkan_start {
@@ -14,6 +25,12 @@ enum class app {
     fast_debug,
     cube,
     mesh_test,
+    cube_gpu_driven,
+    cube_occlusion_culled,
+    cube_parallel_recorded,
+    cube_dynamic_uniform,
+    cube_bindless,
+    cube_descriptor_buffer,
 };
 
 template <app APP>
@@ -47,17 +64,23 @@ private:
     PFN_vkCmdDrawMeshTasksEXT m_vk_cmd_draw_mesh_tasks_ext;
 };
 
+inline constexpr auto cube_vertex_positions = std::array<std::array<float, 3>, 8>{{
+    {-1.0f, -1.0f, -1.0f}, {-1.0f, -1.0f, 1.0f},  {-1.0f, 1.0f, -1.0f},
+    {-1.0f, 1.0f, 1.0f},   {1.0f, -1.0f, -1.0f},  {1.0f, -1.0f, 1.0f},
+    {1.0f, 1.0f, -1.0f},   {1.0f, 1.0f, 1.0f},
+}};
+inline constexpr auto cube_indices = std::array<uint16_t, 3 * 3 * 2 * 2>{
+    0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 1, 5, 7, 1, 7, 3,
+    3, 7, 6, 3, 6, 2, 2, 6, 4, 2, 4, 0, 0, 4, 5, 0, 5, 1,
+};
+
 template <class T> class add_cube_vertex_buffer_data : public T {
 public:
   auto get_buffer_size() { return m_data.size() * sizeof(m_data[0]); }
   auto get_buffer_data() { return m_data; }
 
 private:
-  static constexpr auto m_data = std::array{
-      -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, 1.0f,
-      -1.0f, -1.0f, 1.0f,  1.0f,  1.0f,  -1.0f, -1.0f, 1.0f,
-      -1.0f, 1.0f,  1.0f,  1.0f,  -1.0f, 1.0f,  1.0f,  1.0f,
-  };
+  static constexpr auto m_data = cube_vertex_positions;
 };
 template <class T> class add_cube_index_buffer_data : public T {
 public:
@@ -66,10 +89,49 @@ public:
   auto get_buffer_data() { return m_data; }
 
 private:
-  static constexpr auto m_data = std::array<uint16_t, 3 * 3 * 2 * 2>{
-      0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 1, 5, 7, 1, 7, 3,
-      3, 7, 6, 3, 6, 2, 2, 6, 4, 2, 4, 0, 0, 4, 5, 0, 5, 1,
-  };
+  static constexpr auto m_data = cube_indices;
+};
+
+// the cube after the mesh optimisation stage: triangles reordered for the
+// post transform cache, vertices in first use order, positions as
+// R16G16B16A16_SNORM
+inline const optimized_mesh<uint16_t>& get_optimized_cube_mesh() {
+  static const auto mesh = optimize_mesh<uint16_t>(cube_vertex_positions, cube_indices);
+  return mesh;
+}
+
+template <class T> class add_optimized_cube_vertex_buffer_data : public T {
+public:
+  using parent = T;
+  add_optimized_cube_vertex_buffer_data(const configure auto& conf) : parent{conf} {
+    auto& mesh = get_optimized_cube_mesh();
+    std::clog << "cube ACMR: " << mesh.acmr_before << " -> " << mesh.acmr_after
+              << ", vertex size: " << sizeof(cube_vertex_positions[0]) << " -> "
+              << sizeof(mesh.positions.positions[0]) << " bytes" << std::endl;
+  }
+  auto get_buffer_size() {
+    auto& positions = get_optimized_cube_mesh().positions.positions;
+    return positions.size() * sizeof(positions[0]);
+  }
+  auto get_buffer_data() {
+    return std::span{get_optimized_cube_mesh().positions.positions};
+  }
+  // maps the snorm positions back to the mesh space, the shaders see
+  // snorm * scale + bias through the object transforms
+  mat4 get_vertex_dequantization() {
+    auto& positions = get_optimized_cube_mesh().positions;
+    return make_translation(positions.bias[0], positions.bias[1], positions.bias[2]) *
+           make_scale(positions.scale[0], positions.scale[1], positions.scale[2]);
+  }
+};
+template <class T> class add_optimized_cube_index_buffer_data : public T {
+public:
+  using parent = T;
+  auto get_buffer_size() {
+    auto& indices = get_optimized_cube_mesh().indices;
+    return indices.size() * sizeof(indices[0]);
+  }
+  auto get_buffer_data() { return std::span{get_optimized_cube_mesh().indices}; }
 };
 
 template <class T> class add_cube_descriptor_set_layout_binding : public T {
@@ -94,16 +156,24 @@ public:
   using parent = T;
   add_mesh_descriptor_set_layout_binding(const configure auto& conf) : parent{conf} {
     vk::ShaderStageFlagBits stages = vk::ShaderStageFlagBits::eMeshEXT;
-    m_binding = vk::DescriptorSetLayoutBinding{}
-                    .setBinding(0)
-                    .setDescriptorCount(1)
-                    .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-                    .setStageFlags(stages);
+    m_bindings = {
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+            .setStageFlags(stages),
+        // points of the procedural curve
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(1)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(stages),
+    };
   }
-  auto get_descriptor_set_layout_bindings() { return m_binding; }
+  auto get_descriptor_set_layout_bindings() { return m_bindings; }
 
 private:
-  vk::DescriptorSetLayoutBinding m_binding;
+  std::array<vk::DescriptorSetLayoutBinding, 2> m_bindings;
 };
 template <class T> class add_descriptor_pool : public T {
 public:
@@ -113,9 +183,17 @@ public:
   void create() {
     vk::Device device = parent::get_device();
     uint32_t count = parent::get_swapchain_images().size();
-    auto pool_sizes =
-        vk::DescriptorPoolSize{}.setDescriptorCount(count).setType(
-            vk::DescriptorType::eUniformBuffer);
+    if constexpr (requires { parent::get_descriptor_set_count(); }) {
+      count = parent::get_descriptor_set_count();
+    }
+    auto bindings = parent::get_descriptor_set_layout_bindings();
+    std::vector<vk::DescriptorPoolSize> pool_sizes;
+    for (const vk::DescriptorSetLayoutBinding& binding :
+         vk::ArrayProxy<const vk::DescriptorSetLayoutBinding>{bindings}) {
+      pool_sizes.push_back(vk::DescriptorPoolSize{}
+                               .setDescriptorCount(count * binding.descriptorCount)
+                               .setType(binding.descriptorType));
+    }
     m_pool = device.createDescriptorPool(
         vk::DescriptorPoolCreateInfo{}.setMaxSets(count).setPoolSizes(
             pool_sizes));
@@ -140,6 +218,9 @@ public:
     vk::DescriptorPool pool = parent::get_descriptor_pool();
     vk::DescriptorSetLayout layout = parent::get_descriptor_set_layout();
     uint32_t count = parent::get_swapchain_images().size();
+    if constexpr (requires { parent::get_descriptor_set_count(); }) {
+      count = parent::get_descriptor_set_count();
+    }
     std::vector<vk::DescriptorSetLayout> layouts(count);
     std::ranges::for_each(layouts, [layout](auto &l) { l = layout; });
     m_set = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{}
@@ -148,11 +229,18 @@ public:
                                               .setSetLayouts(layouts));
   }
   void destroy() {}
-  auto get_descriptor_set() { return m_set; }
+  const auto& get_descriptor_set() { return m_set; }
 
 private:
   std::vector<vk::DescriptorSet> m_set;
 };
+// sets to allocate instead of one per swapchain image, for a set that is
+// shared by every image
+template <uint32_t COUNT, class T> class set_descriptor_set_count : public T {
+public:
+  using parent = T;
+  auto get_descriptor_set_count() { return COUNT; }
+};
 template <class T> class set_vector_size_to_swapchain_image_count : public T {
 public:
   using parent = T;
@@ -198,16 +286,132 @@ public:
     }
 };
 
-template <class T> class add_get_time : public T {
+// a pointer button press stops the animation and the next one restarts it,
+// time stands still in between. the press takes effect at the next sample,
+// so the clock below is still sampled once per frame
+template <class T> class add_animation_pause : public T {
 public:
     using parent = T;
-    add_get_time(const configure auto& conf) : parent{conf}, m_start_time{std::chrono::steady_clock::now()}{
+    add_animation_pause(const configure auto& conf) : parent{conf},
+        m_paused{false}, m_toggle{false}, m_paused_at{}, m_paused_for{} {
     }
     auto get_time() {
-        return std::chrono::steady_clock::now() - m_start_time;
+        auto now = parent::get_time();
+        if (m_toggle) {
+            if (m_paused) {
+                m_paused_for += now - m_paused_at;
+            } else {
+                m_paused_at = now;
+            }
+            m_paused = !m_paused;
+            m_toggle = false;
+        }
+        return (m_paused ? m_paused_at : now) - m_paused_for;
+    }
+    bool is_animating() {
+        return !m_paused || m_toggle;
+    }
+    void process_pointer_button_event(int button, int button_state) {
+        if (button_state == 1) {
+            m_toggle = !m_toggle;
+        }
+    }
+    void process_input_event(const input_event& event) {
+        if (event.type == input_event_type::pointer_button && event.b == 1) {
+            m_toggle = !m_toggle;
+        }
+    }
+private:
+    bool m_paused;
+    bool m_toggle;
+    std::chrono::steady_clock::duration m_paused_at;
+    std::chrono::steady_clock::duration m_paused_for;
+};
+
+template <uint32_t COUNT, class T> class set_object_count : public T {
+public:
+    using parent = T;
+    auto get_object_count() { return COUNT; }
+};
+
+// per frame CPU transform stage, the shaders only multiply by the result
+template <class T> class set_buffer_size_to_object_matrices : public T {
+public:
+    using parent = T;
+    auto get_buffer_size() { return sizeof(mat4) * parent::get_object_count(); }
+};
+
+template <class T> class add_object_transforms : public T {
+public:
+    using parent = T;
+    add_object_transforms(const configure auto& conf) : parent{conf} {
+        uint32_t count = parent::get_object_count();
+        m_transforms.resize(count);
+        m_matrices.resize(count);
+        uint32_t columns = std::ceil(std::sqrt(count));
+        for (uint32_t i = 0; i < count; i++) {
+            float x = 3.0f * (i % columns) - 1.5f * (columns - 1);
+            float y = 3.0f * (i / columns) - 1.5f * (columns - 1);
+            m_transforms.set_position(i, x, y, 0);
+        }
+        m_view_projection = make_simple_perspective() * make_translation(0, 0, 4);
+        m_mesh = mat4::identity();
+    }
+    void update_object_transforms() {
+        animate_object_transforms();
+        compose_object_matrices(0, m_transforms.size());
+    }
+    void animate_object_transforms() {
+        auto time = parent::get_time();
+        float time_in_s = std::chrono::duration<float>(time).count();
+        float theta = time_in_s * 3.14f / 4;
+        quat rotation = make_rotation(0, 1, 0, theta) * make_rotation(0, 0, 1, -theta);
+        for (uint32_t i = 0; i < m_transforms.size(); i++) {
+            m_transforms.set_rotation(i, rotation);
+        }
     }
+    // objects [begin, end), disjoint ranges may run concurrently
+    void compose_object_matrices(uint32_t begin, uint32_t end) {
+        compose_transforms(m_view_projection, m_transforms, m_mesh, m_matrices, begin, end);
+    }
+    std::span<const mat4> get_object_matrices() { return m_matrices; }
+    auto& get_object_transforms() { return m_transforms; }
+    void set_view_projection(const mat4& view_projection) {
+        m_view_projection = view_projection;
+    }
+    // applied to the vertices before the object transform
+    void set_mesh_transform(const mat4& mesh) {
+        m_mesh = mesh;
+    }
+
 private:
-    std::chrono::steady_clock::time_point m_start_time;
+    transform_soa m_transforms;
+    std::vector<mat4> m_matrices;
+    mat4 m_view_projection;
+    mat4 m_mesh;
+};
+
+// composes the object matrices on the job system in chunks of GRAIN objects
+template <uint32_t GRAIN, class T> class compose_object_matrices_in_parallel : public T {
+public:
+    using parent = T;
+    static_assert(GRAIN % 8 == 0, "chunks should not split a SIMD batch");
+    void update_object_transforms() {
+        parent::animate_object_transforms();
+        parent::get_job_system().parallel_for(
+            parent::get_object_count(), GRAIN,
+            [this](uint32_t begin, uint32_t end) {
+                parent::compose_object_matrices(begin, end);
+            });
+    }
+};
+
+template <class T> class apply_vertex_dequantization : public T {
+public:
+    using parent = T;
+    apply_vertex_dequantization(const configure auto& conf) : parent{conf} {
+        parent::set_mesh_transform(parent::get_vertex_dequantization());
+    }
 };
 
 template<class T>
@@ -221,9 +425,35 @@ public:
     }
 };
 
+// the upload buffers live as long as the app, so their mapped pointers and
+// memories are copied once here instead of fetched as vectors every frame
+template <class T> class add_uniform_upload : public T {
+public:
+  using parent = T;
+  add_uniform_upload(const configure auto& conf)
+      : parent{conf},
+        m_upload_memory_ptrs(parent::get_uniform_upload_buffer_memory_ptr_vector()),
+        m_upload_memories(parent::get_uniform_upload_buffer_memory_vector()) {}
+  void upload_frame_data(uint32_t index) {
+    vk::Device device = parent::get_device();
+    parent::update_object_transforms();
+    std::span<const mat4> matrices = parent::get_object_matrices();
+    memcpy(m_upload_memory_ptrs[index], matrices.data(), matrices.size_bytes());
+    device.flushMappedMemoryRanges(vk::MappedMemoryRange{}
+                                       .setMemory(m_upload_memories[index])
+                                       .setOffset(0)
+                                       .setSize(vk::WholeSize));
+  }
+
+private:
+  std::vector<void *> m_upload_memory_ptrs;
+  std::vector<vk::DeviceMemory> m_upload_memories;
+};
+
 template <class T> class add_dynamic_draw : public T {
 public:
   using parent = T;
+  add_dynamic_draw(const configure auto& conf) : parent{conf}, m_present_count{0} {}
   void draw() {
     vk::Device device = parent::get_device();
     vk::SwapchainKHR swapchain = parent::get_swapchain();
@@ -256,42 +486,63 @@ public:
     }
     device.resetFences(acquire_next_image_semaphore_fence);
 
-    auto time = parent::get_time();
-    auto time_in_ms = std::chrono::duration_cast<std::chrono::milliseconds>(time);
-    uint64_t frame_index = time_in_ms.count();
-    std::vector<void *> upload_memory_ptrs =
-        parent::get_uniform_upload_buffer_memory_ptr_vector();
-    void *upload_ptr = upload_memory_ptrs[index];
-    memcpy(upload_ptr, &frame_index, sizeof(frame_index));
-    std::vector<vk::DeviceMemory> upload_memory_vector =
-        parent::get_uniform_upload_buffer_memory_vector();
-    vk::DeviceMemory upload_memory = upload_memory_vector[index];
-    device.flushMappedMemoryRanges(vk::MappedMemoryRange{}
-                                       .setMemory(upload_memory)
-                                       .setOffset(0)
-                                       .setSize(vk::WholeSize));
+    std::array<vk::CommandBuffer, 3> command_buffers{
+        parent::get_swapchain_command_buffer(index)};
+    uint32_t command_buffer_count = 1;
+    std::chrono::steady_clock::time_point submit_start;
+    if constexpr (frame_timed<parent>) {
+      submit_start = std::chrono::steady_clock::now();
+      auto [begin, end] = parent::begin_frame_timing(index);
+      if (begin) {
+        command_buffers = {begin, command_buffers[0], end};
+        command_buffer_count = 3;
+      }
+    }
+
+    parent::upload_frame_data(index);
 
     vk::Semaphore draw_image_semaphore =
         parent::get_draw_image_semaphore(index);
-    vk::CommandBuffer buffer = parent::get_swapchain_command_buffer(index);
+    // only the render pass touches the acquired image, the upload before
+    // it doesn't wait for the acquire
     vk::PipelineStageFlags wait_stage_mask{
-        vk::PipelineStageFlagBits::eTopOfPipe};
+        vk::PipelineStageFlagBits::eColorAttachmentOutput};
     queue.submit(vk::SubmitInfo{}
-                     .setCommandBuffers(buffer)
+                     .setCommandBufferCount(command_buffer_count)
+                     .setPCommandBuffers(command_buffers.data())
                      .setWaitSemaphores(acquire_image_semaphore)
                      .setWaitDstStageMask(wait_stage_mask)
                      .setSignalSemaphores(draw_image_semaphore),
                  acquire_next_image_semaphore_fence);
+    if constexpr (frame_timed<parent>) {
+      parent::end_frame_timing(std::chrono::steady_clock::now() - submit_start);
+    }
+    vk::Semaphore present_wait_semaphore = draw_image_semaphore;
+    if constexpr (frame_capturable<parent>) {
+      present_wait_semaphore =
+          parent::capture_frame(index, draw_image_semaphore);
+    }
+    auto present_info = vk::PresentInfoKHR{}
+                            .setImageIndices(index)
+                            .setSwapchains(swapchain)
+                            .setWaitSemaphores(present_wait_semaphore);
+    uint64_t present_id = 0;
+    auto present_id_info = vk::PresentIdKHR{};
+    if constexpr (present_id_provider<parent>) {
+      present_id = parent::next_present_id(swapchain);
+      if (present_id != 0) {
+        present_id_info.setPresentIds(present_id);
+        present_info.setPNext(&present_id_info);
+      }
+    }
     try {
-      auto res = queue.presentKHR(vk::PresentInfoKHR{}
-                                      .setImageIndices(index)
-                                      .setSwapchains(swapchain)
-                                      .setWaitSemaphores(draw_image_semaphore));
+      auto res = queue.presentKHR(present_info);
       if (res == vk::Result::eSuboptimalKHR) {
         need_recreate_surface = true;
       } else if (res != vk::Result::eSuccess) {
         throw std::runtime_error{"present return != success"};
       }
+      m_present_count++;
     } catch (vk::OutOfDateKHRError e) {
       need_recreate_surface = true;
     }
@@ -304,6 +555,11 @@ public:
     vk::Queue queue = parent::get_queue();
     queue.waitIdle();
   }
+  // presents the window system took
+  uint64_t get_present_count() { return m_present_count; }
+
+private:
+  uint64_t m_present_count;
 };
 
 
@@ -314,6 +570,20 @@ public:
     vk::Device device = parent::get_device();
     auto attachments = parent::get_attachments();
     auto dependencies = parent::get_subpass_dependencies();
+    // add_dynamic_draw waits for the acquired image at color attachment
+    // output, the attachments are loaded and transitioned after it, and the
+    // depth clear after the last frame's depth tests
+    dependencies.push_back(
+        vk::SubpassDependency{}
+            .setSrcSubpass(vk::SubpassExternal)
+            .setDstSubpass(0)
+            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                             vk::PipelineStageFlagBits::eLateFragmentTests)
+            .setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                             vk::PipelineStageFlagBits::eEarlyFragmentTests)
+            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite));
     auto color_attachment =
         vk::AttachmentReference{}.setAttachment(0).setLayout(
             vk::ImageLayout::eColorAttachmentOptimal);
@@ -380,7 +650,7 @@ public:
       device.destroyFramebuffer(framebuffer);
     });
   }
-  auto get_framebuffers() { return m_framebuffers; }
+  const auto& get_framebuffers() { return m_framebuffers; }
 
 private:
   std::vector<vk::Framebuffer> m_framebuffers;
@@ -417,12 +687,32 @@ public:
     std::ranges::for_each(
         m_views, [device](auto view) { device.destroyImageView(view); });
   }
-  auto get_images_views() { return m_views; }
+  const auto& get_images_views() { return m_views; }
 
 private:
   std::vector<vk::ImageView> m_views;
 };
 
+// the clear values of the record layers, the color one in the clear color
+// value type of the swapchain format
+template <class L> std::array<vk::ClearValue, 2> get_clear_values(L* layer) {
+  auto clear_color_value_type = layer->get_format_clear_color_value_type(
+      layer->get_swapchain_image_format());
+  using value_type = decltype(clear_color_value_type);
+  std::map<value_type, vk::ClearColorValue> clear_color_values{
+      {value_type::eFloat32,
+       vk::ClearColorValue{}.setFloat32({0.4f, 0.4f, 0.4f, 0.0f})},
+      {value_type::eUint32, vk::ClearColorValue{}.setUint32({50, 50, 50, 0})},
+  };
+  if (!clear_color_values.contains(clear_color_value_type)) {
+    throw std::runtime_error{"unsupported clear color value type"};
+  }
+  auto clear_depth_value = vk::ClearDepthStencilValue{}.setDepth(1.0f);
+  return std::array{
+      vk::ClearValue{}.setColor(clear_color_values[clear_color_value_type]),
+      vk::ClearValue{}.setDepthStencil(clear_depth_value)};
+}
+
 template<>
 class use_app<app::cube> {
 public:
@@ -434,7 +724,7 @@ public:
   void create() {
     auto buffers = parent::get_swapchain_command_buffers();
     auto swapchain_images = parent::get_swapchain_images();
-    auto queue_family_index = parent::get_queue_family_index();
+    PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2 = find_pipeline_barrier2(this);
     auto framebuffers = parent::get_framebuffers();
     std::vector<vk::Buffer> uniform_buffers =
         parent::get_uniform_buffer_vector();
@@ -443,23 +733,7 @@ public:
     std::vector<vk::DescriptorSet> descriptor_sets =
         parent::get_descriptor_set();
 
-    auto clear_color_value_type = parent::get_format_clear_color_value_type(
-        parent::get_swapchain_image_format());
-    using value_type = decltype(clear_color_value_type);
-    std::map<value_type, vk::ClearColorValue> clear_color_values{
-        {value_type::eFloat32,
-         vk::ClearColorValue{}.setFloat32({0.4f, 0.4f, 0.4f, 0.0f})},
-        {value_type::eUint32, vk::ClearColorValue{}.setUint32({50, 50, 50, 0})},
-    };
-    if (!clear_color_values.contains(clear_color_value_type)) {
-      throw std::runtime_error{"unsupported clear color value type"};
-    }
-    vk::ClearColorValue clear_color_value{
-        clear_color_values[clear_color_value_type]};
-    auto clear_depth_value = vk::ClearDepthStencilValue{}.setDepth(1.0f);
-    auto clear_values =
-        std::array{vk::ClearValue{}.setColor(clear_color_value),
-                   vk::ClearValue{}.setDepthStencil(clear_depth_value)};
+    auto clear_values = get_clear_values(this);
 
     if (buffers.size() != swapchain_images.size()) {
       throw std::runtime_error{
@@ -474,53 +748,54 @@ public:
 
       vk::Buffer uniform_buffer = uniform_buffers[index];
       vk::Buffer upload_buffer = uniform_upload_buffers[index];
-      cmd.copyBuffer(upload_buffer, uniform_buffer,
-                     vk::BufferCopy{}.setSize(sizeof(uint64_t)));
-      auto uniform_buffer_memory_barrier =
-          vk::BufferMemoryBarrier{}
-              .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-              .setDstAccessMask(vk::AccessFlagBits::eUniformRead)
-              .setSrcQueueFamilyIndex(queue_family_index)
-              .setDstQueueFamilyIndex(queue_family_index)
-              .setBuffer(uniform_buffer)
-              .setOffset(0)
-              .setSize(vk::WholeSize);
-      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                          vk::PipelineStageFlagBits::eVertexShader, {}, {},
-                          uniform_buffer_memory_barrier, {});
-
-      vk::RenderPass render_pass = parent::get_render_pass();
-
-      vk::Extent2D swapchain_image_extent =
-          parent::get_swapchain_image_extent();
-      auto render_area = vk::Rect2D{}
-                             .setOffset(vk::Offset2D{0, 0})
-                             .setExtent(swapchain_image_extent);
-      vk::Framebuffer framebuffer = framebuffers[index];
-      cmd.beginRenderPass(vk::RenderPassBeginInfo{}
-                              .setRenderPass(render_pass)
-                              .setRenderArea(render_area)
-                              .setFramebuffer(framebuffer)
-                              .setClearValues(clear_values),
-                          vk::SubpassContents::eInline);
-
-      vk::Pipeline pipeline = parent::get_pipeline();
-      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-      vk::Buffer vertex_buffer = parent::get_vertex_buffer();
-      cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
-      vk::Buffer index_buffer = parent::get_index_buffer();
-      cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
-
-      vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
-      vk::DescriptorSet descriptor_set = descriptor_sets[index];
-      cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
-                             0, descriptor_set, {});
-      cmd.drawIndexed(3 * 2 * 3 * 2, 1, 0, 0, 0);
-      cmd.endRenderPass();
+      // the render pass synchronizes its attachments, the graph the
+      // uniforms between the upload and the draw
+      render_graph graph;
+      auto uniforms = graph.import_buffer(uniform_buffer);
+      graph.add_pass("upload", {{uniforms, copy_destination}}, [&](vk::CommandBuffer cmd) {
+        cmd.copyBuffer(upload_buffer, uniform_buffer,
+                       vk::BufferCopy{}.setSize(sizeof(mat4) * parent::get_object_count()));
+      });
+      graph.add_pass("draw", {{uniforms, vertex_shader_uniform_read}}, [&](vk::CommandBuffer cmd) {
+        vk::RenderPass render_pass = parent::get_render_pass();
+
+        vk::Extent2D swapchain_image_extent =
+            parent::get_swapchain_image_extent();
+        auto render_area = vk::Rect2D{}
+                               .setOffset(vk::Offset2D{0, 0})
+                               .setExtent(swapchain_image_extent);
+        vk::Framebuffer framebuffer = framebuffers[index];
+        cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                                .setRenderPass(render_pass)
+                                .setRenderArea(render_area)
+                                .setFramebuffer(framebuffer)
+                                .setClearValues(clear_values),
+                            vk::SubpassContents::eInline);
+
+        vk::Pipeline pipeline = parent::get_pipeline();
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        vk::Buffer vertex_buffer = parent::get_vertex_buffer();
+        cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+        vk::Buffer index_buffer = parent::get_index_buffer();
+        cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
+
+        vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+        vk::DescriptorSet descriptor_set = descriptor_sets[index];
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                               0, descriptor_set, {});
+        cmd.drawIndexed(3 * 2 * 3 * 2, parent::get_draw_instance_count(), 0, 0, 0);
+        cmd.endRenderPass();
+      });
+      graph.compile();
+      graph.execute(cmd, pipeline_barrier2);
       cmd.end();
     }
   }
   void destroy() {}
+  // triangles per frame
+  uint64_t get_primitive_count() {
+    return uint64_t{2 * 6} * parent::get_draw_instance_count();
+  }
 }; // class record_swapchain_command_buffers in use_app<app::cube>
 
 template <class T>
@@ -529,11 +804,23 @@ class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
 
 template <class T> class add_resources_and_draw
   : public
+    profiled<
+    add_frame_allocation_check<
     add_frame_time_analyser<
+    add_synthetic_input<
     add_dynamic_draw <
-    add_get_time <
     add_process_suboptimal_image<
         decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_present_latency <
+    add_frame_capture <
+    add_frame_timing <
+    add_input_timestamps <
+    add_uniform_upload <
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_animation_pause <
+    add_clock <
+    add_memory_statistics<
     add_queue_wait_idle_to_recreate_surface<
     add_acquire_next_image_semaphores <
     add_acquire_next_image_semaphore_fences <
@@ -550,7 +837,7 @@ template <class T> class add_resources_and_draw
     rename_buffer_to_index_buffer<
     add_buffer_as_member<
     set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
-    add_cube_index_buffer_data<
+    add_optimized_cube_index_buffer_data<
     rename_buffer_vector_to_uniform_upload_buffer_vector <
     rename_buffer_memory_vector_to_uniform_upload_buffer_memory_vector<
     rename_buffer_memory_ptr_vector_to_uniform_upload_buffer_memory_ptr_vector<
@@ -568,22 +855,22 @@ template <class T> class add_resources_and_draw
     add_buffer_usage<vk::BufferUsageFlagBits::eTransferDst,
     add_buffer_usage<vk::BufferUsageFlagBits::eUniformBuffer,
     empty_buffer_usage<
-    set_buffer_size<sizeof(uint64_t),
+    set_buffer_size_to_object_matrices<
     add_buffer_memory_with_data_copy <
     rename_buffer_to_vertex_buffer<
     add_buffer_as_member <
     set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
-    add_cube_vertex_buffer_data <
+    add_optimized_cube_vertex_buffer_data <
     add_recreate_surface_for<
     add_graphics_pipeline <
     add_pipeline_vertex_input_state <
     add_vertex_binding_description <
     add_empty_binding_descriptions <
     add_vertex_attribute_description <
-    set_vertex_input_attribute_format<vk::Format::eR32G32B32Sfloat,
+    set_vertex_input_attribute_format<vk::Format::eR16G16B16A16Snorm,
     add_empty_vertex_attribute_descriptions <
     set_binding < 0,
-    set_stride < sizeof(float) * 3,
+    set_stride < sizeof(int16_t) * 4,
     set_input_rate < vk::VertexInputRate::eVertex,
     set_subpass < 0,
     add_recreate_surface_for<
@@ -601,8 +888,10 @@ template <class T> class add_resources_and_draw
     add_viewport_equal_swapchain_image_rect <
     add_empty_viewports <
     set_tessellation_patch_control_point_count < 1,
+    add_draw_instance_count <
+    set_object_count < 1,
     T
-    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 {};
 }; // class use_app<app::cube>
@@ -619,7 +908,7 @@ public:
   void create() {
     auto buffers = parent::get_swapchain_command_buffers();
     auto swapchain_images = parent::get_swapchain_images();
-    auto queue_family_index = parent::get_queue_family_index();
+    PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2 = find_pipeline_barrier2(this);
     auto framebuffers = parent::get_framebuffers();
     std::vector<vk::Buffer> uniform_buffers =
         parent::get_uniform_buffer_vector();
@@ -628,23 +917,7 @@ public:
     std::vector<vk::DescriptorSet> descriptor_sets =
         parent::get_descriptor_set();
 
-    auto clear_color_value_type = parent::get_format_clear_color_value_type(
-        parent::get_swapchain_image_format());
-    using value_type = decltype(clear_color_value_type);
-    std::map<value_type, vk::ClearColorValue> clear_color_values{
-        {value_type::eFloat32,
-         vk::ClearColorValue{}.setFloat32({0.4f, 0.4f, 0.4f, 0.0f})},
-        {value_type::eUint32, vk::ClearColorValue{}.setUint32({50, 50, 50, 0})},
-    };
-    if (!clear_color_values.contains(clear_color_value_type)) {
-      throw std::runtime_error{"unsupported clear color value type"};
-    }
-    vk::ClearColorValue clear_color_value{
-        clear_color_values[clear_color_value_type]};
-    auto clear_depth_value = vk::ClearDepthStencilValue{}.setDepth(1.0f);
-    auto clear_values =
-        std::array{vk::ClearValue{}.setColor(clear_color_value),
-                   vk::ClearValue{}.setDepthStencil(clear_depth_value)};
+    auto clear_values = get_clear_values(this);
 
     if (buffers.size() != swapchain_images.size()) {
       throw std::runtime_error{
@@ -659,49 +932,51 @@ public:
 
       vk::Buffer uniform_buffer = uniform_buffers[index];
       vk::Buffer upload_buffer = uniform_upload_buffers[index];
-      cmd.copyBuffer(upload_buffer, uniform_buffer,
-                     vk::BufferCopy{}.setSize(sizeof(uint64_t)));
-      auto uniform_buffer_memory_barrier =
-          vk::BufferMemoryBarrier{}
-              .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
-              .setDstAccessMask(vk::AccessFlagBits::eUniformRead)
-              .setSrcQueueFamilyIndex(queue_family_index)
-              .setDstQueueFamilyIndex(queue_family_index)
-              .setBuffer(uniform_buffer)
-              .setOffset(0)
-              .setSize(vk::WholeSize);
-      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                          vk::PipelineStageFlagBits::eVertexShader, {}, {},
-                          uniform_buffer_memory_barrier, {});
-
-      vk::RenderPass render_pass = parent::get_render_pass();
-
-      vk::Extent2D swapchain_image_extent =
-          parent::get_swapchain_image_extent();
-      auto render_area = vk::Rect2D{}
-                             .setOffset(vk::Offset2D{0, 0})
-                             .setExtent(swapchain_image_extent);
-      vk::Framebuffer framebuffer = framebuffers[index];
-      cmd.beginRenderPass(vk::RenderPassBeginInfo{}
-                              .setRenderPass(render_pass)
-                              .setRenderArea(render_area)
-                              .setFramebuffer(framebuffer)
-                              .setClearValues(clear_values),
-                          vk::SubpassContents::eInline);
-
-      vk::Pipeline pipeline = parent::get_pipeline();
-      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-
-      vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
-      vk::DescriptorSet descriptor_set = descriptor_sets[index];
-      cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
-                             0, descriptor_set, {});
-      cmd.drawMeshTasksEXT(1,1,1, *this);
-      cmd.endRenderPass();
+      // the render pass synchronizes its attachments, the graph the
+      // uniforms between the upload and the draw
+      render_graph graph;
+      auto uniforms = graph.import_buffer(uniform_buffer);
+      graph.add_pass("upload", {{uniforms, copy_destination}}, [&](vk::CommandBuffer cmd) {
+        cmd.copyBuffer(upload_buffer, uniform_buffer,
+                       vk::BufferCopy{}.setSize(sizeof(mat4) * parent::get_object_count()));
+      });
+      graph.add_pass("draw", {{uniforms, mesh_shader_uniform_read}}, [&](vk::CommandBuffer cmd) {
+        vk::RenderPass render_pass = parent::get_render_pass();
+
+        vk::Extent2D swapchain_image_extent =
+            parent::get_swapchain_image_extent();
+        auto render_area = vk::Rect2D{}
+                               .setOffset(vk::Offset2D{0, 0})
+                               .setExtent(swapchain_image_extent);
+        vk::Framebuffer framebuffer = framebuffers[index];
+        cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                                .setRenderPass(render_pass)
+                                .setRenderArea(render_area)
+                                .setFramebuffer(framebuffer)
+                                .setClearValues(clear_values),
+                            vk::SubpassContents::eInline);
+
+        vk::Pipeline pipeline = parent::get_pipeline();
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+
+        vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+        vk::DescriptorSet descriptor_set = descriptor_sets[index];
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                               0, descriptor_set, {});
+        cmd.drawMeshTasksEXT(parent::get_draw_instance_count(),1,1, *this);
+        cmd.endRenderPass();
+      });
+      graph.compile();
+      graph.execute(cmd, pipeline_barrier2);
       cmd.end();
     }
   }
   void destroy() {}
+  // lines per frame, each task work group emits the whole helix
+  uint64_t get_primitive_count() {
+    return uint64_t{helix_generator::segment_count} * helix_generator::samples_per_segment *
+           parent::get_draw_instance_count();
+  }
 }; // class record_swapchain_command_buffers in use_app<app::mesh_test>
 
 template <class T>
@@ -714,11 +989,18 @@ class add_physical_device
 
 template <class T> class add_resources_and_draw
   : public
+    profiled<
+    add_frame_allocation_check<
     add_frame_time_analyser<
     add_dynamic_draw <
-    add_get_time <
     add_process_suboptimal_image<
         decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_frame_timing <
+    add_procedural_geometry_update <
+    add_uniform_upload <
+    add_object_transforms <
+    add_clock <
+    add_memory_statistics<
     add_queue_wait_idle_to_recreate_surface<
     add_acquire_next_image_semaphores <
     add_acquire_next_image_semaphore_fences <
@@ -729,6 +1011,7 @@ template <class T> class add_resources_and_draw
     add_get_format_clear_color_value_type <
     add_recreate_surface_for<
     add_swapchain_command_buffers <
+    add_procedural_geometry<helix_generator, 1,
     write_descriptor_set<
     add_nonfree_descriptor_set<
     add_descriptor_pool<
@@ -749,7 +1032,7 @@ template <class T> class add_resources_and_draw
     add_buffer_usage<vk::BufferUsageFlagBits::eTransferDst,
     add_buffer_usage<vk::BufferUsageFlagBits::eUniformBuffer,
     empty_buffer_usage<
-    set_buffer_size<sizeof(uint64_t),
+    set_buffer_size_to_object_matrices<
     add_recreate_surface_for<
     add_graphics_pipeline <
     add_pipeline_vertex_input_state <
@@ -777,8 +1060,10 @@ template <class T> class add_resources_and_draw
     add_viewport_equal_swapchain_image_rect <
     add_empty_viewports <
     set_tessellation_patch_control_point_count < 1,
+    add_draw_instance_count <
+    set_object_count < 1,
     T
-    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 
 {};
 }; // class use_app<app::mesh_test>
@@ -786,45 +1071,27 @@ template <class T> class add_resources_and_draw
 
 
 
+// moves the depth images into the layout the render pass uses them in. the
+// render pass clears them when it loads them, so the transition has to be
+// done by its depth tests and waits for nothing
 static void water_chika_vulkan_barrier_depth_image_layout(
-    vk::Device device, uint32_t queue_family_index, vk::Queue queue,
+    vk::Device device, PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2, vk::Queue queue,
     vk::CommandPool cmd_pool, std::vector<vk::Image> images) {
-  auto cmds = device.allocateCommandBuffers(
-      vk::CommandBufferAllocateInfo{}
-          .setCommandPool(cmd_pool)
-          .setLevel(vk::CommandBufferLevel::ePrimary)
-          .setCommandBufferCount(1));
-  auto cmd = cmds[0];
-
-  cmd.begin(vk::CommandBufferBeginInfo{});
-
-  std::vector<vk::ImageMemoryBarrier> depth_image_barriers(images.size());
-  std::ranges::transform(
-      images, depth_image_barriers.begin(), [queue_family_index](auto &image) {
-        return vk::ImageMemoryBarrier{}
-            .setSrcAccessMask(vk::AccessFlagBits::eNone)
-            .setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
-            .setSrcQueueFamilyIndex(queue_family_index)
-            .setDstQueueFamilyIndex(queue_family_index)
-            .setOldLayout(vk::ImageLayout::eUndefined)
-            .setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
-            .setImage(image)
-            .setSubresourceRange(
-                vk::ImageSubresourceRange{}
-                    .setAspectMask(vk::ImageAspectFlagBits::eDepth)
-                    .setLevelCount(1)
-                    .setLayerCount(1));
-      });
-
-  cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
-                      vk::PipelineStageFlagBits::eAllCommands, {}, {},
-                      {}, depth_image_barriers);
-  cmd.end();
-
-  queue.submit(vk::SubmitInfo{}.setCommandBuffers(cmd));
-  queue.waitIdle();
-
-  device.freeCommandBuffers(cmd_pool, cmd);
+  render_graph graph;
+  std::vector<std::pair<render_graph::resource, resource_use>> uses;
+  for (vk::Image image : images) {
+    auto depth = graph.import_image(image, vk::ImageSubresourceRange{}
+                                               .setAspectMask(vk::ImageAspectFlagBits::eDepth)
+                                               .setLevelCount(1)
+                                               .setLayerCount(1));
+    uses.emplace_back(depth, depth_attachment_read_write);
+  }
+  graph.add_pass("depth attachments", std::move(uses), {});
+  graph.compile();
+  water_chika_vulkan_submit_once(device, queue, cmd_pool,
+                                 [&graph, pipeline_barrier2](vk::CommandBuffer cmd) {
+                                   graph.execute(cmd, pipeline_barrier2);
+                                 });
 }
 
 template <class T> class barrier_depth_image_layout : public T {
@@ -837,10 +1104,9 @@ public:
     auto device = parent::get_device();
     auto cmd_pool = parent::get_command_pool();
     auto images = parent::get_images();
-    auto queue_family_index = parent::get_queue_family_index();
     auto queue = parent::get_queue();
-    water_chika_vulkan_barrier_depth_image_layout(device, queue_family_index,
-                                                  queue, cmd_pool, images);
+    water_chika_vulkan_barrier_depth_image_layout(device, find_pipeline_barrier2(this), queue,
+                                                  cmd_pool, images);
   }
   void destroy() {
   }
@@ -860,6 +1126,7 @@ using namespace vulkan_hpp_helper;
 
 template <class T> class add_cube_swapchain_and_pipeline_layout
   : public
+  profiled<
   add_pipeline_layout<
 	add_single_descriptor_set_layout<
 	add_descriptor_set_layout<
@@ -897,14 +1164,15 @@ template <class T> class add_cube_swapchain_and_pipeline_layout
 	add_recreate_surface_for<
 	add_swapchain_images<
 	add_recreate_surface_for<
-	add_swapchain<
+	add_configured_swapchain<
 	add_swapchain_image_format<
   T
-  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 {};
 
 template <class T> class add_mesh_swapchain_and_pipeline_layout
   : public
+  profiled<
   add_pipeline_layout<
 	add_single_descriptor_set_layout<
 	add_descriptor_set_layout<
@@ -942,10 +1210,10 @@ template <class T> class add_mesh_swapchain_and_pipeline_layout
 	add_recreate_surface_for<
 	add_swapchain_images<
 	add_recreate_surface_for<
-	add_swapchain<
+	add_configured_swapchain<
 	add_swapchain_image_format<
   T
-  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 {};
 
 template <class T> class add_dummy_recreate_surface : public T {
@@ -959,11 +1227,12 @@ public:
 template<class T>
 class add_physical_device_and_surface
     : public
-    use_app<APP>::template add_physical_device<
+    profiled<
+    typename use_app<APP>::template add_physical_device<
     add_recreate_surface<
     typename use_platform<PLATFORM>::template add_vulkan_surface<
     T
-    >>>
+    >>>>
 {};
 };
 
@@ -973,18 +1242,19 @@ public:
 template<class T>
 class add_cube_physical_device_and_device_and_draw
     : public
+    profiled<
     use_app<app::cube>::add_resources_and_draw<
-    add_spirv_file_to_pipeline_stages<
+	add_cube_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+    add_deferred_spirv_file_to_pipeline_stages<
         decltype([]() {return std::string{"shaders/cube_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
-    add_spirv_file_to_pipeline_stages<
+    add_deferred_spirv_file_to_pipeline_stages<
         decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
-	set_shader_entry_name_with_main <
 	add_empty_pipeline_stages <
-	add_cube_swapchain_and_pipeline_layout<
-    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+	add_job_system <
 	add_command_pool <
 	add_queue <
-	add_device <
+	add_device_with_optional_present_wait <
 	add_swapchain_extension <
 	add_empty_extensions <
 	add_find_properties <
@@ -996,7 +1266,7 @@ class add_cube_physical_device_and_device_and_draw
 	add_queue_family_index <
   typename set_app_and_platform<app::cube, PLATFORM>::template add_physical_device_and_surface<
   T
-  >>>>>>>>>>>>>>>>>>>>
+  >>>>>>>>>>>>>>>>>>>>>
 {};
 }; // class use_platform_*
 
@@ -1007,17 +1277,18 @@ public:
 template<class T>
 class add_mesh_physical_device_and_device_and_draw
     : public
+    profiled<
     use_app<app::mesh_test>::add_resources_and_draw<
-    add_spirv_file_to_pipeline_stages<
+	add_mesh_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+    add_deferred_spirv_file_to_pipeline_stages<
         decltype([]() {return std::string{"shaders/task.spv"};}), vk::ShaderStageFlagBits::eTaskEXT,
-    add_spirv_file_to_pipeline_stages<
+    add_deferred_spirv_file_to_pipeline_stages<
         decltype([]() {return std::string{"shaders/mesh.spv"};}), vk::ShaderStageFlagBits::eMeshEXT,
-    add_spirv_file_to_pipeline_stages<
+    add_deferred_spirv_file_to_pipeline_stages<
         decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
-	set_shader_entry_name_with_main <
 	add_empty_pipeline_stages <
-	add_mesh_swapchain_and_pipeline_layout<
-    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+	add_job_system <
 	add_command_pool <
 	add_queue <
 	add_device_with_features <
@@ -1048,7 +1319,7 @@ class add_mesh_physical_device_and_device_and_draw
 	add_queue_family_index <
   typename set_app_and_platform<app::mesh_test, PLATFORM>::template add_physical_device_and_surface<
   T
-  >>>>>>>>>>>>>>>>>>>>>>
+  >>>>>>>>>>>>>>>>>>>>>>>
 {};
 }; // class use_platform_*
 
@@ -1058,11 +1329,12 @@ public:
 template<class T>
 class add_physical_device_and_surface
     : public
+    profiled<
     add_recreate_surface<
     use_platform<platform::display>::add_vulkan_surface<
     typename use_app<APP>::template add_physical_device<
     T
-    >>>
+    >>>>
 {};
 };
 
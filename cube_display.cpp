@@ -1,18 +1,43 @@
 #define VK_USE_PLATFORM_DISPLAY_KHR
 #include "cube.hpp"
 
+#include <string>
+
+template<uint32_t FPS>
+class paced_at {
+public:
+template<class T>
+using add_cube =
+  vulkan_start::set_target_frame_rate<FPS,
+  vulkan_start::use_platform_add_cube_physical_device_and_device_and_draw<vulkan_start::platform::display>::
+    add_cube_physical_device_and_device_and_draw<
+  T
+  >>
+;
+};
+
 using app =
   vulkan_start::run_on_platform<vulkan_start::platform::display,
-      vulkan_start::use_platform_add_cube_physical_device_and_device_and_draw<vulkan_start::platform::display>::
-        add_cube_physical_device_and_device_and_draw
+      paced_at<60>::add_cube
   >
 ;
+using uncapped_app =
+  vulkan_start::run_on_platform<vulkan_start::platform::display,
+      paced_at<0>::add_cube
+  >
+;
+
+using namespace std::literals;
 
-int main() {
+int main(int argc, const char* argv[]) {
     try{
       //auto conf = cpp_helper::empty_configure{};
         vulkan_start::empty_configure conf{};
-        app t{conf};
+        if (argc > 1 && "uncapped"s == argv[1]) {
+            uncapped_app t{conf};
+        } else {
+            app t{conf};
+        }
     }
     catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
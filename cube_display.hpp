@@ -1,34 +1,168 @@
 #pragma once
 
 #ifdef linux
-#include <poll.h>
+#include <cerrno>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 #endif
 
 #include <cpp_helper.hpp>
 
 namespace vulkan_start{
+
+// frames per second add_run_loop paces draw() at, 0 draws back to back
+template<uint32_t FPS, class T>
+class set_target_frame_rate : public T {
+public:
+    using parent = T;
+    set_target_frame_rate(const configure auto& conf) : parent{conf} {}
+    static constexpr uint32_t get_target_frame_rate() { return FPS; }
+};
+
+// blocks SIGINT and SIGTERM for add_run_loop, which takes them from a
+// signalfd. as the innermost layer it blocks them before the layers above
+// start their threads, which inherit the mask, so no thread is picked to run
+// the default handler. the old mask is restored once those threads are
+// joined
+template<class T>
+class block_run_loop_signals : public T {
+public:
+    using parent = T;
+    block_run_loop_signals(const configure auto& conf) : parent{conf} {
+#ifdef linux
+        sigemptyset(&m_signals);
+        sigaddset(&m_signals, SIGINT);
+        sigaddset(&m_signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &m_signals, &m_old_signals);
+#endif
+    }
+#ifdef linux
+    ~block_run_loop_signals() {
+        pthread_sigmask(SIG_SETMASK, &m_old_signals, nullptr);
+    }
+    const sigset_t& get_run_loop_signals() { return m_signals; }
+private:
+    sigset_t m_signals;
+    sigset_t m_old_signals;
+#endif
+};
+
+// draws until stdin becomes readable, where it can be watched, or
+// SIGINT/SIGTERM arrives. paced, it sleeps in epoll_wait until a timerfd
+// tick, so the thread is idle between frames; uncapped, it draws back to
+// back and only polls the fds, which is what benchmarks want
 template<class T>
 class add_run_loop : public T {
 public:
     using parent = T;
     add_run_loop(const configure auto& conf) : parent{conf} {
 #ifdef linux
-        while (true) {
-            parent::draw();
-
-            pollfd fds[1];
-            fds[0].fd = STDIN_FILENO;
-            fds[0].events = POLLRDNORM;
-            int timeout_ms = 0;
-            int poll_ret = poll(fds, 1, timeout_ms);
-            if (poll_ret > 0) {
-                break;
-            }
-        }
+        run();
 #else
         throw std::runtime_error{"unsupported platform"};
 #endif
     }
+#ifdef linux
+private:
+    struct file_descriptor {
+        int fd;
+        explicit file_descriptor(int fd) : fd{fd} {
+            if (fd < 0) {
+                throw std::runtime_error{"failed to create file descriptor for run loop"};
+            }
+        }
+        file_descriptor(const file_descriptor&) = delete;
+        ~file_descriptor() { close(fd); }
+    };
+    void run() {
+        file_descriptor epoll{epoll_create1(EPOLL_CLOEXEC)};
+        // stdin redirected from /dev/null or a regular file can't be
+        // watched, the run then only ends on a signal
+        if (!try_watch(epoll.fd, STDIN_FILENO) && errno != EPERM) {
+            throw std::runtime_error{"failed to add stdin to epoll"};
+        }
+
+        // blocked by block_run_loop_signals, so they are delivered through
+        // the signalfd instead of the default handler
+        const sigset_t& signals = parent::get_run_loop_signals();
+        file_descriptor signal{signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK)};
+        watch(epoll.fd, signal.fd);
+
+        constexpr uint32_t frame_rate = parent::get_target_frame_rate();
+        constexpr long interval_ns = frame_rate > 0 ? 1000000000L / frame_rate : 0;
+        file_descriptor timer{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)};
+        bool timer_armed = false;
+        if constexpr (frame_rate > 0) {
+            set_timer(timer.fd, interval_ns);
+            timer_armed = true;
+            watch(epoll.fd, timer.fd);
+        }
+
+        bool running = true;
+        while (running) {
+            // an app that tracks damage and has nothing new to show waits
+            // for the next event, even uncapped
+            bool idle = false;
+            if constexpr (damage_trackable<parent>) {
+                idle = !parent::needs_redraw();
+            }
+            // paced, the timer only runs while there is something to draw,
+            // so an idle app isn't woken at the frame rate
+            if constexpr (frame_rate > 0) {
+                if (idle == timer_armed) {
+                    set_timer(timer.fd, idle ? 0 : interval_ns);
+                    timer_armed = !idle;
+                }
+            }
+            epoll_event events[3];
+            int timeout_ms = frame_rate == 0 && !idle ? 0 : -1;
+            int count = epoll_wait(epoll.fd, events, 3, timeout_ms);
+            if (count < 0 && errno != EINTR) {
+                throw std::runtime_error{"epoll_wait failed"};
+            }
+            bool tick = frame_rate == 0 && !idle;
+            for (int i = 0; i < count; i++) {
+                if (events[i].data.fd == timer.fd) {
+                    // missed ticks are dropped, not drawn late in a burst
+                    uint64_t expirations;
+                    if (read(timer.fd, &expirations, sizeof(expirations)) < 0) {
+                        // disarmed after the tick was polled
+                        if (errno != EAGAIN) {
+                            throw std::runtime_error{"failed to read frame timer"};
+                        }
+                        continue;
+                    }
+                    tick = true;
+                } else {
+                    running = false;
+                }
+            }
+            if (running && tick) {
+                parent::draw();
+            }
+        }
+    }
+    // ticks every interval_ns from now on, 0 disarms the timer
+    static void set_timer(int timer_fd, long interval_ns) {
+        auto interval = timespec{interval_ns / 1000000000L, interval_ns % 1000000000L};
+        auto spec = itimerspec{.it_interval = interval, .it_value = interval};
+        if (timerfd_settime(timer_fd, 0, &spec, nullptr) != 0) {
+            throw std::runtime_error{"failed to set frame timer"};
+        }
+    }
+    static bool try_watch(int epoll_fd, int fd) {
+        auto event = epoll_event{.events = EPOLLIN, .data = {.fd = fd}};
+        return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+    static void watch(int epoll_fd, int fd) {
+        if (!try_watch(epoll_fd, fd)) {
+            throw std::runtime_error{"failed to add fd to epoll"};
+        }
+    }
+#endif
 };
 
 
@@ -118,12 +252,20 @@ public:
 }; // class add_event_loop
 
 template<class T>
-class add_window : T {
+class add_window : public block_run_loop_signals<T> {
 public:
-    using parent = T;
+    using parent = block_run_loop_signals<T>;
     add_window(const configure auto& conf) : parent{conf} {}
 };
 
+// add_run_loop paces the display already
+template<class T>
+class add_frame_pacing : public T {
+public:
+    using parent = T;
+    add_frame_pacing(const configure auto& conf) : parent{conf} {}
+};
+
 }; // class use_platform<platform::display>
 
 
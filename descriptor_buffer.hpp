@@ -0,0 +1,585 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "cube.hpp"
+
+namespace vulkan_start {
+
+// thrown while the stack is built when the device lacks
+// VK_EXT_descriptor_buffer, the app can fall back to a descriptor pool stack
+class descriptor_buffer_unsupported : public std::runtime_error {
+public:
+  descriptor_buffer_unsupported()
+      : std::runtime_error{"device does not support VK_EXT_descriptor_buffer"} {}
+};
+
+template <class T> class check_descriptor_buffer_support : public T {
+public:
+  using parent = T;
+  check_descriptor_buffer_support(const configure auto& conf) : parent{conf} {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    auto available = physical_device.enumerateDeviceExtensionProperties();
+    bool has_extension = std::ranges::any_of(available, [](auto& p) {
+      return std::string_view{vk::EXTDescriptorBufferExtensionName} ==
+             std::string_view{p.extensionName};
+    });
+    if (!has_extension) {
+      throw descriptor_buffer_unsupported{};
+    }
+    auto features = physical_device.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features,
+        vk::PhysicalDeviceDescriptorBufferFeaturesEXT>();
+    if (!features.get<vk::PhysicalDeviceVulkan12Features>().bufferDeviceAddress ||
+        !features.get<vk::PhysicalDeviceDescriptorBufferFeaturesEXT>().descriptorBuffer) {
+      throw descriptor_buffer_unsupported{};
+    }
+  }
+};
+
+// the extension's entry points, passed as the dispatcher to the vk:: calls
+// like add_vk_cmd_draw_mesh_tasks_ext
+template <class T> class add_descriptor_buffer_ext_functions : public T {
+public:
+  using parent = T;
+  add_descriptor_buffer_ext_functions(const configure auto& conf) : parent{conf} {
+    vk::Device device = parent::get_device();
+    m_get_layout_size = reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
+        vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT"));
+    m_get_binding_offset = reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+        vkGetDeviceProcAddr(device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+    m_get_descriptor = reinterpret_cast<PFN_vkGetDescriptorEXT>(
+        vkGetDeviceProcAddr(device, "vkGetDescriptorEXT"));
+    m_cmd_bind_buffers = reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
+        vkGetDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT"));
+    m_cmd_set_offsets = reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
+        vkGetDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+    if (!m_get_layout_size || !m_get_binding_offset || !m_get_descriptor ||
+        !m_cmd_bind_buffers || !m_cmd_set_offsets) {
+      throw std::runtime_error{"failed to load VK_EXT_descriptor_buffer functions"};
+    }
+  }
+  static constexpr auto getVkHeaderVersion() {
+    return VK_HEADER_VERSION;
+  }
+  void vkGetDescriptorSetLayoutSizeEXT(VkDevice device, VkDescriptorSetLayout layout,
+                                       VkDeviceSize* size) const {
+    m_get_layout_size(device, layout, size);
+  }
+  void vkGetDescriptorSetLayoutBindingOffsetEXT(VkDevice device, VkDescriptorSetLayout layout,
+                                                uint32_t binding, VkDeviceSize* offset) const {
+    m_get_binding_offset(device, layout, binding, offset);
+  }
+  void vkGetDescriptorEXT(VkDevice device, const VkDescriptorGetInfoEXT* info, size_t size,
+                          void* descriptor) const {
+    m_get_descriptor(device, info, size, descriptor);
+  }
+  void vkCmdBindDescriptorBuffersEXT(VkCommandBuffer cmd, uint32_t count,
+                                     const VkDescriptorBufferBindingInfoEXT* infos) const {
+    m_cmd_bind_buffers(cmd, count, infos);
+  }
+  void vkCmdSetDescriptorBufferOffsetsEXT(VkCommandBuffer cmd, VkPipelineBindPoint bind_point,
+                                          VkPipelineLayout layout, uint32_t first_set,
+                                          uint32_t set_count, const uint32_t* buffer_indices,
+                                          const VkDeviceSize* offsets) const {
+    m_cmd_set_offsets(cmd, bind_point, layout, first_set, set_count, buffer_indices, offsets);
+  }
+
+private:
+  PFN_vkGetDescriptorSetLayoutSizeEXT m_get_layout_size;
+  PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_get_binding_offset;
+  PFN_vkGetDescriptorEXT m_get_descriptor;
+  PFN_vkCmdBindDescriptorBuffersEXT m_cmd_bind_buffers;
+  PFN_vkCmdSetDescriptorBufferOffsetsEXT m_cmd_set_offsets;
+};
+
+// the set layout of the descriptor set layout bindings below, created for
+// use in a descriptor buffer instead of a pool
+template <class T> class add_descriptor_buffer_set_layout : public T {
+public:
+  using parent = T;
+  add_descriptor_buffer_set_layout(const configure auto& conf) : parent{conf} {
+    vk::Device device = parent::get_device();
+    auto bindings = parent::get_descriptor_set_layout_bindings();
+    m_layout = device.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo{}
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT)
+            .setBindings(bindings));
+  }
+  ~add_descriptor_buffer_set_layout() {
+    vk::Device device = parent::get_device();
+    device.destroyDescriptorSetLayout(m_layout);
+  }
+  auto get_descriptor_set_layout() { return m_layout; }
+
+private:
+  vk::DescriptorSetLayout m_layout;
+};
+
+// a host coherent, mapped buffer whose device address can be taken. host
+// writes need no flush
+struct device_address_buffer {
+  vk::Buffer buffer;
+  vk::DeviceMemory memory;
+  void* ptr;
+  vk::DeviceAddress address;
+};
+
+inline device_address_buffer create_device_address_buffer(vk::PhysicalDevice physical_device,
+                                                          vk::Device device, vk::DeviceSize size,
+                                                          vk::BufferUsageFlags usage) {
+  auto result = device_address_buffer{};
+  result.buffer = device.createBuffer(
+      vk::BufferCreateInfo{}
+          .setSize(size)
+          .setUsage(usage | vk::BufferUsageFlagBits::eShaderDeviceAddress));
+  auto requirements = device.getBufferMemoryRequirements(result.buffer);
+  auto properties = physical_device.getMemoryProperties();
+  auto host_coherent =
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+  uint32_t type_index = 0;
+  for (; type_index < properties.memoryTypeCount; type_index++) {
+    if ((requirements.memoryTypeBits & (1u << type_index)) &&
+        (properties.memoryTypes[type_index].propertyFlags & host_coherent) == host_coherent) {
+      break;
+    }
+  }
+  if (type_index == properties.memoryTypeCount) {
+    device.destroyBuffer(result.buffer);
+    throw std::runtime_error{"no host coherent memory type for device address buffer"};
+  }
+  auto flags_info =
+      vk::MemoryAllocateFlagsInfo{}.setFlags(vk::MemoryAllocateFlagBits::eDeviceAddress);
+  result.memory = device.allocateMemory(vk::MemoryAllocateInfo{}
+                                            .setAllocationSize(requirements.size)
+                                            .setMemoryTypeIndex(type_index)
+                                            .setPNext(&flags_info));
+  device.bindBufferMemory(result.buffer, result.memory, 0);
+  result.ptr = device.mapMemory(result.memory, 0, vk::WholeSize);
+  result.address =
+      device.getBufferAddress(vk::BufferDeviceAddressInfo{}.setBuffer(result.buffer));
+  return result;
+}
+
+inline void destroy_device_address_buffer(vk::Device device, const device_address_buffer& buffer) {
+  device.unmapMemory(buffer.memory);
+  device.destroyBuffer(buffer.buffer);
+  device.freeMemory(buffer.memory);
+}
+
+// one uniform buffer of object matrices per swapchain image. descriptors in
+// a descriptor buffer point at buffers by device address
+template <class T> class add_device_address_uniform_buffers : public T {
+public:
+  using parent = T;
+  add_device_address_uniform_buffers(const configure auto& conf) : parent{conf} { create(); }
+  ~add_device_address_uniform_buffers() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    uint32_t count = parent::get_swapchain_images().size();
+    m_range = sizeof(mat4) * parent::get_object_count();
+    for (uint32_t i = 0; i < count; i++) {
+      m_buffers.push_back(create_device_address_buffer(
+          parent::get_physical_device(), device, m_range,
+          vk::BufferUsageFlagBits::eUniformBuffer));
+    }
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    for (auto& buffer : m_buffers) {
+      destroy_device_address_buffer(device, buffer);
+    }
+    m_buffers.clear();
+  }
+  uint32_t get_uniform_buffer_count() { return m_buffers.size(); }
+  const device_address_buffer& get_uniform_buffer(uint32_t index) { return m_buffers[index]; }
+  vk::DeviceSize get_uniform_buffer_range() { return m_range; }
+
+private:
+  std::vector<device_address_buffer> m_buffers;
+  vk::DeviceSize m_range;
+};
+
+// writes the object matrices in place once the image's fence signalled,
+// and the image's descriptor with them: no command buffer using the set is
+// pending, so it is rewritten the way an app whose buffers change per frame
+// would, a vkGetDescriptorEXT into mapped memory
+template <class T> class add_device_address_uniform_upload : public T {
+public:
+  using parent = T;
+  void upload_frame_data(uint32_t index) {
+    parent::update_object_transforms();
+    std::span<const mat4> matrices = parent::get_object_matrices();
+    const device_address_buffer& buffer = parent::get_uniform_buffer(index);
+    memcpy(buffer.ptr, matrices.data(), matrices.size_bytes());
+    parent::write_uniform_buffer_descriptor(index, 0, buffer.address,
+                                            parent::get_uniform_buffer_range());
+  }
+};
+
+// stores the descriptor sets in a mapped buffer, one set per swapchain
+// image at a stride of the layout's size. writing a descriptor is a
+// vkGetDescriptorEXT straight into the mapped memory, no pool, no set
+// allocation and no vkUpdateDescriptorSets, and binding a set is an offset
+template <class T> class add_descriptor_buffer : public T {
+public:
+  using parent = T;
+  add_descriptor_buffer(const configure auto& conf) : parent{conf} { create(); }
+  ~add_descriptor_buffer() { destroy(); }
+  void create() {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    vk::Device device = parent::get_device();
+    auto properties = physical_device.getProperties2<
+        vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+    m_properties = properties.get<vk::PhysicalDeviceDescriptorBufferPropertiesEXT>();
+    vk::DescriptorSetLayout layout = parent::get_descriptor_set_layout();
+    vk::DeviceSize alignment = m_properties.descriptorBufferOffsetAlignment;
+    m_set_stride = device.getDescriptorSetLayoutSizeEXT(layout, *this);
+    m_set_stride = (m_set_stride + alignment - 1) / alignment * alignment;
+    m_set_count = parent::get_swapchain_images().size();
+    m_buffer = create_device_address_buffer(
+        physical_device, device, m_set_stride * m_set_count,
+        vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT);
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    destroy_device_address_buffer(device, m_buffer);
+  }
+  // writes a uniform buffer descriptor into `binding` of set `set`
+  void write_uniform_buffer_descriptor(uint32_t set, uint32_t binding,
+                                       vk::DeviceAddress address, vk::DeviceSize range) {
+    vk::Device device = parent::get_device();
+    vk::DescriptorSetLayout layout = parent::get_descriptor_set_layout();
+    vk::DeviceSize offset = device.getDescriptorSetLayoutBindingOffsetEXT(layout, binding, *this);
+    auto address_info = vk::DescriptorAddressInfoEXT{}.setAddress(address).setRange(range);
+    device.getDescriptorEXT(vk::DescriptorGetInfoEXT{}
+                                .setType(vk::DescriptorType::eUniformBuffer)
+                                .setData(vk::DescriptorDataEXT{}.setPUniformBuffer(&address_info)),
+                            m_properties.uniformBufferDescriptorSize,
+                            static_cast<char*>(m_buffer.ptr) + set * m_set_stride + offset,
+                            *this);
+  }
+  vk::DeviceAddress get_descriptor_buffer_address() { return m_buffer.address; }
+  vk::DeviceSize get_descriptor_set_offset(uint32_t set) { return set * m_set_stride; }
+  uint32_t get_descriptor_buffer_set_count() { return m_set_count; }
+
+private:
+  vk::PhysicalDeviceDescriptorBufferPropertiesEXT m_properties;
+  vk::DeviceSize m_set_stride;
+  uint32_t m_set_count;
+  device_address_buffer m_buffer;
+};
+
+// points every image's set at the image's uniform buffer. the writes go to
+// host memory the device reads when a command buffer runs, so they are done
+// before any is submitted
+template <class T> class write_descriptor_buffer : public T {
+public:
+  using parent = T;
+  write_descriptor_buffer(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    uint32_t count = parent::get_descriptor_buffer_set_count();
+    if (parent::get_uniform_buffer_count() < count) {
+      throw std::runtime_error{"uniform buffers count < descriptor sets count"};
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      parent::write_uniform_buffer_descriptor(i, 0, parent::get_uniform_buffer(i).address,
+                                              parent::get_uniform_buffer_range());
+    }
+  }
+  void destroy() {}
+};
+
+// the cube pipeline for descriptor buffers, which pipelines have to opt into
+// at creation. viewport and scissor are dynamic, so the pipeline does not
+// follow the surface
+template <class T> class add_descriptor_buffer_graphics_pipeline : public T {
+public:
+  using parent = T;
+  add_descriptor_buffer_graphics_pipeline(const configure auto& conf) : parent{conf} {
+    vk::Device device = parent::get_device();
+    auto stages = parent::get_pipeline_stages();
+    auto binding = vk::VertexInputBindingDescription{}
+                       .setBinding(0)
+                       .setStride(sizeof(int16_t) * 4)
+                       .setInputRate(vk::VertexInputRate::eVertex);
+    auto attribute = vk::VertexInputAttributeDescription{}
+                         .setLocation(0)
+                         .setBinding(0)
+                         .setFormat(vk::Format::eR16G16B16A16Snorm)
+                         .setOffset(0);
+    auto vertex_input = vk::PipelineVertexInputStateCreateInfo{}
+                            .setVertexBindingDescriptions(binding)
+                            .setVertexAttributeDescriptions(attribute);
+    auto input_assembly = vk::PipelineInputAssemblyStateCreateInfo{}.setTopology(
+        vk::PrimitiveTopology::eTriangleList);
+    auto viewport = vk::PipelineViewportStateCreateInfo{}.setViewportCount(1).setScissorCount(1);
+    auto rasterization = vk::PipelineRasterizationStateCreateInfo{}
+                             .setPolygonMode(vk::PolygonMode::eFill)
+                             .setCullMode(vk::CullModeFlagBits::eNone)
+                             .setLineWidth(1.0f);
+    auto multisample = vk::PipelineMultisampleStateCreateInfo{}.setRasterizationSamples(
+        vk::SampleCountFlagBits::e1);
+    auto depth_stencil = vk::PipelineDepthStencilStateCreateInfo{}
+                             .setDepthTestEnable(vk::True)
+                             .setDepthWriteEnable(vk::True)
+                             .setDepthCompareOp(vk::CompareOp::eLess);
+    auto color_blend_attachment =
+        vk::PipelineColorBlendAttachmentState{}.setColorWriteMask(
+            vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+    auto color_blend =
+        vk::PipelineColorBlendStateCreateInfo{}.setAttachments(color_blend_attachment);
+    auto dynamic_states = std::array{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    auto dynamic = vk::PipelineDynamicStateCreateInfo{}.setDynamicStates(dynamic_states);
+    auto [res, pipeline] = device.createGraphicsPipeline(
+        nullptr, vk::GraphicsPipelineCreateInfo{}
+                     .setFlags(vk::PipelineCreateFlagBits::eDescriptorBufferEXT)
+                     .setStages(stages)
+                     .setPVertexInputState(&vertex_input)
+                     .setPInputAssemblyState(&input_assembly)
+                     .setPViewportState(&viewport)
+                     .setPRasterizationState(&rasterization)
+                     .setPMultisampleState(&multisample)
+                     .setPDepthStencilState(&depth_stencil)
+                     .setPColorBlendState(&color_blend)
+                     .setPDynamicState(&dynamic)
+                     .setLayout(parent::get_pipeline_layout())
+                     .setRenderPass(parent::get_render_pass())
+                     .setSubpass(0));
+    if (res != vk::Result::eSuccess) {
+      throw std::runtime_error{"failed to create descriptor buffer graphics pipeline"};
+    }
+    m_pipeline = pipeline;
+  }
+  ~add_descriptor_buffer_graphics_pipeline() {
+    vk::Device device = parent::get_device();
+    device.destroyPipeline(m_pipeline);
+  }
+  auto get_pipeline() { return m_pipeline; }
+
+private:
+  vk::Pipeline m_pipeline;
+};
+
+template<>
+class use_app<app::cube_descriptor_buffer> {
+public:
+
+// the cube demo's command buffers with the set bound as an offset into the
+// descriptor buffer
+template <class T> class record_swapchain_command_buffers : public T {
+public:
+  using parent = T;
+  record_swapchain_command_buffers(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    auto buffers = parent::get_swapchain_command_buffers();
+    auto swapchain_images = parent::get_swapchain_images();
+    auto framebuffers = parent::get_framebuffers();
+
+    auto clear_values = get_clear_values(this);
+
+    if (buffers.size() != swapchain_images.size()) {
+      throw std::runtime_error{
+          "swapchain images count != command buffers count"};
+    }
+    if (parent::get_descriptor_buffer_set_count() < buffers.size()) {
+      throw std::runtime_error{"swapchain images count > descriptor sets count"};
+    }
+    auto descriptor_buffer_binding =
+        vk::DescriptorBufferBindingInfoEXT{}
+            .setAddress(parent::get_descriptor_buffer_address())
+            .setUsage(vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT);
+    for (uint32_t index = 0; index < buffers.size(); index++) {
+      vk::CommandBuffer cmd = buffers[index];
+
+      cmd.begin(vk::CommandBufferBeginInfo{});
+
+      vk::RenderPass render_pass = parent::get_render_pass();
+      vk::Extent2D swapchain_image_extent =
+          parent::get_swapchain_image_extent();
+      auto render_area = vk::Rect2D{}
+                             .setOffset(vk::Offset2D{0, 0})
+                             .setExtent(swapchain_image_extent);
+      cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                              .setRenderPass(render_pass)
+                              .setRenderArea(render_area)
+                              .setFramebuffer(framebuffers[index])
+                              .setClearValues(clear_values),
+                          vk::SubpassContents::eInline);
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, parent::get_pipeline());
+      cmd.setViewport(0, vk::Viewport{}
+                             .setWidth(swapchain_image_extent.width)
+                             .setHeight(swapchain_image_extent.height)
+                             .setMaxDepth(1.0f));
+      cmd.setScissor(0, render_area);
+      vk::Buffer vertex_buffer = parent::get_vertex_buffer();
+      cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+      vk::Buffer index_buffer = parent::get_index_buffer();
+      cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
+
+      vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+      cmd.bindDescriptorBuffersEXT(descriptor_buffer_binding, *this);
+      uint32_t buffer_index = 0;
+      vk::DeviceSize offset = parent::get_descriptor_set_offset(index);
+      cmd.setDescriptorBufferOffsetsEXT(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                                        0, buffer_index, offset, *this);
+      cmd.drawIndexed(3 * 2 * 3 * 2, 1, 0, 0, 0);
+      cmd.endRenderPass();
+      cmd.end();
+    }
+  }
+  void destroy() {}
+}; // class record_swapchain_command_buffers in use_app<app::cube_descriptor_buffer>
+
+template <class T>
+class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
+};
+
+template <class T> class add_resources_and_draw
+  : public
+    profiled<
+    add_frame_allocation_check<
+    add_frame_time_analyser<
+    add_dynamic_draw <
+    add_process_suboptimal_image<
+        decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_queue_wait_idle_to_recreate_surface<
+    add_device_address_uniform_upload <
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_clock <
+    add_acquire_next_image_semaphores <
+    add_acquire_next_image_semaphore_fences <
+    add_draw_semaphores <
+    add_recreate_surface_for<
+    vulkan_start::use_app<vulkan_start::app::cube_descriptor_buffer>::record_swapchain_command_buffers<
+    add_get_format_clear_color_value_type <
+    add_recreate_surface_for<
+    add_swapchain_command_buffers <
+    add_recreate_surface_for<
+    write_descriptor_buffer<
+    add_recreate_surface_for<
+    add_descriptor_buffer<
+    add_recreate_surface_for<
+    add_device_address_uniform_buffers<
+    add_buffer_memory_with_data_copy<
+    rename_buffer_to_index_buffer<
+    add_buffer_as_member<
+    set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
+    add_optimized_cube_index_buffer_data<
+    add_buffer_memory_with_data_copy <
+    rename_buffer_to_vertex_buffer<
+    add_buffer_as_member <
+    set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
+    add_optimized_cube_vertex_buffer_data <
+    add_descriptor_buffer_graphics_pipeline <
+    add_recreate_surface_for<
+    add_framebuffers_cube <
+    add_render_pass_cube <
+    add_subpasses <
+    add_subpass_dependency <
+    add_empty_subpass_dependencies <
+    add_depth_attachment<
+    add_attachment <
+    add_empty_attachments <
+    set_object_count < 1,
+    T
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+{};
+}; // class use_app<app::cube_descriptor_buffer>
+
+template <class T> class add_descriptor_buffer_swapchain_and_pipeline_layout
+  : public
+  profiled<
+  add_pipeline_layout<
+	add_single_descriptor_set_layout<
+	add_descriptor_buffer_set_layout<
+	add_cube_descriptor_set_layout_binding<
+	rename_images_views_to_depth_images_views<
+	add_recreate_surface_for<
+	barrier_depth_image_layout<
+	add_recreate_surface_for<
+	add_depth_images_views_cube<
+	add_recreate_surface_for<
+	add_images_memories<
+	add_image_memory_property<vk::MemoryPropertyFlagBits::eDeviceLocal,
+	add_empty_image_memory_properties<
+	add_recreate_surface_for<
+	add_images<
+	add_image_type<vk::ImageType::e2D,
+	set_image_tiling<vk::ImageTiling::eOptimal,
+	set_image_samples<vk::SampleCountFlagBits::e1,
+	add_image_extent_equal_swapchain_image_extent<
+	add_image_usage<vk::ImageUsageFlagBits::eDepthStencilAttachment,
+	add_empty_image_usages<
+	rename_image_format_to_depth_image_format<
+	add_image_format<vk::Format::eD32Sfloat,
+	add_image_count_equal_swapchain_image_count<
+	add_recreate_surface_for<
+	add_swapchain_images_views<
+	add_recreate_surface_for<
+	add_swapchain_images<
+	add_recreate_surface_for<
+	add_configured_swapchain<
+	add_swapchain_image_format<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+{};
+
+template<platform PLATFORM>
+class use_platform_add_cube_descriptor_buffer_physical_device_and_device_and_draw {
+public:
+
+template<class T>
+class add_cube_descriptor_buffer_physical_device_and_device_and_draw
+    : public
+    profiled<
+    use_app<app::cube_descriptor_buffer>::add_resources_and_draw<
+	add_descriptor_buffer_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+    add_deferred_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
+    add_deferred_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
+	add_empty_pipeline_stages <
+	add_job_system <
+	add_command_pool <
+	add_queue <
+	add_descriptor_buffer_ext_functions <
+	add_device_with_features <
+        decltype(
+            []() {
+                auto features = vk::StructureChain<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceVulkan12Features,
+                vk::PhysicalDeviceDescriptorBufferFeaturesEXT
+                >{};
+                auto& [features2, vulkan12_features, descriptor_buffer_features] = features;
+                vulkan12_features.bufferDeviceAddress = vk::True;
+                descriptor_buffer_features.descriptorBuffer = vk::True;
+                return features;
+            }
+        )
+        ,
+	add_swapchain_extension <
+    add_extension<decltype([]() { return vk::EXTDescriptorBufferExtensionName; }),
+	add_empty_extensions <
+	check_descriptor_buffer_support <
+	add_find_properties <
+	cache_physical_device_memory_properties<
+	add_recreate_surface_for<
+	cache_surface_capabilities<
+	add_recreate_surface_for<
+	test_physical_device_support_surface<
+	add_queue_family_index <
+  typename set_app_and_platform<app::cube_descriptor_buffer, PLATFORM>::template add_physical_device_and_surface<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>>>
+{};
+}; // class use_platform_*
+
+} // namespace vulkan_start
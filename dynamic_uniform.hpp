@@ -0,0 +1,354 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "cube.hpp"
+
+namespace vulkan_start {
+
+// per object transforms in one uniform buffer, read through a single
+// dynamic uniform buffer descriptor. every swapchain image owns a frame
+// slice of the buffer and every object a slice of that, the offset passed
+// to bindDescriptorSets picks one. the descriptor set is allocated and
+// written once and survives surface recreation, nothing else depends on
+// the swapchain image count
+template <class T> class add_dynamic_uniform_descriptor_set_layout_binding : public T {
+public:
+  using parent = T;
+  add_dynamic_uniform_descriptor_set_layout_binding(const configure auto& conf) : parent{conf} {
+    m_binding = vk::DescriptorSetLayoutBinding{}
+                    .setBinding(0)
+                    .setDescriptorCount(1)
+                    .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+                    .setStageFlags(vk::ShaderStageFlagBits::eVertex);
+  }
+  auto get_descriptor_set_layout_bindings() { return m_binding; }
+
+private:
+  vk::DescriptorSetLayoutBinding m_binding;
+};
+
+// the slice layout. an object slice holds one matrix and is padded to the
+// device's dynamic offset alignment, and to the non coherent atom size so a
+// frame slice can be flushed on its own. the frame slices are counted once,
+// the swapchain keeps its configured image count when it is recreated
+template <class T> class add_dynamic_uniform_slices : public T {
+public:
+  using parent = T;
+  add_dynamic_uniform_slices(const configure auto& conf) : parent{conf} {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    auto limits = physical_device.getProperties().limits;
+    vk::DeviceSize alignment =
+        std::max(limits.minUniformBufferOffsetAlignment, limits.nonCoherentAtomSize);
+    m_object_stride = (sizeof(mat4) + alignment - 1) / alignment * alignment;
+    m_frame_stride = m_object_stride * parent::get_object_count();
+    m_frame_count = parent::get_swapchain_images().size();
+  }
+  vk::DeviceSize get_buffer_size() { return m_frame_stride * m_frame_count; }
+  uint32_t get_dynamic_uniform_frame_count() { return m_frame_count; }
+  vk::DeviceSize get_dynamic_uniform_frame_stride() { return m_frame_stride; }
+  // dynamic offset of an object's transform in the slice of frame `index`
+  uint32_t get_dynamic_uniform_offset(uint32_t index, uint32_t object) {
+    return static_cast<uint32_t>(index * m_frame_stride + object * m_object_stride);
+  }
+
+private:
+  vk::DeviceSize m_object_stride;
+  vk::DeviceSize m_frame_stride;
+  uint32_t m_frame_count;
+};
+
+template <uint32_t SIZE, class T> class set_vector_size : public T {
+public:
+  using parent = T;
+  auto get_vector_size() { return SIZE; }
+};
+
+template <class T> class rename_buffer_memory_vector_to_uniform_buffer_memory_vector : public T {
+public:
+  using parent = T;
+  decltype(auto) get_uniform_buffer_memory_vector() { return parent::get_buffer_memory_vector(); }
+};
+template <class T> class rename_buffer_memory_ptr_vector_to_uniform_buffer_memory_ptr_vector : public T {
+public:
+  using parent = T;
+  decltype(auto) get_uniform_buffer_memory_ptr_vector() { return parent::get_buffer_memory_ptr_vector(); }
+};
+
+// the one write of the shared set, its range is a single object slice
+template <class T> class write_dynamic_uniform_descriptor_set : public T {
+public:
+  using parent = T;
+  write_dynamic_uniform_descriptor_set(const configure auto& conf) : parent{conf} {
+    vk::Device device = parent::get_device();
+    vk::Buffer buffer = parent::get_uniform_buffer_vector()[0];
+    vk::DescriptorSet set = parent::get_descriptor_set()[0];
+    auto buffer_info = vk::DescriptorBufferInfo{}.setBuffer(buffer).setRange(sizeof(mat4));
+    device.updateDescriptorSets(vk::WriteDescriptorSet{}
+                                    .setDstSet(set)
+                                    .setDescriptorCount(1)
+                                    .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+                                    .setDstBinding(0)
+                                    .setBufferInfo(buffer_info),
+                                {});
+  }
+};
+
+// writes the object matrices straight into the frame slice of the mapped
+// buffer, the image's fence was waited for so the device is done reading it
+template <class T> class add_dynamic_uniform_upload : public T {
+public:
+  using parent = T;
+  add_dynamic_uniform_upload(const configure auto& conf)
+      : parent{conf},
+        m_memory_ptr{static_cast<char*>(parent::get_uniform_buffer_memory_ptr_vector()[0])},
+        m_memory{parent::get_uniform_buffer_memory_vector()[0]} {}
+  void upload_frame_data(uint32_t index) {
+    if (index >= parent::get_dynamic_uniform_frame_count()) {
+      throw std::runtime_error{"swapchain image index >= dynamic uniform frame slices count"};
+    }
+    vk::Device device = parent::get_device();
+    parent::update_object_transforms();
+    std::span<const mat4> matrices = parent::get_object_matrices();
+    for (uint32_t i = 0; i < matrices.size(); i++) {
+      memcpy(m_memory_ptr + parent::get_dynamic_uniform_offset(index, i), &matrices[i],
+             sizeof(mat4));
+    }
+    device.flushMappedMemoryRanges(vk::MappedMemoryRange{}
+                                       .setMemory(m_memory)
+                                       .setOffset(parent::get_dynamic_uniform_offset(index, 0))
+                                       .setSize(parent::get_dynamic_uniform_frame_stride()));
+  }
+
+private:
+  char* m_memory_ptr;
+  vk::DeviceMemory m_memory;
+};
+
+template<>
+class use_app<app::cube_dynamic_uniform> {
+public:
+
+// recorded once per image like the cube demo, one draw per object with
+// the set bound at the object's dynamic offset
+template <class T> class record_swapchain_command_buffers : public T {
+public:
+  using parent = T;
+  record_swapchain_command_buffers(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    auto buffers = parent::get_swapchain_command_buffers();
+    auto swapchain_images = parent::get_swapchain_images();
+    auto framebuffers = parent::get_framebuffers();
+    vk::DescriptorSet descriptor_set = parent::get_descriptor_set()[0];
+    uint32_t object_count = parent::get_object_count();
+    uint32_t index_count = 3 * 2 * 3 * 2;
+
+    auto clear_values = get_clear_values(this);
+
+    if (buffers.size() != swapchain_images.size()) {
+      throw std::runtime_error{
+          "swapchain images count != command buffers count"};
+    }
+    for (uint32_t index = 0; index < buffers.size(); index++) {
+      vk::CommandBuffer cmd = buffers[index];
+
+      cmd.begin(vk::CommandBufferBeginInfo{});
+
+      vk::RenderPass render_pass = parent::get_render_pass();
+      vk::Extent2D swapchain_image_extent =
+          parent::get_swapchain_image_extent();
+      auto render_area = vk::Rect2D{}
+                             .setOffset(vk::Offset2D{0, 0})
+                             .setExtent(swapchain_image_extent);
+      cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                              .setRenderPass(render_pass)
+                              .setRenderArea(render_area)
+                              .setFramebuffer(framebuffers[index])
+                              .setClearValues(clear_values),
+                          vk::SubpassContents::eInline);
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, parent::get_pipeline());
+      vk::Buffer vertex_buffer = parent::get_vertex_buffer();
+      cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+      vk::Buffer index_buffer = parent::get_index_buffer();
+      cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
+
+      vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+      for (uint32_t i = 0; i < object_count; i++) {
+        uint32_t offset = parent::get_dynamic_uniform_offset(index, i);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                               0, descriptor_set, offset);
+        cmd.drawIndexed(index_count, 1, 0, 0, 0);
+      }
+      cmd.endRenderPass();
+      cmd.end();
+    }
+  }
+  void destroy() {}
+}; // class record_swapchain_command_buffers in use_app<app::cube_dynamic_uniform>
+
+template <class T>
+class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
+};
+
+template <class T> class add_resources_and_draw
+  : public
+    profiled<
+    add_frame_allocation_check<
+    add_frame_time_analyser<
+    add_dynamic_draw <
+    add_dynamic_uniform_upload <
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_clock <
+    add_process_suboptimal_image<
+        decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_queue_wait_idle_to_recreate_surface<
+    add_acquire_next_image_semaphores <
+    add_acquire_next_image_semaphore_fences <
+    add_draw_semaphores <
+    add_recreate_surface_for<
+    vulkan_start::use_app<vulkan_start::app::cube_dynamic_uniform>::record_swapchain_command_buffers<
+    add_get_format_clear_color_value_type <
+    add_recreate_surface_for<
+    add_swapchain_command_buffers <
+    write_dynamic_uniform_descriptor_set<
+    add_nonfree_descriptor_set<
+    add_descriptor_pool<
+    set_descriptor_set_count< 1,
+    add_buffer_memory_with_data_copy<
+    rename_buffer_to_index_buffer<
+    add_buffer_as_member<
+    set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
+    add_optimized_cube_index_buffer_data<
+    rename_buffer_vector_to_uniform_buffer_vector <
+    rename_buffer_memory_vector_to_uniform_buffer_memory_vector<
+    rename_buffer_memory_ptr_vector_to_uniform_buffer_memory_ptr_vector<
+    map_buffer_memory_vector<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties < vk::MemoryPropertyFlagBits::eHostVisible,
+    add_buffer_vector<
+    set_vector_size< 1,
+    set_buffer_usage<vk::BufferUsageFlagBits::eUniformBuffer,
+    add_dynamic_uniform_slices<
+    add_buffer_memory_with_data_copy <
+    rename_buffer_to_vertex_buffer<
+    add_buffer_as_member <
+    set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
+    add_optimized_cube_vertex_buffer_data <
+    add_recreate_surface_for<
+    add_graphics_pipeline <
+    add_pipeline_vertex_input_state <
+    add_vertex_binding_description <
+    add_empty_binding_descriptions <
+    add_vertex_attribute_description <
+    set_vertex_input_attribute_format<vk::Format::eR16G16B16A16Snorm,
+    add_empty_vertex_attribute_descriptions <
+    set_binding < 0,
+    set_stride < sizeof(int16_t) * 4,
+    set_input_rate < vk::VertexInputRate::eVertex,
+    set_subpass < 0,
+    add_recreate_surface_for<
+    add_framebuffers_cube <
+    add_render_pass_cube <
+    add_subpasses <
+    add_subpass_dependency <
+    add_empty_subpass_dependencies <
+    add_depth_attachment<
+    add_attachment <
+    add_empty_attachments <
+    add_pipeline_viewport_state <
+    add_scissor_equal_swapchain_extent<
+    add_empty_scissors <
+    add_viewport_equal_swapchain_image_rect <
+    add_empty_viewports <
+    set_tessellation_patch_control_point_count < 1,
+    set_object_count < 1024,
+    T
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+{};
+}; // class use_app<app::cube_dynamic_uniform>
+
+template <class T> class add_dynamic_uniform_swapchain_and_pipeline_layout
+  : public
+  profiled<
+  add_pipeline_layout<
+	add_single_descriptor_set_layout<
+	add_descriptor_set_layout<
+	add_dynamic_uniform_descriptor_set_layout_binding<
+	set_pipeline_rasterization_polygon_mode< vk::PolygonMode::eFill,
+	disable_pipeline_multisample<
+	set_pipeline_input_topology< vk::PrimitiveTopology::eTriangleList,
+	disable_pipeline_dynamic<
+	enable_pipeline_depth_test<
+	add_pipeline_color_blend_state_create_info<
+	disable_pipeline_attachment_color_blend< 0, // disable index 0 attachment
+	add_pipeline_color_blend_attachment_states< 1, // 1 attachment
+	rename_images_views_to_depth_images_views<
+	add_recreate_surface_for<
+	barrier_depth_image_layout<
+	add_recreate_surface_for<
+	add_depth_images_views_cube<
+	add_recreate_surface_for<
+	add_images_memories<
+	add_image_memory_property<vk::MemoryPropertyFlagBits::eDeviceLocal,
+	add_empty_image_memory_properties<
+	add_recreate_surface_for<
+	add_images<
+	add_image_type<vk::ImageType::e2D,
+	set_image_tiling<vk::ImageTiling::eOptimal,
+	set_image_samples<vk::SampleCountFlagBits::e1,
+	add_image_extent_equal_swapchain_image_extent<
+	add_image_usage<vk::ImageUsageFlagBits::eDepthStencilAttachment,
+	add_empty_image_usages<
+	rename_image_format_to_depth_image_format<
+	add_image_format<vk::Format::eD32Sfloat,
+	add_image_count_equal_swapchain_image_count<
+	add_recreate_surface_for<
+	add_swapchain_images_views<
+	add_recreate_surface_for<
+	add_swapchain_images<
+	add_recreate_surface_for<
+	add_configured_swapchain<
+	add_swapchain_image_format<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+{};
+
+template<platform PLATFORM>
+class use_platform_add_cube_dynamic_uniform_physical_device_and_device_and_draw {
+public:
+template<class T>
+class add_cube_dynamic_uniform_physical_device_and_device_and_draw
+    : public
+    profiled<
+    use_app<app::cube_dynamic_uniform>::add_resources_and_draw<
+	add_dynamic_uniform_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+    add_deferred_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
+    add_deferred_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
+	add_empty_pipeline_stages <
+	add_job_system <
+	add_command_pool <
+	add_queue <
+	add_device_with_optional_present_wait <
+	add_swapchain_extension <
+	add_empty_extensions <
+	add_find_properties <
+	cache_physical_device_memory_properties<
+	add_recreate_surface_for<
+	cache_surface_capabilities<
+	add_recreate_surface_for<
+	test_physical_device_support_surface<
+	add_queue_family_index <
+  typename set_app_and_platform<app::cube_dynamic_uniform, PLATFORM>::template add_physical_device_and_surface<
+  T
+  >>>>>>>>>>>>>>>>>>>>>
+{};
+}; // class use_platform_*
+
+} // namespace vulkan_start
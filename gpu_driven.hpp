@@ -0,0 +1,532 @@
+#pragma once
+
+#include "cube.hpp"
+
+namespace vulkan_start {
+
+// matches the push constant block in shaders/cull.comp
+struct cull_constants {
+    std::array<float, 4> bounds_min;
+    std::array<float, 4> bounds_max;
+    uint32_t object_count;
+    uint32_t index_count;
+};
+
+// draw buffer layout: draw count, padding, then one command per object
+constexpr vk::DeviceSize indirect_draw_count_offset = 0;
+constexpr vk::DeviceSize indirect_draw_commands_offset = 16;
+
+template <class T> class set_buffer_size_to_indirect_draws : public T {
+public:
+    using parent = T;
+    auto get_buffer_size() {
+        return indirect_draw_commands_offset +
+            sizeof(vk::DrawIndexedIndirectCommand) * parent::get_object_count();
+    }
+};
+
+template <class T> class rename_buffer_vector_to_object_buffer_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_object_buffer_vector() { return parent::get_buffer_vector(); }
+};
+template <class T> class rename_buffer_memory_vector_to_object_buffer_memory_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_object_buffer_memory_vector() { return parent::get_buffer_memory_vector(); }
+};
+template <class T> class rename_buffer_memory_ptr_vector_to_object_buffer_memory_ptr_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_object_buffer_memory_ptr_vector() { return parent::get_buffer_memory_ptr_vector(); }
+};
+template <class T> class rename_buffer_vector_to_draw_buffer_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_draw_buffer_vector() { return parent::get_buffer_vector(); }
+};
+template <class T> class rename_shader_module_to_cull_shader_module : public T {
+public:
+    using parent = T;
+    auto get_cull_shader_module() { return parent::get_shader_module(); }
+};
+
+template <class T> class add_object_storage_descriptor_set_layout_binding : public T {
+public:
+  using parent = T;
+  add_object_storage_descriptor_set_layout_binding(const configure auto& conf) : parent{conf}{
+    vk::ShaderStageFlagBits stages = vk::ShaderStageFlagBits::eVertex;
+    m_binding = vk::DescriptorSetLayoutBinding{}
+                    .setBinding(0)
+                    .setDescriptorCount(1)
+                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                    .setStageFlags(stages);
+  }
+  auto get_descriptor_set_layout_bindings() { return m_binding; }
+
+private:
+  vk::DescriptorSetLayoutBinding m_binding;
+};
+
+template <class T> class write_object_descriptor_set : public T {
+public:
+  using parent = T;
+  write_object_descriptor_set(const configure auto& conf) : parent{conf} { create(); }
+  auto create() {
+    vk::Device device = parent::get_device();
+    std::vector<vk::Buffer> buffers = parent::get_object_buffer_vector();
+    std::vector<vk::DescriptorSet> sets = parent::get_descriptor_set();
+
+    std::vector<vk::WriteDescriptorSet> writes(sets.size());
+    std::vector<vk::DescriptorBufferInfo> buffer_infos(sets.size());
+    for (uint32_t i = 0; i < sets.size(); i++) {
+      buffer_infos[i] =
+          vk::DescriptorBufferInfo{}.setBuffer(buffers[i]).setRange(vk::WholeSize);
+      writes[i] = vk::WriteDescriptorSet{}
+                  .setDstSet(sets[i])
+                  .setDescriptorCount(1)
+                  .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                  .setDstBinding(0)
+                  .setBufferInfo(buffer_infos[i]);
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+  void destroy() {}
+};
+
+// compute pipeline that frustum culls the object buffer and appends a
+// vk::DrawIndexedIndirectCommand for every visible object to the draw buffer
+template <class T> class add_cull_compute_pipeline : public T {
+public:
+  using parent = T;
+  add_cull_compute_pipeline(const configure auto& conf) : parent{conf} { create(); }
+  ~add_cull_compute_pipeline() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    auto bindings = std::array{
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(1)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+    };
+    m_set_layout = device.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo{}.setBindings(bindings));
+    auto push_constant_range = vk::PushConstantRange{}
+                                   .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                                   .setOffset(0)
+                                   .setSize(sizeof(cull_constants));
+    m_pipeline_layout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo{}
+            .setSetLayouts(m_set_layout)
+            .setPushConstantRanges(push_constant_range));
+    auto [res, pipeline] = device.createComputePipeline(
+        nullptr,
+        vk::ComputePipelineCreateInfo{}
+            .setStage(vk::PipelineShaderStageCreateInfo{}
+                          .setStage(vk::ShaderStageFlagBits::eCompute)
+                          .setModule(parent::get_cull_shader_module())
+                          .setPName("main"))
+            .setLayout(m_pipeline_layout));
+    if (res != vk::Result::eSuccess) {
+      throw std::runtime_error{"failed to create cull compute pipeline"};
+    }
+    m_pipeline = pipeline;
+
+    std::vector<vk::Buffer> object_buffers = parent::get_object_buffer_vector();
+    std::vector<vk::Buffer> draw_buffers = parent::get_draw_buffer_vector();
+    uint32_t count = object_buffers.size();
+    auto pool_sizes = vk::DescriptorPoolSize{}
+                          .setDescriptorCount(count * bindings.size())
+                          .setType(vk::DescriptorType::eStorageBuffer);
+    m_pool = device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo{}.setMaxSets(count).setPoolSizes(pool_sizes));
+    std::vector<vk::DescriptorSetLayout> layouts(count, m_set_layout);
+    m_sets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{}
+                                               .setDescriptorPool(m_pool)
+                                               .setSetLayouts(layouts));
+
+    std::vector<vk::DescriptorBufferInfo> buffer_infos(2 * count);
+    std::vector<vk::WriteDescriptorSet> writes(2 * count);
+    for (uint32_t i = 0; i < count; i++) {
+      buffer_infos[2 * i] = vk::DescriptorBufferInfo{}
+                                .setBuffer(object_buffers[i])
+                                .setRange(vk::WholeSize);
+      buffer_infos[2 * i + 1] = vk::DescriptorBufferInfo{}
+                                    .setBuffer(draw_buffers[i])
+                                    .setRange(vk::WholeSize);
+      for (uint32_t binding = 0; binding < 2; binding++) {
+        writes[2 * i + binding] =
+            vk::WriteDescriptorSet{}
+                .setDstSet(m_sets[i])
+                .setDstBinding(binding)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setBufferInfo(buffer_infos[2 * i + binding]);
+      }
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    device.destroyDescriptorPool(m_pool);
+    device.destroyPipeline(m_pipeline);
+    device.destroyPipelineLayout(m_pipeline_layout);
+    device.destroyDescriptorSetLayout(m_set_layout);
+  }
+  auto get_cull_pipeline() { return m_pipeline; }
+  auto get_cull_pipeline_layout() { return m_pipeline_layout; }
+  const auto& get_cull_descriptor_sets() { return m_sets; }
+
+private:
+  vk::DescriptorSetLayout m_set_layout;
+  vk::PipelineLayout m_pipeline_layout;
+  vk::Pipeline m_pipeline;
+  vk::DescriptorPool m_pool;
+  std::vector<vk::DescriptorSet> m_sets;
+};
+
+template <class T> class add_object_buffer_upload : public T {
+public:
+  using parent = T;
+  add_object_buffer_upload(const configure auto& conf) : parent{conf} { create(); }
+  // the object buffers follow the swapchain image count
+  void create() {
+    m_memory_ptrs = parent::get_object_buffer_memory_ptr_vector();
+    m_memories = parent::get_object_buffer_memory_vector();
+  }
+  void destroy() {}
+  void upload_frame_data(uint32_t index) {
+    vk::Device device = parent::get_device();
+    parent::update_object_transforms();
+    std::span<const mat4> matrices = parent::get_object_matrices();
+    memcpy(m_memory_ptrs[index], matrices.data(), matrices.size_bytes());
+    device.flushMappedMemoryRanges(vk::MappedMemoryRange{}
+                                       .setMemory(m_memories[index])
+                                       .setOffset(0)
+                                       .setSize(vk::WholeSize));
+  }
+
+private:
+  std::vector<void *> m_memory_ptrs;
+  std::vector<vk::DeviceMemory> m_memories;
+};
+
+template<>
+class use_app<app::cube_gpu_driven> {
+public:
+
+// command buffers are recorded once: culling, draw count and draw
+// commands all live on the GPU, so scene changes need no re-recording
+template <class T> class record_swapchain_command_buffers : public T {
+public:
+  using parent = T;
+  record_swapchain_command_buffers(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    auto buffers = parent::get_swapchain_command_buffers();
+    auto swapchain_images = parent::get_swapchain_images();
+    auto queue_family_index = parent::get_queue_family_index();
+    auto framebuffers = parent::get_framebuffers();
+    std::vector<vk::Buffer> draw_buffers = parent::get_draw_buffer_vector();
+    std::vector<vk::DescriptorSet> descriptor_sets =
+        parent::get_descriptor_set();
+    std::vector<vk::DescriptorSet> cull_descriptor_sets =
+        parent::get_cull_descriptor_sets();
+    uint32_t object_count = parent::get_object_count();
+    uint32_t index_count = 3 * 2 * 3 * 2;
+
+    auto clear_values = get_clear_values(this);
+
+    if (buffers.size() != swapchain_images.size()) {
+      throw std::runtime_error{
+          "swapchain images count != command buffers count"};
+    }
+    auto constants = cull_constants{
+        .bounds_min = {-1.0f, -1.0f, -1.0f, 0.0f},
+        .bounds_max = {1.0f, 1.0f, 1.0f, 0.0f},
+        .object_count = object_count,
+        .index_count = index_count,
+    };
+    for (uint32_t index = 0; index < buffers.size(); index++) {
+      vk::CommandBuffer cmd = buffers[index];
+      vk::Buffer draw_buffer = draw_buffers[index];
+
+      cmd.begin(vk::CommandBufferBeginInfo{});
+
+      cmd.fillBuffer(draw_buffer, indirect_draw_count_offset, sizeof(uint32_t), 0);
+      auto clear_count_barrier =
+          vk::BufferMemoryBarrier{}
+              .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+              .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+              .setSrcQueueFamilyIndex(queue_family_index)
+              .setDstQueueFamilyIndex(queue_family_index)
+              .setBuffer(draw_buffer)
+              .setOffset(0)
+              .setSize(vk::WholeSize);
+      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                          vk::PipelineStageFlagBits::eComputeShader, {}, {},
+                          clear_count_barrier, {});
+
+      vk::PipelineLayout cull_pipeline_layout = parent::get_cull_pipeline_layout();
+      cmd.bindPipeline(vk::PipelineBindPoint::eCompute, parent::get_cull_pipeline());
+      cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cull_pipeline_layout,
+                             0, cull_descriptor_sets[index], {});
+      cmd.pushConstants(cull_pipeline_layout, vk::ShaderStageFlagBits::eCompute,
+                        0, sizeof(constants), &constants);
+      cmd.dispatch((object_count + 63) / 64, 1, 1);
+
+      auto draw_commands_barrier =
+          vk::BufferMemoryBarrier{}
+              .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+              .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead)
+              .setSrcQueueFamilyIndex(queue_family_index)
+              .setDstQueueFamilyIndex(queue_family_index)
+              .setBuffer(draw_buffer)
+              .setOffset(0)
+              .setSize(vk::WholeSize);
+      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                          vk::PipelineStageFlagBits::eDrawIndirect, {}, {},
+                          draw_commands_barrier, {});
+
+      vk::RenderPass render_pass = parent::get_render_pass();
+      vk::Extent2D swapchain_image_extent =
+          parent::get_swapchain_image_extent();
+      auto render_area = vk::Rect2D{}
+                             .setOffset(vk::Offset2D{0, 0})
+                             .setExtent(swapchain_image_extent);
+      cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                              .setRenderPass(render_pass)
+                              .setRenderArea(render_area)
+                              .setFramebuffer(framebuffers[index])
+                              .setClearValues(clear_values),
+                          vk::SubpassContents::eInline);
+
+      cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, parent::get_pipeline());
+      vk::Buffer vertex_buffer = parent::get_vertex_buffer();
+      cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+      vk::Buffer index_buffer = parent::get_index_buffer();
+      cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
+
+      vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+      cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                             0, descriptor_sets[index], {});
+      cmd.drawIndexedIndirectCount(draw_buffer, indirect_draw_commands_offset,
+                                   draw_buffer, indirect_draw_count_offset,
+                                   object_count,
+                                   sizeof(vk::DrawIndexedIndirectCommand));
+      cmd.endRenderPass();
+      cmd.end();
+    }
+  }
+  void destroy() {}
+}; // class record_swapchain_command_buffers in use_app<app::cube_gpu_driven>
+
+template <class T>
+class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
+};
+
+template <class T> class add_resources_and_draw
+  : public
+    add_frame_allocation_check<
+    add_frame_time_analyser<
+    add_dynamic_draw <
+    add_process_suboptimal_image<
+        decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_queue_wait_idle_to_recreate_surface<
+    add_recreate_surface_for<
+    add_object_buffer_upload <
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_clock <
+    add_acquire_next_image_semaphores <
+    add_acquire_next_image_semaphore_fences <
+    add_draw_semaphores <
+    add_recreate_surface_for<
+    vulkan_start::use_app<vulkan_start::app::cube_gpu_driven>::record_swapchain_command_buffers<
+    add_get_format_clear_color_value_type <
+    add_recreate_surface_for<
+    add_swapchain_command_buffers <
+    add_recreate_surface_for<
+    add_cull_compute_pipeline <
+    rename_shader_module_to_cull_shader_module <
+    add_shader_module <
+    add_spirv_code <
+    adapte_map_file_to_spirv_code <
+    map_file_mapping <
+    cache_file_size <
+    add_file_mapping <
+    add_file <
+    add_file_path <decltype([]() {return std::string{"shaders/cull.spv"};}),
+    add_recreate_surface_for<
+    write_object_descriptor_set<
+    add_recreate_surface_for<
+    add_nonfree_descriptor_set<
+    add_recreate_surface_for<
+    add_descriptor_pool<
+    add_buffer_memory_with_data_copy<
+    rename_buffer_to_index_buffer<
+    add_buffer_as_member<
+    set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
+    add_optimized_cube_index_buffer_data<
+    rename_buffer_vector_to_draw_buffer_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties<vk::MemoryPropertyFlagBits::eDeviceLocal,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count <
+    add_buffer_usage<vk::BufferUsageFlagBits::eTransferDst,
+    add_buffer_usage<vk::BufferUsageFlagBits::eIndirectBuffer,
+    add_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    empty_buffer_usage<
+    set_buffer_size_to_indirect_draws<
+    rename_buffer_vector_to_object_buffer_vector <
+    rename_buffer_memory_vector_to_object_buffer_memory_vector<
+    rename_buffer_memory_ptr_vector_to_object_buffer_memory_ptr_vector<
+    add_recreate_surface_for<
+    map_buffer_memory_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties < vk::MemoryPropertyFlagBits::eHostVisible,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count<
+    set_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    set_buffer_size_to_object_matrices<
+    add_buffer_memory_with_data_copy <
+    rename_buffer_to_vertex_buffer<
+    add_buffer_as_member <
+    set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
+    add_optimized_cube_vertex_buffer_data <
+    add_recreate_surface_for<
+    add_graphics_pipeline <
+    add_pipeline_vertex_input_state <
+    add_vertex_binding_description <
+    add_empty_binding_descriptions <
+    add_vertex_attribute_description <
+    set_vertex_input_attribute_format<vk::Format::eR16G16B16A16Snorm,
+    add_empty_vertex_attribute_descriptions <
+    set_binding < 0,
+    set_stride < sizeof(int16_t) * 4,
+    set_input_rate < vk::VertexInputRate::eVertex,
+    set_subpass < 0,
+    add_recreate_surface_for<
+    add_framebuffers_cube <
+    add_render_pass_cube <
+    add_subpasses <
+    add_subpass_dependency <
+    add_empty_subpass_dependencies <
+    add_depth_attachment<
+    add_attachment <
+    add_empty_attachments <
+    add_pipeline_viewport_state <
+    add_scissor_equal_swapchain_extent<
+    add_empty_scissors <
+    add_viewport_equal_swapchain_image_rect <
+    add_empty_viewports <
+    set_tessellation_patch_control_point_count < 1,
+    set_object_count < 1024,
+    T
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+{};
+}; // class use_app<app::cube_gpu_driven>
+
+template <class T> class add_gpu_driven_swapchain_and_pipeline_layout
+  : public
+  add_pipeline_layout<
+	add_single_descriptor_set_layout<
+	add_descriptor_set_layout<
+	add_object_storage_descriptor_set_layout_binding<
+	set_pipeline_rasterization_polygon_mode< vk::PolygonMode::eFill,
+	disable_pipeline_multisample<
+	set_pipeline_input_topology< vk::PrimitiveTopology::eTriangleList,
+	disable_pipeline_dynamic<
+	enable_pipeline_depth_test<
+	add_pipeline_color_blend_state_create_info<
+	disable_pipeline_attachment_color_blend< 0, // disable index 0 attachment
+	add_pipeline_color_blend_attachment_states< 1, // 1 attachment
+	rename_images_views_to_depth_images_views<
+	add_recreate_surface_for<
+	barrier_depth_image_layout<
+	add_recreate_surface_for<
+	add_depth_images_views_cube<
+	add_recreate_surface_for<
+	add_images_memories<
+	add_image_memory_property<vk::MemoryPropertyFlagBits::eDeviceLocal,
+	add_empty_image_memory_properties<
+	add_recreate_surface_for<
+	add_images<
+	add_image_type<vk::ImageType::e2D,
+	set_image_tiling<vk::ImageTiling::eOptimal,
+	set_image_samples<vk::SampleCountFlagBits::e1,
+	add_image_extent_equal_swapchain_image_extent<
+	add_image_usage<vk::ImageUsageFlagBits::eDepthStencilAttachment,
+	add_empty_image_usages<
+	rename_image_format_to_depth_image_format<
+	add_image_format<vk::Format::eD32Sfloat,
+	add_image_count_equal_swapchain_image_count<
+	add_recreate_surface_for<
+	add_swapchain_images_views<
+	add_recreate_surface_for<
+	add_swapchain_images<
+	add_recreate_surface_for<
+	add_configured_swapchain<
+	add_swapchain_image_format<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+{};
+
+template<platform PLATFORM>
+class use_platform_add_cube_gpu_driven_physical_device_and_device_and_draw {
+public:
+template<class T>
+class add_cube_gpu_driven_physical_device_and_device_and_draw
+    : public
+    use_app<app::cube_gpu_driven>::add_resources_and_draw<
+    add_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_indirect_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
+    add_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
+	set_shader_entry_name_with_main <
+	add_empty_pipeline_stages <
+	add_gpu_driven_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+	add_command_pool <
+	add_queue <
+	add_device_with_features <
+        decltype(
+            []() {
+                auto features = vk::StructureChain<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceVulkan12Features
+                >{};
+                auto& [features2, vulkan12_features] = features;
+                features2.features.multiDrawIndirect = vk::True;
+                features2.features.drawIndirectFirstInstance = vk::True;
+                vulkan12_features.drawIndirectCount = vk::True;
+                return features;
+            }
+        )
+        ,
+	add_swapchain_extension <
+	add_empty_extensions <
+	add_find_properties <
+	cache_physical_device_memory_properties<
+	add_recreate_surface_for<
+	cache_surface_capabilities<
+	add_recreate_surface_for<
+	test_physical_device_support_surface<
+	add_queue_family_index <
+  typename set_app_and_platform<app::cube_gpu_driven, PLATFORM>::template add_physical_device_and_surface<
+  T
+  >>>>>>>>>>>>>>>>>>>>>
+{};
+}; // class use_platform_*
+
+} // namespace vulkan_start
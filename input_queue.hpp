@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace vulkan_start {
+
+// bounded single producer single consumer ring, lock free; the producer
+// only writes m_tail and the consumer only m_head, each on its own cache line
+template <class T, std::size_t N>
+class spsc_ring {
+public:
+    static_assert(std::has_single_bit(N), "capacity must be a power of two");
+    bool try_push(const T& item) {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        m_items[tail % N] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_pop(T& item) {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = m_items[head % N];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr std::size_t cache_line = 64;
+    alignas(cache_line) std::atomic<std::size_t> m_head{0};
+    alignas(cache_line) std::atomic<std::size_t> m_tail{0};
+    alignas(cache_line) std::array<T, N> m_items{};
+};
+
+enum class input_event_type : uint32_t {
+    key,
+    pointer_motion,
+    pointer_button,
+    pointer_axis,
+    resize,
+};
+
+// one window system event, stamped when the callback delivered it
+struct input_event {
+    input_event_type type;
+    std::chrono::steady_clock::time_point timestamp;
+    // key: key, state; pointer_motion: x, y; pointer_button: button, state;
+    // pointer_axis: axis, value; resize: width, height
+    int32_t a;
+    int32_t b;
+};
+
+template <class T>
+concept input_event_processable = requires(T t, const input_event& e) {
+    t.process_input_event(e);
+};
+
+// apps that draw only when something changed, see add_render_on_demand
+template <class T>
+concept damage_trackable = requires(T t) {
+    { t.needs_redraw() } -> std::convertible_to<bool>;
+};
+
+} // namespace vulkan_start
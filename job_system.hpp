@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace vulkan_start {
+
+// work stealing scheduler shared by every parallel feature. each worker owns
+// a deque of jobs, takes from its back and steals from the front of the
+// others when it runs dry. a thread that waits, e.g. in parallel_for or
+// wait, runs jobs too, so nested parallelism cannot deadlock.
+//
+// jobs are a function pointer, a context and an index; the scheduler never
+// allocates after construction, which keeps parallel_for usable in the
+// frame loop. tasks with dependencies are owned by the caller.
+class job_system {
+public:
+    struct job {
+        void (*function)(void*, uint32_t);
+        void* context;
+        uint32_t index;
+    };
+
+    // a unit of work that starts once every task it was made to wait for
+    // finished, see then(); must outlive its execution
+    class task {
+    public:
+        explicit task(std::function<void()> function)
+            : m_function{std::move(function)}, m_remaining{1}, m_done{false} {}
+        // `next` starts only after this task finished
+        void then(task& next) {
+            next.m_remaining.fetch_add(1, std::memory_order_relaxed);
+            m_dependents.push_back(&next);
+        }
+        bool is_done() const { return m_done.load(std::memory_order_acquire); }
+
+    private:
+        friend class job_system;
+        std::function<void()> m_function;
+        std::vector<task*> m_dependents;
+        std::atomic<uint32_t> m_remaining;
+        std::atomic<bool> m_done;
+    };
+
+    explicit job_system(uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency()))
+        : m_queues(std::max(1u, thread_count)), m_queued{0} {
+        for (uint32_t i = 1; i < m_queues.size(); i++) {
+            m_workers.emplace_back([this, i](std::stop_token stop) { work(stop, i); });
+        }
+    }
+    job_system(const job_system&) = delete;
+    job_system& operator=(const job_system&) = delete;
+    ~job_system() {
+        for (auto& worker : m_workers) {
+            worker.request_stop();
+        }
+        m_workers.clear();
+    }
+
+    // worker threads plus the calling thread
+    uint32_t get_thread_count() const { return m_queues.size(); }
+
+    // calls function(begin, end) over [0, count) in chunks of `grain`
+    // elements and returns when all chunks finished
+    template <class F>
+    void parallel_for(uint32_t count, uint32_t grain, F&& function) {
+        grain = std::max(grain, 1u);
+        uint32_t chunks = (count + grain - 1) / grain;
+        if (chunks <= 1) {
+            if (count > 0) {
+                function(0u, count);
+            }
+            return;
+        }
+        // F is a reference type for an lvalue function
+        struct for_state {
+            std::remove_reference_t<F>* function;
+            uint32_t count;
+            uint32_t grain;
+            std::atomic<uint32_t> remaining;
+        } state{&function, count, grain, chunks};
+        auto run_chunk = [](void* p, uint32_t chunk) {
+            auto* s = static_cast<for_state*>(p);
+            uint32_t begin = chunk * s->grain;
+            (*s->function)(begin, std::min(begin + s->grain, s->count));
+            s->remaining.fetch_sub(1, std::memory_order_acq_rel);
+        };
+        for (uint32_t chunk = 1; chunk < chunks; chunk++) {
+            push(job{run_chunk, &state, chunk});
+        }
+        run_chunk(&state, 0);
+        help_until([&state] { return state.remaining.load(std::memory_order_acquire) == 0; });
+    }
+
+    // schedules `t`, it runs as soon as the tasks it depends on finished
+    void submit(task& t) { release(t); }
+    void wait(const task& t) {
+        help_until([&t] { return t.is_done(); });
+    }
+
+private:
+    static constexpr uint32_t queue_capacity = 1024;
+    // mutex protected ring, owner pops the newest job, thieves the oldest
+    struct queue {
+        std::mutex mutex;
+        std::array<job, queue_capacity> jobs;
+        uint32_t head = 0;
+        uint32_t size = 0;
+    };
+
+    static void run_task(void* p, uint32_t) {
+        auto* t = static_cast<task*>(p);
+        t->m_function();
+        // a waiter may destroy the task once it is done, and a waiter on a
+        // dependent once that one finished, so `t` is not touched after
+        // either: the dependents are taken out, then it is marked done
+        auto dependents = std::move(t->m_dependents);
+        t->m_done.store(true, std::memory_order_release);
+        for (task* next : dependents) {
+            t_system->release(*next);
+        }
+    }
+    void release(task& t) {
+        if (t.m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            push(job{run_task, &t, 0});
+        }
+    }
+
+    void push(job j) {
+        uint32_t index = t_system == this ? t_worker_index
+                                          : m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        queue& q = m_queues[index];
+        {
+            std::unique_lock lock{q.mutex};
+            if (q.size == queue_capacity) {
+                // full, run it here rather than allocate
+                lock.unlock();
+                run(j);
+                return;
+            }
+            m_queued.fetch_add(1, std::memory_order_release);
+            q.jobs[(q.head + q.size) % queue_capacity] = j;
+            q.size++;
+        }
+        {
+            std::lock_guard sleep_lock{m_sleep_mutex};
+        }
+        m_wake.notify_one();
+    }
+    bool try_pop(uint32_t own, job& j) {
+        for (uint32_t i = 0; i < m_queues.size(); i++) {
+            queue& q = m_queues[(own + i) % m_queues.size()];
+            std::lock_guard lock{q.mutex};
+            if (q.size == 0) {
+                continue;
+            }
+            if (i == 0) {
+                j = q.jobs[(q.head + q.size - 1) % queue_capacity];
+            } else {
+                j = q.jobs[q.head];
+                q.head = (q.head + 1) % queue_capacity;
+            }
+            q.size--;
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+    void run(job j) {
+        auto* previous_system = t_system;
+        auto previous_index = t_worker_index;
+        if (t_system != this) {
+            t_system = this;
+            t_worker_index = 0;
+        }
+        j.function(j.context, j.index);
+        t_system = previous_system;
+        t_worker_index = previous_index;
+    }
+    template <class DONE>
+    void help_until(DONE done) {
+        uint32_t own = t_system == this ? t_worker_index : 0;
+        while (!done()) {
+            job j;
+            if (try_pop(own, j)) {
+                run(j);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+    void work(std::stop_token stop, uint32_t index) {
+        t_system = this;
+        t_worker_index = index;
+        while (!stop.stop_requested()) {
+            job j;
+            if (try_pop(index, j)) {
+                run(j);
+                continue;
+            }
+            std::unique_lock lock{m_sleep_mutex};
+            m_wake.wait(lock, stop, [this] {
+                return m_queued.load(std::memory_order_acquire) > 0;
+            });
+        }
+    }
+
+    static inline thread_local job_system* t_system = nullptr;
+    static inline thread_local uint32_t t_worker_index = 0;
+
+    std::vector<queue> m_queues;
+    std::atomic<uint32_t> m_queued;
+    std::atomic<uint32_t> m_next_queue{0};
+    std::mutex m_sleep_mutex;
+    std::condition_variable_any m_wake;
+    // joined first, before the queues they use are destroyed
+    std::vector<std::jthread> m_workers;
+};
+
+// the result of a function that runs on the job system from construction
+// on. get() waits for it, running other jobs meanwhile, and rethrows what
+// the function threw; a layer that starts its work in its constructor and
+// calls get() at first use overlaps that work with the layers built after
+// it
+template <class R> class deferred {
+public:
+    template <class F>
+    deferred(job_system& jobs, F function)
+        : m_jobs{jobs}, m_task{[this, function = std::move(function)]() mutable {
+              try {
+                  m_result.emplace(function());
+              } catch (...) {
+                  m_exception = std::current_exception();
+              }
+          }} {
+        m_jobs.submit(m_task);
+    }
+    deferred(const deferred&) = delete;
+    deferred& operator=(const deferred&) = delete;
+    ~deferred() { m_jobs.wait(m_task); }
+    R& get() {
+        m_jobs.wait(m_task);
+        if (m_exception) {
+            std::rethrow_exception(m_exception);
+        }
+        return *m_result;
+    }
+    // waits like get(), false if the function threw
+    bool has_value() {
+        m_jobs.wait(m_task);
+        return m_result.has_value();
+    }
+
+private:
+    job_system& m_jobs;
+    std::optional<R> m_result;
+    std::exception_ptr m_exception;
+    job_system::task m_task;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+
+namespace vulkan_start {
+
+// fixed bucket histogram of durations, 250us wide buckets up to 64ms and one
+// more for everything longer. recording never allocates, so it can be fed
+// from the frame loop
+class latency_histogram {
+public:
+    static constexpr auto bucket_width = std::chrono::microseconds{250};
+    static constexpr uint32_t bucket_count = 257;
+
+    void record(std::chrono::nanoseconds latency) {
+        auto bucket = std::min<int64_t>(std::max<int64_t>(latency / bucket_width, 0), bucket_count - 1);
+        m_buckets[bucket]++;
+        m_count++;
+        m_max = std::max(m_max, latency);
+    }
+    void clear() { *this = latency_histogram{}; }
+    uint64_t get_count() const { return m_count; }
+    std::chrono::nanoseconds get_max() const { return m_max; }
+    // upper edge of the bucket holding the `fraction` quantile, 0 if empty
+    std::chrono::nanoseconds get_percentile(double fraction) const {
+        if (m_count == 0) {
+            return {};
+        }
+        auto rank = std::max<uint64_t>(1, std::ceil(fraction * m_count));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < bucket_count - 1; i++) {
+            seen += m_buckets[i];
+            if (seen >= rank) {
+                return std::min<std::chrono::nanoseconds>((i + 1) * bucket_width, m_max);
+            }
+        }
+        return m_max;
+    }
+
+private:
+    std::array<uint64_t, bucket_count> m_buckets{};
+    uint64_t m_count = 0;
+    std::chrono::nanoseconds m_max{};
+};
+
+// layers that measure presents hand their histograms to the frame time
+// report through this, the histograms are cleared by the call
+template <class T>
+concept present_latency_collectable = requires(T t, latency_histogram& h) {
+    t.collect_present_latencies(h, h);
+};
+
+// a present as the latency measurements see it: when presentKHR was called,
+// and when the input event the frame first reflects arrived, a default time
+// point if none did
+struct present_timing {
+    std::chrono::steady_clock::time_point present_time;
+    std::chrono::steady_clock::time_point input_time;
+};
+
+// layers that measure presents take the time a present was shown from the
+// window system through this, where it tells, e.g. wp_presentation feedback
+template <class T>
+concept presentation_recordable =
+    requires(T t, const present_timing& present, std::chrono::steady_clock::time_point time) {
+        { t.get_last_present() } -> std::same_as<present_timing>;
+        t.record_presentation(present, time);
+    };
+
+} // namespace vulkan_start
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan_helper.hpp>
+
+#include "profile.hpp"
+
+namespace vulkan_start {
+
+struct memory_usage {
+    uint64_t bytes = 0;
+    uint64_t allocations = 0;
+};
+
+struct memory_heap_statistics {
+    vk::MemoryHeapFlags flags;
+    vk::DeviceSize size;
+    // live allocations the device memory report saw in this heap
+    memory_usage tracked;
+    // from VK_EXT_memory_budget, 0 without it. usage and budget count the
+    // whole process and other processes' pressure, tracked only this device
+    vk::DeviceSize budget;
+    vk::DeviceSize usage;
+};
+
+// device memory at one point of the run. owners are the innermost layer
+// whose constructor or recreate_surface made the allocation, known in
+// VULKAN_START_PROFILE_STARTUP builds and "unattributed" otherwise
+struct memory_snapshot {
+    memory_usage total;
+    std::vector<memory_heap_statistics> heaps;
+    std::map<std::string, memory_usage> owners;
+    std::map<std::string, memory_usage> object_types;
+};
+
+// keeps the live device memory allocations of a device, fed by the
+// VK_EXT_device_memory_report callback. the driver reports every allocation
+// on the thread that makes it, vkAllocateMemory ones as device memory
+// objects and its own ones for other objects, e.g. pipelines and
+// descriptor pools, as their object type
+class device_memory_tracker {
+public:
+    device_memory_tracker() : m_active{false}, m_failed{0} {}
+    // to chain into the device create info; the tracker must outlive the
+    // device
+    vk::DeviceDeviceMemoryReportCreateInfoEXT get_report_create_info() {
+        m_active = true;
+        return vk::DeviceDeviceMemoryReportCreateInfoEXT{}
+            .setPfnUserCallback(&report)
+            .setPUserData(this);
+    }
+    bool is_active() { return m_active; }
+    void add_to(memory_snapshot& snapshot) {
+        std::lock_guard lock{m_mutex};
+        for (auto& [id, a] : m_allocations) {
+            auto add = [&a](memory_usage& usage) {
+                usage.bytes += a.size;
+                usage.allocations++;
+            };
+            add(snapshot.total);
+            if (a.heap < snapshot.heaps.size()) {
+                add(snapshot.heaps[a.heap].tracked);
+            }
+            add(snapshot.owners[a.owner]);
+            add(snapshot.object_types[vk::to_string(a.object_type)]);
+        }
+    }
+    // vkAllocateMemory allocations still live, logged before the device is
+    // destroyed. the driver's own ones go with the device
+    void log_live_device_memory() {
+        std::lock_guard lock{m_mutex};
+        for (auto& [id, a] : m_allocations) {
+            if (a.object_type == vk::ObjectType::eDeviceMemory) {
+                std::clog << "device memory not freed: " << a.size << " bytes in heap " << a.heap
+                          << " from " << a.owner << std::endl;
+            }
+        }
+        if (m_failed) {
+            std::clog << m_failed << " device memory allocations failed" << std::endl;
+        }
+    }
+
+private:
+    struct allocation {
+        vk::DeviceSize size;
+        uint32_t heap;
+        vk::ObjectType object_type;
+        std::string owner;
+    };
+    static void VKAPI_PTR report(const VkDeviceMemoryReportCallbackDataEXT* data,
+                                 void* user_data) {
+        auto& tracker = *static_cast<device_memory_tracker*>(user_data);
+        std::lock_guard lock{tracker.m_mutex};
+        switch (data->type) {
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_ALLOCATE_EXT: {
+            std::string_view owner = startup_profile::current_layer();
+            tracker.m_allocations.insert_or_assign(
+                data->memoryObjectId,
+                allocation{data->size, data->heapIndex, vk::ObjectType{data->objectType},
+                           std::string{owner.empty() ? "unattributed" : owner}});
+            break;
+        }
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_FREE_EXT:
+            tracker.m_allocations.erase(data->memoryObjectId);
+            break;
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_ALLOCATION_FAILED_EXT:
+            tracker.m_failed++;
+            break;
+        default:
+            // imports reference memory allocated elsewhere
+            break;
+        }
+    }
+
+    bool m_active;
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, allocation> m_allocations;
+    uint64_t m_failed;
+};
+
+// device memory statistics of the app: get_memory_snapshot() returns the
+// heaps with their VK_EXT_memory_budget budget and usage where the device
+// supports it, and the allocations of the device's memory report when the
+// device layer keeps one. after each recreate_surface it logs the tracked
+// memory, an allocation count that keeps growing across recreates is a leak
+template <class T> class add_memory_statistics : public T {
+public:
+    using parent = T;
+    add_memory_statistics(const configure auto& conf)
+        : parent{conf}, m_budget_supported{false}, m_recreate_count{0},
+          m_last_allocations{0} {
+        auto available = parent::get_physical_device().enumerateDeviceExtensionProperties();
+        m_budget_supported = std::ranges::any_of(available, [](auto& p) {
+            return std::string_view{p.extensionName} == vk::EXTMemoryBudgetExtensionName;
+        });
+    }
+    memory_snapshot get_memory_snapshot() {
+        vk::PhysicalDevice physical_device = parent::get_physical_device();
+        memory_snapshot snapshot{};
+        vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+        vk::PhysicalDeviceMemoryProperties properties;
+        if (m_budget_supported) {
+            auto chain = physical_device.getMemoryProperties2<
+                vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            properties = chain.template get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+            budget = chain.template get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        } else {
+            properties = physical_device.getMemoryProperties();
+        }
+        for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+            snapshot.heaps.push_back(memory_heap_statistics{
+                properties.memoryHeaps[i].flags, properties.memoryHeaps[i].size, {},
+                budget.heapBudget[i], budget.heapUsage[i]});
+        }
+        if constexpr (requires { parent::get_device_memory_tracker(); }) {
+            parent::get_device_memory_tracker().add_to(snapshot);
+        }
+        return snapshot;
+    }
+    void recreate_surface() {
+        parent::recreate_surface();
+        if constexpr (requires { parent::get_device_memory_tracker(); }) {
+            if (!parent::get_device_memory_tracker().is_active()) {
+                return;
+            }
+            memory_usage total = get_memory_snapshot().total;
+            std::clog << "device memory after recreate_surface: " << total.bytes << " bytes in "
+                      << total.allocations << " allocations" << std::endl;
+            // the first recreate may change the image count, later ones
+            // should free what they allocate
+            if (m_recreate_count++ > 0 && total.allocations > m_last_allocations) {
+                std::clog << "device memory allocations grew by "
+                          << total.allocations - m_last_allocations
+                          << " since the last recreate_surface" << std::endl;
+            }
+            m_last_allocations = total.allocations;
+        }
+    }
+
+private:
+    bool m_budget_supported;
+    uint64_t m_recreate_count;
+    uint64_t m_last_allocations;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace vulkan_start {
+
+// average cache miss ratio: transformed vertices per triangle with a
+// FIFO post transform cache of `cache_size` entries, 0.5 is the ideal
+// for large meshes and 3 means no reuse at all
+template <class Index>
+float compute_acmr(std::span<const Index> indices, uint32_t vertex_count,
+                   uint32_t cache_size = 16) {
+    if (indices.size() < 3) {
+        return 0;
+    }
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    uint32_t misses = 0;
+    for (Index index : indices) {
+        if (time - cache_time[index] > cache_size) {
+            cache_time[index] = time++;
+            misses++;
+        }
+    }
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+namespace forsyth {
+
+constexpr uint32_t cache_size = 32;
+
+inline float vertex_score(int cache_position, uint32_t remaining_triangles) {
+    if (remaining_triangles == 0) {
+        return -1;
+    }
+    float score = 0;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // the last triangle's vertices get a fixed score, so the next
+            // triangle does not always reuse the same edge
+            score = 0.75f;
+        } else {
+            float scaled = 1.0f - static_cast<float>(cache_position - 3) / (cache_size - 3);
+            score = std::pow(scaled, 1.5f);
+        }
+    }
+    // vertices with few triangles left are finished first
+    score += 2.0f / std::sqrt(static_cast<float>(remaining_triangles));
+    return score;
+}
+
+} // namespace forsyth
+
+// reorders triangles for post transform cache reuse, Tom Forsyth's
+// linear-speed vertex cache optimisation
+template <class Index>
+std::vector<Index> optimize_vertex_cache(std::span<const Index> indices,
+                                         uint32_t vertex_count) {
+    uint32_t triangle_count = indices.size() / 3;
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (Index index : indices) {
+        remaining[index]++;
+    }
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<uint32_t> vertex_triangles(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t t = 0; t < triangle_count; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                vertex_triangles[fill[indices[3 * t + k]]++] = t;
+            }
+        }
+    }
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> scores(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        scores[v] = forsyth::vertex_score(-1, remaining[v]);
+    }
+    std::vector<bool> emitted(triangle_count, false);
+    auto triangle_score = [&](uint32_t t) {
+        return scores[indices[3 * t]] + scores[indices[3 * t + 1]] +
+               scores[indices[3 * t + 2]];
+    };
+
+    std::vector<uint32_t> cache;
+    cache.reserve(forsyth::cache_size + 3);
+    std::vector<Index> result;
+    result.reserve(indices.size());
+    uint32_t next_unemitted = 0;
+    while (result.size() < indices.size()) {
+        // best triangle among those touching the cache
+        int64_t best = -1;
+        float best_score = -1;
+        for (uint32_t v : cache) {
+            for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++) {
+                uint32_t t = vertex_triangles[i];
+                if (!emitted[t] && triangle_score(t) > best_score) {
+                    best = t;
+                    best_score = triangle_score(t);
+                }
+            }
+        }
+        if (best < 0) {
+            while (emitted[next_unemitted]) {
+                next_unemitted++;
+            }
+            best = next_unemitted;
+        }
+
+        emitted[best] = true;
+        std::array<uint32_t, 3> triangle{};
+        for (uint32_t k = 0; k < 3; k++) {
+            triangle[k] = indices[3 * best + k];
+            result.push_back(indices[3 * best + k]);
+            remaining[triangle[k]]--;
+        }
+        // emitted vertices move to the front of the LRU cache
+        std::erase_if(cache, [&triangle](uint32_t v) {
+            return std::ranges::find(triangle, v) != triangle.end();
+        });
+        cache.insert(cache.begin(), triangle.begin(), triangle.end());
+        for (uint32_t i = 0; i < cache.size(); i++) {
+            cache_position[cache[i]] = i < forsyth::cache_size ? i : -1;
+            scores[cache[i]] = forsyth::vertex_score(cache_position[cache[i]],
+                                                     remaining[cache[i]]);
+        }
+        if (cache.size() > forsyth::cache_size) {
+            cache.resize(forsyth::cache_size);
+        }
+    }
+    return result;
+}
+
+// reorders vertices by first use in `indices`, so the vertex fetches of
+// consecutive triangles hit neighbouring memory; rewrites `indices` and
+// returns the old index of every new vertex
+template <class Index>
+std::vector<uint32_t> optimize_vertex_fetch_remap(std::span<Index> indices,
+                                                  uint32_t vertex_count) {
+    constexpr auto unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> new_index(vertex_count, unused);
+    std::vector<uint32_t> old_index;
+    old_index.reserve(vertex_count);
+    for (Index& index : indices) {
+        if (new_index[index] == unused) {
+            new_index[index] = old_index.size();
+            old_index.push_back(index);
+        }
+        index = static_cast<Index>(new_index[index]);
+    }
+    return old_index;
+}
+
+inline int16_t quantize_snorm16(float v) {
+    return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+inline int8_t quantize_snorm8(float v) {
+    return static_cast<int8_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 127.0f));
+}
+inline uint8_t quantize_unorm8(float v) {
+    return static_cast<uint8_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+
+// positions as R16G16B16A16_SNORM; position = snorm * scale + bias
+struct quantized_positions {
+    std::vector<std::array<int16_t, 4>> positions;
+    std::array<float, 3> scale;
+    std::array<float, 3> bias;
+};
+
+inline quantized_positions quantize_positions(std::span<const std::array<float, 3>> positions) {
+    quantized_positions res{};
+    std::array<float, 3> min_value{}, max_value{};
+    min_value.fill(std::numeric_limits<float>::max());
+    max_value.fill(std::numeric_limits<float>::lowest());
+    for (auto& p : positions) {
+        for (int i = 0; i < 3; i++) {
+            min_value[i] = std::min(min_value[i], p[i]);
+            max_value[i] = std::max(max_value[i], p[i]);
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        res.bias[i] = positions.empty() ? 0 : (min_value[i] + max_value[i]) / 2;
+        float half_extent = positions.empty() ? 0 : (max_value[i] - min_value[i]) / 2;
+        res.scale[i] = half_extent > 0 ? half_extent : 1;
+    }
+    res.positions.reserve(positions.size());
+    for (auto& p : positions) {
+        res.positions.push_back({
+            quantize_snorm16((p[0] - res.bias[0]) / res.scale[0]),
+            quantize_snorm16((p[1] - res.bias[1]) / res.scale[1]),
+            quantize_snorm16((p[2] - res.bias[2]) / res.scale[2]),
+            0,
+        });
+    }
+    return res;
+}
+
+// unit normals as R8G8B8A8_SNORM
+inline std::vector<std::array<int8_t, 4>> quantize_normals(std::span<const std::array<float, 3>> normals) {
+    std::vector<std::array<int8_t, 4>> res;
+    res.reserve(normals.size());
+    for (auto& n : normals) {
+        res.push_back({quantize_snorm8(n[0]), quantize_snorm8(n[1]), quantize_snorm8(n[2]), 0});
+    }
+    return res;
+}
+
+// colors as R8G8B8A8_UNORM
+inline std::vector<std::array<uint8_t, 4>> quantize_colors(std::span<const std::array<float, 4>> colors) {
+    std::vector<std::array<uint8_t, 4>> res;
+    res.reserve(colors.size());
+    for (auto& c : colors) {
+        res.push_back({quantize_unorm8(c[0]), quantize_unorm8(c[1]), quantize_unorm8(c[2]), quantize_unorm8(c[3])});
+    }
+    return res;
+}
+
+// runs the whole optimisation stage over an indexed position-only mesh
+template <class Index>
+struct optimized_mesh {
+    std::vector<Index> indices;
+    quantized_positions positions;
+    float acmr_before;
+    float acmr_after;
+};
+
+template <class Index>
+optimized_mesh<Index> optimize_mesh(std::span<const std::array<float, 3>> positions,
+                                    std::span<const Index> indices) {
+    optimized_mesh<Index> res{};
+    uint32_t vertex_count = positions.size();
+    res.acmr_before = compute_acmr(indices, vertex_count);
+    res.indices = optimize_vertex_cache(indices, vertex_count);
+    res.acmr_after = compute_acmr(std::span<const Index>{res.indices}, vertex_count);
+    auto remap = optimize_vertex_fetch_remap(std::span<Index>{res.indices}, vertex_count);
+    std::vector<std::array<float, 3>> reordered(remap.size());
+    for (uint32_t i = 0; i < remap.size(); i++) {
+        reordered[i] = positions[remap[i]];
+    }
+    res.positions = quantize_positions(reordered);
+    return res;
+}
+
+} // namespace vulkan_start
@@ -0,0 +1,1000 @@
+#pragma once
+
+#include <bit>
+
+#include "gpu_driven.hpp"
+
+namespace vulkan_start {
+
+// matches the Statistics block in shaders/cull_occlusion.comp
+struct occlusion_culling_statistics {
+    uint32_t drawn_first_phase;
+    uint32_t drawn_second_phase;
+    uint32_t frustum_culled;
+    uint32_t occlusion_culled;
+};
+
+// matches the push constant block in shaders/cull_occlusion.comp
+struct occlusion_cull_constants {
+    std::array<float, 4> bounds_min;
+    std::array<float, 4> bounds_max;
+    uint32_t object_count;
+    uint32_t index_count;
+    uint32_t phase;
+    uint32_t depth_pyramid_levels;
+    std::array<uint32_t, 2> depth_pyramid_size;
+};
+
+// matches the push constant block in shaders/depth_reduce.comp
+struct depth_reduce_constants {
+    std::array<uint32_t, 2> source_size;
+    std::array<uint32_t, 2> destination_size;
+};
+
+// the draw buffer holds one count + command list per culling phase,
+// each aligned so it can be bound as its own storage buffer range
+constexpr vk::DeviceSize two_phase_draw_region_alignment = 256;
+
+inline vk::DeviceSize get_two_phase_draw_region_size(uint32_t object_count) {
+    vk::DeviceSize size = indirect_draw_commands_offset +
+        sizeof(vk::DrawIndexedIndirectCommand) * object_count;
+    return (size + two_phase_draw_region_alignment - 1) /
+        two_phase_draw_region_alignment * two_phase_draw_region_alignment;
+}
+
+template <class T> class set_buffer_size_to_two_phase_indirect_draws : public T {
+public:
+    using parent = T;
+    auto get_buffer_size() {
+        return 2 * get_two_phase_draw_region_size(parent::get_object_count());
+    }
+};
+
+template <class T> class rename_buffer_vector_to_statistics_buffer_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_statistics_buffer_vector() { return parent::get_buffer_vector(); }
+};
+template <class T> class rename_buffer_memory_vector_to_statistics_buffer_memory_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_statistics_buffer_memory_vector() { return parent::get_buffer_memory_vector(); }
+};
+template <class T> class rename_buffer_memory_ptr_vector_to_statistics_buffer_memory_ptr_vector : public T {
+public:
+    using parent = T;
+    decltype(auto) get_statistics_buffer_memory_ptr_vector() { return parent::get_buffer_memory_ptr_vector(); }
+};
+template <class T> class rename_shader_module_to_depth_reduce_shader_module : public T {
+public:
+    using parent = T;
+    auto get_depth_reduce_shader_module() { return parent::get_shader_module(); }
+};
+template <class T> class rename_shader_module_to_occlusion_cull_shader_module : public T {
+public:
+    using parent = T;
+    auto get_occlusion_cull_shader_module() { return parent::get_shader_module(); }
+};
+template <class T> class rename_images_to_depth_images : public T {
+public:
+    using parent = T;
+    decltype(auto) get_depth_images() { return parent::get_images(); }
+};
+
+// the depth written by the first pass is read by the pyramid build and
+// kept for the second pass
+template <class T> class store_depth_attachment : public T {
+public:
+    using parent = T;
+    auto get_attachments() {
+        auto attachments = parent::get_attachments();
+        auto& depth = attachments.at(1);
+        depth.setStoreOp(vk::AttachmentStoreOp::eStore)
+            .setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        return attachments;
+    }
+};
+
+// render pass compatible with the cube render pass that keeps the
+// contents of the first pass instead of clearing them
+template <class T> class add_load_render_pass : public T {
+public:
+  using parent = T;
+  add_load_render_pass(const configure auto& conf) : parent{conf} {
+    vk::Device device = parent::get_device();
+    auto attachments = parent::get_attachments();
+    for (auto& attachment : attachments) {
+      attachment.setLoadOp(vk::AttachmentLoadOp::eLoad)
+          .setInitialLayout(attachment.finalLayout);
+    }
+    auto dependencies = parent::get_subpass_dependencies();
+    auto color_attachment =
+        vk::AttachmentReference{}.setAttachment(0).setLayout(
+            vk::ImageLayout::eColorAttachmentOptimal);
+    auto depth_attachment =
+        vk::AttachmentReference{}.setAttachment(1).setLayout(
+            vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    auto subpasses =
+        std::array{vk::SubpassDescription{}
+                       .setColorAttachments(color_attachment)
+                       .setPDepthStencilAttachment(&depth_attachment)};
+
+    m_render_pass = device.createRenderPass(vk::RenderPassCreateInfo{}
+                                                .setAttachments(attachments)
+                                                .setDependencies(dependencies)
+                                                .setSubpasses(subpasses));
+  }
+  ~add_load_render_pass() {
+    vk::Device device = parent::get_device();
+    device.destroyRenderPass(m_render_pass);
+  }
+  auto get_load_render_pass() { return m_render_pass; }
+
+private:
+  vk::RenderPass m_render_pass;
+};
+
+// one flag per object, written by the second culling phase and read by
+// the first phase of the next frame
+template <class T> class add_visibility_buffer : public T {
+public:
+  using parent = T;
+  add_visibility_buffer(const configure auto& conf) : parent{conf} { create(); }
+  ~add_visibility_buffer() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    vk::DeviceSize size = sizeof(uint32_t) * parent::get_object_count();
+    m_buffer = device.createBuffer(
+        vk::BufferCreateInfo{}
+            .setSize(size)
+            .setUsage(vk::BufferUsageFlagBits::eStorageBuffer |
+                      vk::BufferUsageFlagBits::eTransferDst));
+    auto requirements = device.getBufferMemoryRequirements(m_buffer);
+    m_memory = device.allocateMemory(
+        vk::MemoryAllocateInfo{}
+            .setAllocationSize(requirements.size)
+            .setMemoryTypeIndex(find_memory_type_index(
+                physical_device, requirements.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal)));
+    device.bindBufferMemory(m_buffer, m_memory, 0);
+    water_chika_vulkan_submit_once(
+        device, parent::get_queue(), parent::get_command_pool(),
+        [this](vk::CommandBuffer cmd) {
+          cmd.fillBuffer(m_buffer, 0, vk::WholeSize, 0);
+        });
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    device.destroyBuffer(m_buffer);
+    device.freeMemory(m_memory);
+  }
+  auto get_visibility_buffer() { return m_buffer; }
+
+private:
+  vk::Buffer m_buffer;
+  vk::DeviceMemory m_memory;
+};
+
+// max-reduced depth pyramid built from the depth of the first pass, with
+// the compute pipeline and descriptor sets that build it level by level
+template <class T> class add_depth_pyramid : public T {
+public:
+  using parent = T;
+  add_depth_pyramid(const configure auto& conf) : parent{conf} { create(); }
+  ~add_depth_pyramid() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    vk::Extent2D extent = parent::get_swapchain_image_extent();
+    m_width = std::bit_floor(std::max(extent.width, 1u));
+    m_height = std::bit_floor(std::max(extent.height, 1u));
+    m_levels = std::bit_width(std::max(m_width, m_height));
+
+    m_image = device.createImage(
+        vk::ImageCreateInfo{}
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(vk::Format::eR32Sfloat)
+            .setExtent(vk::Extent3D{m_width, m_height, 1})
+            .setMipLevels(m_levels)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setUsage(vk::ImageUsageFlagBits::eStorage |
+                      vk::ImageUsageFlagBits::eSampled)
+            .setInitialLayout(vk::ImageLayout::eUndefined));
+    auto requirements = device.getImageMemoryRequirements(m_image);
+    m_memory = device.allocateMemory(
+        vk::MemoryAllocateInfo{}
+            .setAllocationSize(requirements.size)
+            .setMemoryTypeIndex(find_memory_type_index(
+                physical_device, requirements.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal)));
+    device.bindImageMemory(m_image, m_memory, 0);
+
+    auto create_view = [this, device](uint32_t base_level, uint32_t level_count) {
+      return device.createImageView(
+          vk::ImageViewCreateInfo{}
+              .setImage(m_image)
+              .setFormat(vk::Format::eR32Sfloat)
+              .setViewType(vk::ImageViewType::e2D)
+              .setSubresourceRange(vk::ImageSubresourceRange{}
+                                       .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                                       .setBaseMipLevel(base_level)
+                                       .setLevelCount(level_count)
+                                       .setLayerCount(1)));
+    };
+    m_view = create_view(0, m_levels);
+    m_level_views.resize(m_levels);
+    for (uint32_t level = 0; level < m_levels; level++) {
+      m_level_views[level] = create_view(level, 1);
+    }
+    m_sampler = device.createSampler(
+        vk::SamplerCreateInfo{}
+            .setMagFilter(vk::Filter::eNearest)
+            .setMinFilter(vk::Filter::eNearest)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setMaxLod(vk::LodClampNone));
+
+    auto bindings = std::array{
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(0)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(1)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+    };
+    m_set_layout = device.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo{}.setBindings(bindings));
+    auto push_constant_range = vk::PushConstantRange{}
+                                   .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                                   .setOffset(0)
+                                   .setSize(sizeof(depth_reduce_constants));
+    m_pipeline_layout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo{}
+            .setSetLayouts(m_set_layout)
+            .setPushConstantRanges(push_constant_range));
+    auto [res, pipeline] = device.createComputePipeline(
+        nullptr,
+        vk::ComputePipelineCreateInfo{}
+            .setStage(vk::PipelineShaderStageCreateInfo{}
+                          .setStage(vk::ShaderStageFlagBits::eCompute)
+                          .setModule(parent::get_depth_reduce_shader_module())
+                          .setPName("main"))
+            .setLayout(m_pipeline_layout));
+    if (res != vk::Result::eSuccess) {
+      throw std::runtime_error{"failed to create depth reduce pipeline"};
+    }
+    m_pipeline = pipeline;
+
+    // level 0 reads the depth image of each swapchain image, the other
+    // levels read the level above them
+    std::vector<vk::ImageView> depth_views = parent::get_depth_images_views();
+    uint32_t set_count = depth_views.size() + m_levels - 1;
+    auto pool_sizes = std::array{
+        vk::DescriptorPoolSize{}
+            .setType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(set_count),
+        vk::DescriptorPoolSize{}
+            .setType(vk::DescriptorType::eStorageImage)
+            .setDescriptorCount(set_count),
+    };
+    m_pool = device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo{}.setMaxSets(set_count).setPoolSizes(pool_sizes));
+    std::vector<vk::DescriptorSetLayout> layouts(set_count, m_set_layout);
+    m_sets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{}
+                                               .setDescriptorPool(m_pool)
+                                               .setSetLayouts(layouts));
+
+    std::vector<vk::DescriptorImageInfo> image_infos(2 * set_count);
+    std::vector<vk::WriteDescriptorSet> writes(2 * set_count);
+    for (uint32_t i = 0; i < set_count; i++) {
+      bool is_first_level = i < depth_views.size();
+      uint32_t level = is_first_level ? 0 : i - depth_views.size() + 1;
+      image_infos[2 * i] =
+          is_first_level
+              ? vk::DescriptorImageInfo{}
+                    .setSampler(m_sampler)
+                    .setImageView(depth_views[i])
+                    .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+              : vk::DescriptorImageInfo{}
+                    .setSampler(m_sampler)
+                    .setImageView(m_level_views[level - 1])
+                    .setImageLayout(vk::ImageLayout::eGeneral);
+      image_infos[2 * i + 1] = vk::DescriptorImageInfo{}
+                                   .setImageView(m_level_views[level])
+                                   .setImageLayout(vk::ImageLayout::eGeneral);
+      writes[2 * i] = vk::WriteDescriptorSet{}
+                          .setDstSet(m_sets[i])
+                          .setDstBinding(0)
+                          .setDescriptorCount(1)
+                          .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                          .setImageInfo(image_infos[2 * i]);
+      writes[2 * i + 1] = vk::WriteDescriptorSet{}
+                              .setDstSet(m_sets[i])
+                              .setDstBinding(1)
+                              .setDescriptorCount(1)
+                              .setDescriptorType(vk::DescriptorType::eStorageImage)
+                              .setImageInfo(image_infos[2 * i + 1]);
+    }
+    device.updateDescriptorSets(writes, {});
+
+    water_chika_vulkan_submit_once(
+        device, parent::get_queue(), parent::get_command_pool(),
+        [this](vk::CommandBuffer cmd) {
+          auto pyramid_barrier =
+              vk::ImageMemoryBarrier{}
+                  .setSrcAccessMask(vk::AccessFlagBits::eNone)
+                  .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+                  .setOldLayout(vk::ImageLayout::eUndefined)
+                  .setNewLayout(vk::ImageLayout::eGeneral)
+                  .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                  .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                  .setImage(m_image)
+                  .setSubresourceRange(vk::ImageSubresourceRange{}
+                                           .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                                           .setLevelCount(m_levels)
+                                           .setLayerCount(1));
+          cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                              vk::PipelineStageFlagBits::eComputeShader, {}, {},
+                              {}, pyramid_barrier);
+        });
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    device.destroyDescriptorPool(m_pool);
+    device.destroyPipeline(m_pipeline);
+    device.destroyPipelineLayout(m_pipeline_layout);
+    device.destroyDescriptorSetLayout(m_set_layout);
+    device.destroySampler(m_sampler);
+    std::ranges::for_each(m_level_views,
+                          [device](auto view) { device.destroyImageView(view); });
+    device.destroyImageView(m_view);
+    device.destroyImage(m_image);
+    device.freeMemory(m_memory);
+  }
+  // records the reduction of the depth image of swapchain image `index`
+  // into every pyramid level; the depth image must be in
+  // eShaderReadOnlyOptimal and the pyramid in eGeneral
+  void record_build_depth_pyramid(vk::CommandBuffer cmd, uint32_t index) {
+    vk::Extent2D extent = parent::get_swapchain_image_extent();
+    uint32_t first_level_set_count = parent::get_depth_images_views().size();
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+    std::array<uint32_t, 2> source_size{extent.width, extent.height};
+    for (uint32_t level = 0; level < m_levels; level++) {
+      std::array<uint32_t, 2> destination_size{std::max(m_width >> level, 1u),
+                                               std::max(m_height >> level, 1u)};
+      vk::DescriptorSet set =
+          level == 0 ? m_sets[index] : m_sets[first_level_set_count + level - 1];
+      cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipeline_layout,
+                             0, set, {});
+      auto constants = depth_reduce_constants{
+          .source_size = source_size,
+          .destination_size = destination_size,
+      };
+      cmd.pushConstants(m_pipeline_layout, vk::ShaderStageFlagBits::eCompute,
+                        0, sizeof(constants), &constants);
+      cmd.dispatch((destination_size[0] + 7) / 8, (destination_size[1] + 7) / 8, 1);
+      auto level_barrier =
+          vk::MemoryBarrier{}
+              .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+              .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                          vk::PipelineStageFlagBits::eComputeShader, {},
+                          level_barrier, {}, {});
+      source_size = destination_size;
+    }
+  }
+  auto get_depth_pyramid_image() { return m_image; }
+  auto get_depth_pyramid_view() { return m_view; }
+  auto get_depth_pyramid_sampler() { return m_sampler; }
+  auto get_depth_pyramid_levels() { return m_levels; }
+  auto get_depth_pyramid_size() { return std::array<uint32_t, 2>{m_width, m_height}; }
+
+private:
+  vk::Image m_image;
+  vk::DeviceMemory m_memory;
+  vk::ImageView m_view;
+  std::vector<vk::ImageView> m_level_views;
+  vk::Sampler m_sampler;
+  uint32_t m_width;
+  uint32_t m_height;
+  uint32_t m_levels;
+  vk::DescriptorSetLayout m_set_layout;
+  vk::PipelineLayout m_pipeline_layout;
+  vk::Pipeline m_pipeline;
+  vk::DescriptorPool m_pool;
+  std::vector<vk::DescriptorSet> m_sets;
+};
+
+// two phase culling pipeline, descriptor sets are indexed by
+// 2 * swapchain image index + phase
+template <class T> class add_occlusion_cull_compute_pipeline : public T {
+public:
+  using parent = T;
+  add_occlusion_cull_compute_pipeline(const configure auto& conf) : parent{conf} { create(); }
+  ~add_occlusion_cull_compute_pipeline() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    auto storage_binding = [](uint32_t binding) {
+      return vk::DescriptorSetLayoutBinding{}
+          .setBinding(binding)
+          .setDescriptorCount(1)
+          .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+          .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    };
+    auto bindings = std::array{
+        storage_binding(0),
+        storage_binding(1),
+        storage_binding(2),
+        storage_binding(3),
+        vk::DescriptorSetLayoutBinding{}
+            .setBinding(4)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+    };
+    m_set_layout = device.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo{}.setBindings(bindings));
+    auto push_constant_range = vk::PushConstantRange{}
+                                   .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+                                   .setOffset(0)
+                                   .setSize(sizeof(occlusion_cull_constants));
+    m_pipeline_layout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo{}
+            .setSetLayouts(m_set_layout)
+            .setPushConstantRanges(push_constant_range));
+    auto [res, pipeline] = device.createComputePipeline(
+        nullptr,
+        vk::ComputePipelineCreateInfo{}
+            .setStage(vk::PipelineShaderStageCreateInfo{}
+                          .setStage(vk::ShaderStageFlagBits::eCompute)
+                          .setModule(parent::get_occlusion_cull_shader_module())
+                          .setPName("main"))
+            .setLayout(m_pipeline_layout));
+    if (res != vk::Result::eSuccess) {
+      throw std::runtime_error{"failed to create occlusion cull pipeline"};
+    }
+    m_pipeline = pipeline;
+
+    std::vector<vk::Buffer> object_buffers = parent::get_object_buffer_vector();
+    std::vector<vk::Buffer> draw_buffers = parent::get_draw_buffer_vector();
+    std::vector<vk::Buffer> statistics_buffers = parent::get_statistics_buffer_vector();
+    vk::Buffer visibility_buffer = parent::get_visibility_buffer();
+    vk::DeviceSize region_size =
+        get_two_phase_draw_region_size(parent::get_object_count());
+    uint32_t set_count = 2 * object_buffers.size();
+    auto pool_sizes = std::array{
+        vk::DescriptorPoolSize{}
+            .setType(vk::DescriptorType::eStorageBuffer)
+            .setDescriptorCount(4 * set_count),
+        vk::DescriptorPoolSize{}
+            .setType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(set_count),
+    };
+    m_pool = device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo{}.setMaxSets(set_count).setPoolSizes(pool_sizes));
+    std::vector<vk::DescriptorSetLayout> layouts(set_count, m_set_layout);
+    m_sets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{}
+                                               .setDescriptorPool(m_pool)
+                                               .setSetLayouts(layouts));
+
+    auto pyramid_info = vk::DescriptorImageInfo{}
+                            .setSampler(parent::get_depth_pyramid_sampler())
+                            .setImageView(parent::get_depth_pyramid_view())
+                            .setImageLayout(vk::ImageLayout::eGeneral);
+    std::vector<std::array<vk::DescriptorBufferInfo, 4>> buffer_infos(set_count);
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.reserve(bindings.size() * set_count);
+    for (uint32_t i = 0; i < set_count; i++) {
+      uint32_t index = i / 2;
+      uint32_t phase = i % 2;
+      buffer_infos[i] = {
+          vk::DescriptorBufferInfo{}.setBuffer(object_buffers[index]).setRange(vk::WholeSize),
+          vk::DescriptorBufferInfo{}
+              .setBuffer(draw_buffers[index])
+              .setOffset(phase * region_size)
+              .setRange(region_size),
+          vk::DescriptorBufferInfo{}.setBuffer(visibility_buffer).setRange(vk::WholeSize),
+          vk::DescriptorBufferInfo{}.setBuffer(statistics_buffers[index]).setRange(vk::WholeSize),
+      };
+      for (uint32_t binding = 0; binding < 4; binding++) {
+        writes.push_back(vk::WriteDescriptorSet{}
+                             .setDstSet(m_sets[i])
+                             .setDstBinding(binding)
+                             .setDescriptorCount(1)
+                             .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                             .setBufferInfo(buffer_infos[i][binding]));
+      }
+      writes.push_back(vk::WriteDescriptorSet{}
+                           .setDstSet(m_sets[i])
+                           .setDstBinding(4)
+                           .setDescriptorCount(1)
+                           .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                           .setImageInfo(pyramid_info));
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    device.destroyDescriptorPool(m_pool);
+    device.destroyPipeline(m_pipeline);
+    device.destroyPipelineLayout(m_pipeline_layout);
+    device.destroyDescriptorSetLayout(m_set_layout);
+  }
+  auto get_occlusion_cull_pipeline() { return m_pipeline; }
+  auto get_occlusion_cull_pipeline_layout() { return m_pipeline_layout; }
+  auto get_occlusion_cull_descriptor_set(uint32_t index, uint32_t phase) {
+    return m_sets[2 * index + phase];
+  }
+
+private:
+  vk::DescriptorSetLayout m_set_layout;
+  vk::PipelineLayout m_pipeline_layout;
+  vk::Pipeline m_pipeline;
+  vk::DescriptorPool m_pool;
+  std::vector<vk::DescriptorSet> m_sets;
+};
+
+// counters of swapchain image `index` are read once its fence signalled,
+// so they describe the last frame rendered into that image
+template <class T> class add_occlusion_culling_statistics : public T {
+public:
+  using parent = T;
+  add_occlusion_culling_statistics(const configure auto& conf)
+      : parent{conf}, m_statistics{} {
+    create();
+  }
+  void create() {
+    m_memory_ptrs = parent::get_statistics_buffer_memory_ptr_vector();
+    m_memories = parent::get_statistics_buffer_memory_vector();
+  }
+  void destroy() {}
+  void upload_frame_data(uint32_t index) {
+    vk::Device device = parent::get_device();
+    device.invalidateMappedMemoryRanges(vk::MappedMemoryRange{}
+                                            .setMemory(m_memories[index])
+                                            .setOffset(0)
+                                            .setSize(vk::WholeSize));
+    memcpy(&m_statistics, m_memory_ptrs[index], sizeof(m_statistics));
+    parent::upload_frame_data(index);
+  }
+  auto get_occlusion_culling_statistics() { return m_statistics; }
+
+private:
+  occlusion_culling_statistics m_statistics;
+  std::vector<void *> m_memory_ptrs;
+  std::vector<vk::DeviceMemory> m_memories;
+};
+
+// rows of cubes one behind the other, so the front rows hide most of the scene
+template <class T> class layout_objects_in_depth_rows : public T {
+public:
+  using parent = T;
+  layout_objects_in_depth_rows(const configure auto& conf) : parent{conf} {
+    auto& transforms = parent::get_object_transforms();
+    uint32_t count = transforms.size();
+    uint32_t columns = 8;
+    uint32_t per_row = columns * columns;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t in_row = i % per_row;
+      float x = 2.5f * (in_row % columns) - 1.25f * (columns - 1);
+      float y = 2.5f * (in_row / columns) - 1.25f * (columns - 1);
+      float z = 3.0f * (i / per_row);
+      transforms.set_position(i, x, y, z);
+    }
+  }
+};
+
+template<>
+class use_app<app::cube_occlusion_culled> {
+public:
+
+// first phase draws what was visible last frame, the depth pyramid is
+// built from that depth, and the second phase draws the objects that
+// became visible; culled objects never reach the vertex shader
+template <class T> class record_swapchain_command_buffers : public T {
+public:
+  using parent = T;
+  record_swapchain_command_buffers(const configure auto& conf) : parent{conf} { create(); }
+  void create() {
+    auto buffers = parent::get_swapchain_command_buffers();
+    auto swapchain_images = parent::get_swapchain_images();
+    auto queue_family_index = parent::get_queue_family_index();
+    auto framebuffers = parent::get_framebuffers();
+    std::vector<vk::Buffer> draw_buffers = parent::get_draw_buffer_vector();
+    std::vector<vk::Buffer> statistics_buffers = parent::get_statistics_buffer_vector();
+    std::vector<vk::Image> depth_images = parent::get_depth_images();
+    std::vector<vk::DescriptorSet> descriptor_sets =
+        parent::get_descriptor_set();
+    uint32_t object_count = parent::get_object_count();
+    uint32_t index_count = 3 * 2 * 3 * 2;
+    vk::DeviceSize region_size = get_two_phase_draw_region_size(object_count);
+
+    auto clear_values = get_clear_values(this);
+
+    if (buffers.size() != swapchain_images.size()) {
+      throw std::runtime_error{
+          "swapchain images count != command buffers count"};
+    }
+    auto constants = occlusion_cull_constants{
+        .bounds_min = {-1.0f, -1.0f, -1.0f, 0.0f},
+        .bounds_max = {1.0f, 1.0f, 1.0f, 0.0f},
+        .object_count = object_count,
+        .index_count = index_count,
+        .phase = 0,
+        .depth_pyramid_levels = parent::get_depth_pyramid_levels(),
+        .depth_pyramid_size = parent::get_depth_pyramid_size(),
+    };
+    auto depth_range = vk::ImageSubresourceRange{}
+                           .setAspectMask(vk::ImageAspectFlagBits::eDepth)
+                           .setLevelCount(1)
+                           .setLayerCount(1);
+    for (uint32_t index = 0; index < buffers.size(); index++) {
+      vk::CommandBuffer cmd = buffers[index];
+      vk::Buffer draw_buffer = draw_buffers[index];
+      vk::Image depth_image = depth_images[index];
+
+      cmd.begin(vk::CommandBufferBeginInfo{});
+
+      for (uint32_t phase = 0; phase < 2; phase++) {
+        cmd.fillBuffer(draw_buffer, phase * region_size + indirect_draw_count_offset,
+                       sizeof(uint32_t), 0);
+      }
+      cmd.fillBuffer(statistics_buffers[index], 0, vk::WholeSize, 0);
+      auto clear_barrier =
+          vk::MemoryBarrier{}
+              .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite)
+              .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+                          vk::PipelineStageFlagBits::eComputeShader, {},
+                          clear_barrier, {}, {});
+
+      vk::PipelineLayout cull_pipeline_layout =
+          parent::get_occlusion_cull_pipeline_layout();
+      vk::RenderPass render_passes[2] = {parent::get_render_pass(),
+                                         parent::get_load_render_pass()};
+      vk::Extent2D swapchain_image_extent =
+          parent::get_swapchain_image_extent();
+      auto render_area = vk::Rect2D{}
+                             .setOffset(vk::Offset2D{0, 0})
+                             .setExtent(swapchain_image_extent);
+      for (uint32_t phase = 0; phase < 2; phase++) {
+        if (phase == 1) {
+          auto depth_read_barrier =
+              vk::ImageMemoryBarrier{}
+                  .setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                  .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+                  .setOldLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                  .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                  .setSrcQueueFamilyIndex(queue_family_index)
+                  .setDstQueueFamilyIndex(queue_family_index)
+                  .setImage(depth_image)
+                  .setSubresourceRange(depth_range);
+          cmd.pipelineBarrier(vk::PipelineStageFlagBits::eLateFragmentTests,
+                              vk::PipelineStageFlagBits::eComputeShader, {}, {},
+                              {}, depth_read_barrier);
+          parent::record_build_depth_pyramid(cmd, index);
+        }
+
+        constants.phase = phase;
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute,
+                         parent::get_occlusion_cull_pipeline());
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cull_pipeline_layout,
+                               0, parent::get_occlusion_cull_descriptor_set(index, phase), {});
+        cmd.pushConstants(cull_pipeline_layout, vk::ShaderStageFlagBits::eCompute,
+                          0, sizeof(constants), &constants);
+        cmd.dispatch((object_count + 63) / 64, 1, 1);
+
+        auto draw_commands_barrier =
+            vk::BufferMemoryBarrier{}
+                .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead)
+                .setSrcQueueFamilyIndex(queue_family_index)
+                .setDstQueueFamilyIndex(queue_family_index)
+                .setBuffer(draw_buffer)
+                .setOffset(phase * region_size)
+                .setSize(region_size);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                            vk::PipelineStageFlagBits::eDrawIndirect, {}, {},
+                            draw_commands_barrier, {});
+        if (phase == 1) {
+          auto depth_write_barrier =
+              vk::ImageMemoryBarrier{}
+                  .setSrcAccessMask(vk::AccessFlagBits::eNone)
+                  .setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                  .setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                  .setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                  .setSrcQueueFamilyIndex(queue_family_index)
+                  .setDstQueueFamilyIndex(queue_family_index)
+                  .setImage(depth_image)
+                  .setSubresourceRange(depth_range);
+          cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                              vk::PipelineStageFlagBits::eEarlyFragmentTests, {}, {},
+                              {}, depth_write_barrier);
+        }
+
+        cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                                .setRenderPass(render_passes[phase])
+                                .setRenderArea(render_area)
+                                .setFramebuffer(framebuffers[index])
+                                .setClearValues(clear_values),
+                            vk::SubpassContents::eInline);
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, parent::get_pipeline());
+        vk::Buffer vertex_buffer = parent::get_vertex_buffer();
+        cmd.bindVertexBuffers(0, vertex_buffer, vk::DeviceSize{0});
+        vk::Buffer index_buffer = parent::get_index_buffer();
+        cmd.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint16);
+        vk::PipelineLayout pipeline_layout = parent::get_pipeline_layout();
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout,
+                               0, descriptor_sets[index], {});
+        cmd.drawIndexedIndirectCount(
+            draw_buffer, phase * region_size + indirect_draw_commands_offset,
+            draw_buffer, phase * region_size + indirect_draw_count_offset,
+            object_count, sizeof(vk::DrawIndexedIndirectCommand));
+        cmd.endRenderPass();
+      }
+
+      auto statistics_barrier =
+          vk::BufferMemoryBarrier{}
+              .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+              .setDstAccessMask(vk::AccessFlagBits::eHostRead)
+              .setSrcQueueFamilyIndex(queue_family_index)
+              .setDstQueueFamilyIndex(queue_family_index)
+              .setBuffer(statistics_buffers[index])
+              .setOffset(0)
+              .setSize(vk::WholeSize);
+      cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                          vk::PipelineStageFlagBits::eHost, {}, {},
+                          statistics_barrier, {});
+      cmd.end();
+    }
+  }
+  void destroy() {}
+}; // class record_swapchain_command_buffers in use_app<app::cube_occlusion_culled>
+
+template <class T>
+class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
+};
+
+template <class T> class add_resources_and_draw
+  : public
+    add_frame_allocation_check<
+    add_frame_time_analyser<
+    add_dynamic_draw <
+    add_process_suboptimal_image<
+        decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_queue_wait_idle_to_recreate_surface<
+    add_recreate_surface_for<
+    add_occlusion_culling_statistics <
+    add_recreate_surface_for<
+    add_object_buffer_upload <
+    layout_objects_in_depth_rows <
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_clock <
+    add_acquire_next_image_semaphores <
+    add_acquire_next_image_semaphore_fences <
+    add_draw_semaphores <
+    add_recreate_surface_for<
+    vulkan_start::use_app<vulkan_start::app::cube_occlusion_culled>::record_swapchain_command_buffers<
+    add_get_format_clear_color_value_type <
+    add_recreate_surface_for<
+    add_swapchain_command_buffers <
+    add_recreate_surface_for<
+    add_occlusion_cull_compute_pipeline <
+    add_recreate_surface_for<
+    add_depth_pyramid <
+    add_visibility_buffer <
+    rename_shader_module_to_occlusion_cull_shader_module <
+    add_shader_module <
+    add_spirv_code <
+    adapte_map_file_to_spirv_code <
+    map_file_mapping <
+    cache_file_size <
+    add_file_mapping <
+    add_file <
+    add_file_path <decltype([]() {return std::string{"shaders/cull_occlusion.spv"};}),
+    rename_shader_module_to_depth_reduce_shader_module <
+    add_shader_module <
+    add_spirv_code <
+    adapte_map_file_to_spirv_code <
+    map_file_mapping <
+    cache_file_size <
+    add_file_mapping <
+    add_file <
+    add_file_path <decltype([]() {return std::string{"shaders/depth_reduce.spv"};}),
+    add_recreate_surface_for<
+    write_object_descriptor_set<
+    add_recreate_surface_for<
+    add_nonfree_descriptor_set<
+    add_recreate_surface_for<
+    add_descriptor_pool<
+    add_buffer_memory_with_data_copy<
+    rename_buffer_to_index_buffer<
+    add_buffer_as_member<
+    set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
+    add_optimized_cube_index_buffer_data<
+    rename_buffer_vector_to_statistics_buffer_vector <
+    rename_buffer_memory_vector_to_statistics_buffer_memory_vector<
+    rename_buffer_memory_ptr_vector_to_statistics_buffer_memory_ptr_vector<
+    add_recreate_surface_for<
+    map_buffer_memory_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties < vk::MemoryPropertyFlagBits::eHostVisible,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count<
+    add_buffer_usage<vk::BufferUsageFlagBits::eTransferDst,
+    add_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    empty_buffer_usage<
+    set_buffer_size<sizeof(occlusion_culling_statistics),
+    rename_buffer_vector_to_draw_buffer_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties<vk::MemoryPropertyFlagBits::eDeviceLocal,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count <
+    add_buffer_usage<vk::BufferUsageFlagBits::eTransferDst,
+    add_buffer_usage<vk::BufferUsageFlagBits::eIndirectBuffer,
+    add_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    empty_buffer_usage<
+    set_buffer_size_to_two_phase_indirect_draws<
+    rename_buffer_vector_to_object_buffer_vector <
+    rename_buffer_memory_vector_to_object_buffer_memory_vector<
+    rename_buffer_memory_ptr_vector_to_object_buffer_memory_ptr_vector<
+    add_recreate_surface_for<
+    map_buffer_memory_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties < vk::MemoryPropertyFlagBits::eHostVisible,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count<
+    set_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    set_buffer_size_to_object_matrices<
+    add_buffer_memory_with_data_copy <
+    rename_buffer_to_vertex_buffer<
+    add_buffer_as_member <
+    set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
+    add_optimized_cube_vertex_buffer_data <
+    add_recreate_surface_for<
+    add_graphics_pipeline <
+    add_pipeline_vertex_input_state <
+    add_vertex_binding_description <
+    add_empty_binding_descriptions <
+    add_vertex_attribute_description <
+    set_vertex_input_attribute_format<vk::Format::eR16G16B16A16Snorm,
+    add_empty_vertex_attribute_descriptions <
+    set_binding < 0,
+    set_stride < sizeof(int16_t) * 4,
+    set_input_rate < vk::VertexInputRate::eVertex,
+    set_subpass < 0,
+    add_recreate_surface_for<
+    add_framebuffers_cube <
+    add_load_render_pass <
+    add_render_pass_cube <
+    store_depth_attachment <
+    add_subpasses <
+    add_subpass_dependency <
+    add_empty_subpass_dependencies <
+    add_depth_attachment<
+    add_attachment <
+    add_empty_attachments <
+    add_pipeline_viewport_state <
+    add_scissor_equal_swapchain_extent<
+    add_empty_scissors <
+    add_viewport_equal_swapchain_image_rect <
+    add_empty_viewports <
+    set_tessellation_patch_control_point_count < 1,
+    set_object_count < 1024,
+    T
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+{};
+}; // class use_app<app::cube_occlusion_culled>
+
+template <class T> class add_occlusion_culled_swapchain_and_pipeline_layout
+  : public
+  add_pipeline_layout<
+	add_single_descriptor_set_layout<
+	add_descriptor_set_layout<
+	add_object_storage_descriptor_set_layout_binding<
+	set_pipeline_rasterization_polygon_mode< vk::PolygonMode::eFill,
+	disable_pipeline_multisample<
+	set_pipeline_input_topology< vk::PrimitiveTopology::eTriangleList,
+	disable_pipeline_dynamic<
+	enable_pipeline_depth_test<
+	add_pipeline_color_blend_state_create_info<
+	disable_pipeline_attachment_color_blend< 0, // disable index 0 attachment
+	add_pipeline_color_blend_attachment_states< 1, // 1 attachment
+	rename_images_views_to_depth_images_views<
+	add_recreate_surface_for<
+	barrier_depth_image_layout<
+	add_recreate_surface_for<
+	add_depth_images_views_cube<
+	add_recreate_surface_for<
+	add_images_memories<
+	add_image_memory_property<vk::MemoryPropertyFlagBits::eDeviceLocal,
+	add_empty_image_memory_properties<
+	rename_images_to_depth_images<
+	add_recreate_surface_for<
+	add_images<
+	add_image_type<vk::ImageType::e2D,
+	set_image_tiling<vk::ImageTiling::eOptimal,
+	set_image_samples<vk::SampleCountFlagBits::e1,
+	add_image_extent_equal_swapchain_image_extent<
+	add_image_usage<vk::ImageUsageFlagBits::eSampled,
+	add_image_usage<vk::ImageUsageFlagBits::eDepthStencilAttachment,
+	add_empty_image_usages<
+	rename_image_format_to_depth_image_format<
+	add_image_format<vk::Format::eD32Sfloat,
+	add_image_count_equal_swapchain_image_count<
+	add_recreate_surface_for<
+	add_swapchain_images_views<
+	add_recreate_surface_for<
+	add_swapchain_images<
+	add_recreate_surface_for<
+	add_configured_swapchain<
+	add_swapchain_image_format<
+  T
+  >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+{};
+
+template<platform PLATFORM>
+class use_platform_add_cube_occlusion_culled_physical_device_and_device_and_draw {
+public:
+template<class T>
+class add_cube_occlusion_culled_physical_device_and_device_and_draw
+    : public
+    use_app<app::cube_occlusion_culled>::add_resources_and_draw<
+    add_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_indirect_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
+    add_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
+	set_shader_entry_name_with_main <
+	add_empty_pipeline_stages <
+	add_occlusion_culled_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+	add_command_pool <
+	add_queue <
+	add_device_with_features <
+        decltype(
+            []() {
+                auto features = vk::StructureChain<
+                vk::PhysicalDeviceFeatures2,
+                vk::PhysicalDeviceVulkan12Features
+                >{};
+                auto& [features2, vulkan12_features] = features;
+                features2.features.multiDrawIndirect = vk::True;
+                features2.features.drawIndirectFirstInstance = vk::True;
+                vulkan12_features.drawIndirectCount = vk::True;
+                return features;
+            }
+        )
+        ,
+	add_swapchain_extension <
+	add_empty_extensions <
+	add_find_properties <
+	cache_physical_device_memory_properties<
+	add_recreate_surface_for<
+	cache_surface_capabilities<
+	add_recreate_surface_for<
+	test_physical_device_support_surface<
+	add_queue_family_index <
+  typename set_app_and_platform<app::cube_occlusion_culled, PLATFORM>::template add_physical_device_and_surface<
+  T
+  >>>>>>>>>>>>>>>>>>>>>
+{};
+}; // class use_platform_*
+
+} // namespace vulkan_start
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include "gpu_driven.hpp"
+
+namespace vulkan_start {
+
+// records the render pass every frame: the objects are split into one slice
+// per recording thread, each slice is a job on the job system that draws
+// into a secondary command buffer from the slice's own pool, and the
+// primary command buffer executes them. every swapchain image has its own
+// pools, which are reset as a whole once the image's fence signalled.
+// replaces add_swapchain_command_buffers and record_swapchain_command_buffers
+template <class T> class add_parallel_frame_recording : public T {
+public:
+  using parent = T;
+  add_parallel_frame_recording(const configure auto& conf)
+      : parent{conf},
+        m_max_thread_count{parent::get_job_system().get_thread_count()},
+        m_active_thread_count{m_max_thread_count}, m_recording_time{},
+        m_state{} {
+    create();
+  }
+  ~add_parallel_frame_recording() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    uint32_t queue_family_index = parent::get_queue_family_index();
+    uint32_t image_count = parent::get_swapchain_images().size();
+    auto pool_info = vk::CommandPoolCreateInfo{}
+                         .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+                         .setQueueFamilyIndex(queue_family_index);
+    m_frames.resize(image_count);
+    for (auto& frame : m_frames) {
+      frame.primary_pool = device.createCommandPool(pool_info);
+      frame.primary = device.allocateCommandBuffers(
+          vk::CommandBufferAllocateInfo{}
+              .setCommandPool(frame.primary_pool)
+              .setLevel(vk::CommandBufferLevel::ePrimary)
+              .setCommandBufferCount(1))[0];
+      frame.pools.resize(m_max_thread_count);
+      frame.secondaries.resize(m_max_thread_count);
+      for (uint32_t i = 0; i < m_max_thread_count; i++) {
+        frame.pools[i] = device.createCommandPool(pool_info);
+        frame.secondaries[i] = device.allocateCommandBuffers(
+            vk::CommandBufferAllocateInfo{}
+                .setCommandPool(frame.pools[i])
+                .setLevel(vk::CommandBufferLevel::eSecondary)
+                .setCommandBufferCount(1))[0];
+      }
+    }
+
+    m_clear_values = get_clear_values(this);
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    for (auto& frame : m_frames) {
+      for (vk::CommandPool pool : frame.pools) {
+        device.destroyCommandPool(pool);
+      }
+      device.destroyCommandPool(frame.primary_pool);
+    }
+    m_frames.clear();
+  }
+  void upload_frame_data(uint32_t index) {
+    parent::upload_frame_data(index);
+    auto start = std::chrono::steady_clock::now();
+    record(index);
+    m_recording_time = std::chrono::steady_clock::now() - start;
+  }
+  auto get_swapchain_command_buffer(uint32_t index) {
+    return m_frames[index].primary;
+  }
+  void set_recording_thread_count(uint32_t count) {
+    m_active_thread_count = std::clamp(count, 1u, m_max_thread_count);
+  }
+  auto get_recording_thread_count() { return m_active_thread_count; }
+  auto get_max_recording_thread_count() { return m_max_thread_count; }
+  // wall time of the last frame's recording, primary buffer included
+  auto get_recording_time() { return m_recording_time; }
+
+private:
+  struct frame_resources {
+    vk::CommandPool primary_pool;
+    vk::CommandBuffer primary;
+    std::vector<vk::CommandPool> pools;
+    std::vector<vk::CommandBuffer> secondaries;
+  };
+  // everything a recording thread needs, gathered on the calling thread so
+  // the workers never touch the mixin stack
+  struct recording_state {
+    frame_resources* frame;
+    vk::Device device;
+    vk::RenderPass render_pass;
+    vk::Framebuffer framebuffer;
+    vk::Pipeline pipeline;
+    vk::PipelineLayout pipeline_layout;
+    vk::DescriptorSet descriptor_set;
+    vk::Buffer vertex_buffer;
+    vk::Buffer index_buffer;
+    uint32_t object_count;
+    uint32_t thread_count;
+  };
+
+  void record(uint32_t index) {
+    if (index >= m_frames.size()) {
+      throw std::runtime_error{"swapchain image index >= recording frames count"};
+    }
+    frame_resources& frame = m_frames[index];
+    m_state = recording_state{
+        .frame = &frame,
+        .device = parent::get_device(),
+        .render_pass = parent::get_render_pass(),
+        .framebuffer = parent::get_framebuffers()[index],
+        .pipeline = parent::get_pipeline(),
+        .pipeline_layout = parent::get_pipeline_layout(),
+        .descriptor_set = parent::get_descriptor_set()[index],
+        .vertex_buffer = parent::get_vertex_buffer(),
+        .index_buffer = parent::get_index_buffer(),
+        .object_count = parent::get_object_count(),
+        .thread_count = m_active_thread_count,
+    };
+    parent::get_job_system().parallel_for(
+        m_active_thread_count, 1, [this](uint32_t begin, uint32_t end) {
+          for (uint32_t slice = begin; slice < end; slice++) {
+            record_secondary(m_state, slice);
+          }
+        });
+
+    m_state.device.resetCommandPool(frame.primary_pool);
+    vk::CommandBuffer cmd = frame.primary;
+    cmd.begin(vk::CommandBufferBeginInfo{}.setFlags(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    auto render_area = vk::Rect2D{}
+                           .setOffset(vk::Offset2D{0, 0})
+                           .setExtent(parent::get_swapchain_image_extent());
+    cmd.beginRenderPass(vk::RenderPassBeginInfo{}
+                            .setRenderPass(m_state.render_pass)
+                            .setRenderArea(render_area)
+                            .setFramebuffer(m_state.framebuffer)
+                            .setClearValues(m_clear_values),
+                        vk::SubpassContents::eSecondaryCommandBuffers);
+    cmd.executeCommands(vk::ArrayProxy<const vk::CommandBuffer>{
+        m_active_thread_count, frame.secondaries.data()});
+    cmd.endRenderPass();
+    cmd.end();
+  }
+  static void record_secondary(const recording_state& state, uint32_t slice) {
+    state.device.resetCommandPool(state.frame->pools[slice]);
+    vk::CommandBuffer cmd = state.frame->secondaries[slice];
+    auto inheritance = vk::CommandBufferInheritanceInfo{}
+                           .setRenderPass(state.render_pass)
+                           .setSubpass(0)
+                           .setFramebuffer(state.framebuffer);
+    cmd.begin(vk::CommandBufferBeginInfo{}
+                  .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                            vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+                  .setPInheritanceInfo(&inheritance));
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, state.pipeline);
+    cmd.bindVertexBuffers(0, state.vertex_buffer, vk::DeviceSize{0});
+    cmd.bindIndexBuffer(state.index_buffer, 0, vk::IndexType::eUint16);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                           state.pipeline_layout, 0, state.descriptor_set, {});
+    uint32_t begin = state.object_count * slice / state.thread_count;
+    uint32_t end = state.object_count * (slice + 1) / state.thread_count;
+    uint32_t index_count = 3 * 2 * 3 * 2;
+    // one draw per object, the instance index selects its transform
+    for (uint32_t i = begin; i < end; i++) {
+      cmd.drawIndexed(index_count, 1, 0, 0, i);
+    }
+    cmd.end();
+  }
+
+  uint32_t m_max_thread_count;
+  uint32_t m_active_thread_count;
+  std::chrono::steady_clock::duration m_recording_time;
+  recording_state m_state;
+  std::vector<frame_resources> m_frames;
+  std::array<vk::ClearValue, 2> m_clear_values;
+};
+
+// steps the recording thread count from 1 to the maximum, FRAMES frames
+// each, and logs the mean recording time of every step
+template <uint32_t FRAMES, class T>
+class add_recording_thread_count_benchmark : public T {
+public:
+  using parent = T;
+  add_recording_thread_count_benchmark(const configure auto& conf)
+      : parent{conf}, m_frame{0}, m_total{}, m_done{false} {
+    parent::set_recording_thread_count(1);
+  }
+  void draw() {
+    parent::draw();
+    if (m_done) {
+      return;
+    }
+    m_total += parent::get_recording_time();
+    if (++m_frame < FRAMES) {
+      return;
+    }
+    uint32_t count = parent::get_recording_thread_count();
+    std::clog << "recording threads: " << count << " mean recording time: "
+              << std::chrono::duration<double, std::micro>(m_total).count() / FRAMES
+              << "us" << std::endl;
+    m_frame = 0;
+    m_total = {};
+    if (count == parent::get_max_recording_thread_count()) {
+      m_done = true;
+    } else {
+      parent::set_recording_thread_count(count + 1);
+    }
+  }
+
+private:
+  uint32_t m_frame;
+  std::chrono::steady_clock::duration m_total;
+  bool m_done;
+};
+
+template<>
+class use_app<app::cube_parallel_recorded> {
+public:
+
+template <class T>
+class add_physical_device : public ::vulkan_hpp_helper::add_physical_device<T> {
+};
+
+template <class T> class add_resources_and_draw
+  : public
+    add_frame_allocation_check<
+    add_frame_time_analyser<
+    add_recording_thread_count_benchmark< 120,
+    add_dynamic_draw <
+    add_process_suboptimal_image<
+        decltype([](auto* p) {p->recreate_surface();std::cout << "recreate surface" << std::endl;}),
+    add_queue_wait_idle_to_recreate_surface<
+    add_recreate_surface_for<
+    add_parallel_frame_recording <
+    add_recreate_surface_for<
+    add_object_buffer_upload <
+    compose_object_matrices_in_parallel< 1024,
+    apply_vertex_dequantization <
+    add_object_transforms <
+    add_clock <
+    add_acquire_next_image_semaphores <
+    add_acquire_next_image_semaphore_fences <
+    add_draw_semaphores <
+    add_get_format_clear_color_value_type <
+    add_recreate_surface_for<
+    write_object_descriptor_set<
+    add_recreate_surface_for<
+    add_nonfree_descriptor_set<
+    add_recreate_surface_for<
+    add_descriptor_pool<
+    add_buffer_memory_with_data_copy<
+    rename_buffer_to_index_buffer<
+    add_buffer_as_member<
+    set_buffer_usage<vk::BufferUsageFlagBits::eIndexBuffer,
+    add_optimized_cube_index_buffer_data<
+    rename_buffer_vector_to_object_buffer_vector <
+    rename_buffer_memory_vector_to_object_buffer_memory_vector<
+    rename_buffer_memory_ptr_vector_to_object_buffer_memory_ptr_vector<
+    add_recreate_surface_for<
+    map_buffer_memory_vector<
+    add_recreate_surface_for<
+    add_buffer_memory_vector<
+    set_buffer_memory_properties < vk::MemoryPropertyFlagBits::eHostVisible,
+    add_recreate_surface_for<
+    add_buffer_vector<
+    set_vector_size_to_swapchain_image_count<
+    set_buffer_usage<vk::BufferUsageFlagBits::eStorageBuffer,
+    set_buffer_size_to_object_matrices<
+    add_buffer_memory_with_data_copy <
+    rename_buffer_to_vertex_buffer<
+    add_buffer_as_member <
+    set_buffer_usage<vk::BufferUsageFlagBits::eVertexBuffer,
+    add_optimized_cube_vertex_buffer_data <
+    add_recreate_surface_for<
+    add_graphics_pipeline <
+    add_pipeline_vertex_input_state <
+    add_vertex_binding_description <
+    add_empty_binding_descriptions <
+    add_vertex_attribute_description <
+    set_vertex_input_attribute_format<vk::Format::eR16G16B16A16Snorm,
+    add_empty_vertex_attribute_descriptions <
+    set_binding < 0,
+    set_stride < sizeof(int16_t) * 4,
+    set_input_rate < vk::VertexInputRate::eVertex,
+    set_subpass < 0,
+    add_recreate_surface_for<
+    add_framebuffers_cube <
+    add_render_pass_cube <
+    add_subpasses <
+    add_subpass_dependency <
+    add_empty_subpass_dependencies <
+    add_depth_attachment<
+    add_attachment <
+    add_empty_attachments <
+    add_pipeline_viewport_state <
+    add_scissor_equal_swapchain_extent<
+    add_empty_scissors <
+    add_viewport_equal_swapchain_image_rect <
+    add_empty_viewports <
+    set_tessellation_patch_control_point_count < 1,
+    set_object_count < 4096,
+    add_job_system <
+    T
+    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+{};
+}; // class use_app<app::cube_parallel_recorded>
+
+template<platform PLATFORM>
+class use_platform_add_cube_parallel_recorded_physical_device_and_device_and_draw {
+public:
+template<class T>
+class add_cube_parallel_recorded_physical_device_and_device_and_draw
+    : public
+    use_app<app::cube_parallel_recorded>::add_resources_and_draw<
+    add_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_indirect_vert.spv"};}), vk::ShaderStageFlagBits::eVertex,
+    add_spirv_file_to_pipeline_stages<
+        decltype([]() {return std::string{"shaders/cube_frag.spv"};}), vk::ShaderStageFlagBits::eFragment,
+	set_shader_entry_name_with_main <
+	add_empty_pipeline_stages <
+	add_gpu_driven_swapchain_and_pipeline_layout<
+    typename use_platform_add_swapchain_image_extent<PLATFORM>::template add_swapchain_image_extent<
+	add_command_pool <
+	add_queue <
+	add_device <
+	add_swapchain_extension <
+	add_empty_extensions <
+	add_find_properties <
+	cache_physical_device_memory_properties<
+	add_recreate_surface_for<
+	cache_surface_capabilities<
+	add_recreate_surface_for<
+	test_physical_device_support_surface<
+	add_queue_family_index <
+  typename set_app_and_platform<app::cube_parallel_recorded, PLATFORM>::template add_physical_device_and_surface<
+  T
+  >>>>>>>>>>>>>>>>>>>>
+{};
+}; // class use_platform_*
+
+} // namespace vulkan_start
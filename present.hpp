@@ -0,0 +1,527 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "memory.hpp"
+#include "vulkan_start.hpp"
+
+namespace vulkan_start {
+
+// swapchain settings an app can be constructed with. layers take them from
+// any configure that has these members, so empty_configure keeps the
+// defaults
+struct present_configure : empty_configure {
+    vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+    // 0 asks for one image more than the surface minimum
+    uint32_t image_count = 0;
+    // swapchain size where the app picks it, as on wayland; 0 follows the
+    // window
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    // start frames just before the next refresh where the platform can
+    bool frame_pacing = true;
+    // a pointer motion is made up every Nth frame, 0 for none
+    uint32_t synthetic_input_every = 0;
+};
+
+vk::PresentModeKHR get_configured_present_mode(const auto& conf) {
+    if constexpr (requires { conf.present_mode; }) {
+        return conf.present_mode;
+    } else {
+        return vk::PresentModeKHR::eFifo;
+    }
+}
+uint32_t get_configured_image_count(const auto& conf) {
+    if constexpr (requires { conf.image_count; }) {
+        return conf.image_count;
+    } else {
+        return 0;
+    }
+}
+uint32_t get_configured_synthetic_input_every(const auto& conf) {
+    if constexpr (requires { conf.synthetic_input_every; }) {
+        return conf.synthetic_input_every;
+    } else {
+        return 0;
+    }
+}
+
+inline vk::PresentModeKHR parse_present_mode(std::string_view name) {
+    if (name == "fifo") {
+        return vk::PresentModeKHR::eFifo;
+    } else if (name == "fifo_relaxed") {
+        return vk::PresentModeKHR::eFifoRelaxed;
+    } else if (name == "mailbox") {
+        return vk::PresentModeKHR::eMailbox;
+    } else if (name == "immediate") {
+        return vk::PresentModeKHR::eImmediate;
+    }
+    throw std::runtime_error{"unknown present mode " + std::string{name}};
+}
+
+// the requested mode if the surface supports it. otherwise mailbox and
+// immediate fall back to each other, as both are picked for latency, and
+// everything ends at fifo, the only mode every surface has
+inline vk::PresentModeKHR choose_present_mode(vk::PresentModeKHR requested,
+                                              std::span<const vk::PresentModeKHR> supported) {
+    using enum vk::PresentModeKHR;
+    auto preference = std::array{requested, eFifo};
+    if (requested == eMailbox) {
+        preference = {eMailbox, eImmediate};
+    } else if (requested == eImmediate) {
+        preference = {eImmediate, eMailbox};
+    }
+    for (auto mode : preference) {
+        if (std::ranges::find(supported, mode) != supported.end()) {
+            return mode;
+        }
+    }
+    return eFifo;
+}
+
+// replaces add_swapchain: creates the swapchain with the configured present
+// mode and image count, both settled against what the surface supports each
+// time the swapchain is recreated
+template <class T> class add_configured_swapchain : public T {
+public:
+  using parent = T;
+  add_configured_swapchain(const configure auto& conf)
+      : parent{conf},
+        m_requested_present_mode{get_configured_present_mode(conf)},
+        m_requested_image_count{get_configured_image_count(conf)} {
+    create();
+  }
+  ~add_configured_swapchain() { destroy(); }
+  void create() {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    vk::SurfaceKHR surface = parent::get_surface();
+    vk::Device device = parent::get_device();
+
+    auto capabilities = physical_device.getSurfaceCapabilitiesKHR(surface);
+    auto present_modes = physical_device.getSurfacePresentModesKHR(surface);
+    m_present_mode = choose_present_mode(m_requested_present_mode, present_modes);
+
+    uint32_t image_count = m_requested_image_count != 0
+                               ? m_requested_image_count
+                               : capabilities.minImageCount + 1;
+    image_count = std::max(image_count, capabilities.minImageCount);
+    if (capabilities.maxImageCount != 0) {
+      image_count = std::min(image_count, capabilities.maxImageCount);
+    }
+
+    vk::Format format = parent::get_swapchain_image_format();
+    auto surface_formats = physical_device.getSurfaceFormatsKHR(surface);
+    auto surface_format = std::ranges::find_if(
+        surface_formats, [format](auto f) { return f.format == format; });
+    if (surface_format == surface_formats.end()) {
+      throw std::runtime_error{"surface does not support swapchain image format"};
+    }
+
+    auto composite_alpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+    for (auto alpha : {vk::CompositeAlphaFlagBitsKHR::eOpaque,
+                       vk::CompositeAlphaFlagBitsKHR::eInherit,
+                       vk::CompositeAlphaFlagBitsKHR::ePreMultiplied,
+                       vk::CompositeAlphaFlagBitsKHR::ePostMultiplied}) {
+      if (capabilities.supportedCompositeAlpha & alpha) {
+        composite_alpha = alpha;
+        break;
+      }
+    }
+
+    uint32_t queue_family_index = parent::get_queue_family_index();
+    m_swapchain = device.createSwapchainKHR(
+        vk::SwapchainCreateInfoKHR{}
+            .setSurface(surface)
+            .setMinImageCount(image_count)
+            .setImageFormat(format)
+            .setImageColorSpace(surface_format->colorSpace)
+            .setImageExtent(parent::get_swapchain_image_extent())
+            .setImageArrayLayers(1)
+            .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment |
+                           (capabilities.supportedUsageFlags &
+                            vk::ImageUsageFlagBits::eTransferSrc))
+            .setImageSharingMode(vk::SharingMode::eExclusive)
+            .setQueueFamilyIndices(queue_family_index)
+            .setPreTransform(capabilities.currentTransform)
+            .setCompositeAlpha(composite_alpha)
+            .setPresentMode(m_present_mode)
+            .setClipped(true));
+    std::clog << "swapchain: " << vk::to_string(m_present_mode) << ", "
+              << image_count << " images requested" << std::endl;
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    device.destroySwapchainKHR(m_swapchain);
+  }
+  auto get_swapchain() { return m_swapchain; }
+  auto get_present_mode() { return m_present_mode; }
+
+private:
+  vk::PresentModeKHR m_requested_present_mode;
+  uint32_t m_requested_image_count;
+  vk::PresentModeKHR m_present_mode;
+  vk::SwapchainKHR m_swapchain;
+};
+
+// replaces add_device: creates the device with parent's extensions and
+// enables VK_KHR_present_id and VK_KHR_present_wait on top when the
+// physical device has both. VK_EXT_device_memory_report is enabled the same
+// way, its allocations go to the tracker of get_device_memory_tracker(), and
+// VK_KHR_synchronization2, whose vkCmdPipelineBarrier2KHR render graphs
+// record their barriers with
+template <class T> class add_device_with_optional_present_wait : public T {
+public:
+  using parent = T;
+  add_device_with_optional_present_wait(const configure auto& conf)
+      : parent{conf}, m_present_wait_supported{false} {
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    auto extensions = parent::get_extensions();
+
+    auto available = physical_device.enumerateDeviceExtensionProperties();
+    auto has_extension = [&available](std::string_view name) {
+      return std::ranges::any_of(available, [name](auto& p) {
+        return name == std::string_view{p.extensionName};
+      });
+    };
+    if (has_extension(vk::KHRPresentIdExtensionName) &&
+        has_extension(vk::KHRPresentWaitExtensionName)) {
+      auto features = physical_device.getFeatures2<
+          vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR,
+          vk::PhysicalDevicePresentWaitFeaturesKHR>();
+      m_present_wait_supported =
+          features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+          features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+    }
+    bool memory_report_supported = false;
+    if (has_extension(vk::EXTDeviceMemoryReportExtensionName)) {
+      auto features = physical_device.getFeatures2<
+          vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDeviceMemoryReportFeaturesEXT>();
+      memory_report_supported =
+          features.get<vk::PhysicalDeviceDeviceMemoryReportFeaturesEXT>().deviceMemoryReport;
+    }
+    bool synchronization2_supported = false;
+    if (has_extension(vk::KHRSynchronization2ExtensionName)) {
+      auto features = physical_device.getFeatures2<
+          vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceSynchronization2FeaturesKHR>();
+      synchronization2_supported =
+          features.get<vk::PhysicalDeviceSynchronization2FeaturesKHR>().synchronization2;
+    }
+
+    float priority = 1.0f;
+    auto queue_create_info = vk::DeviceQueueCreateInfo{}
+                                 .setQueueFamilyIndex(parent::get_queue_family_index())
+                                 .setQueuePriorities(priority);
+    void* next = nullptr;
+    auto memory_report_info = vk::DeviceDeviceMemoryReportCreateInfoEXT{};
+    auto memory_report_features =
+        vk::PhysicalDeviceDeviceMemoryReportFeaturesEXT{}.setDeviceMemoryReport(vk::True);
+    if (memory_report_supported) {
+      extensions.push_back(vk::EXTDeviceMemoryReportExtensionName);
+      memory_report_info = m_memory_tracker.get_report_create_info();
+      memory_report_features.setPNext(&memory_report_info);
+      next = &memory_report_features;
+    }
+    auto synchronization2_features = vk::PhysicalDeviceSynchronization2FeaturesKHR{}
+                                         .setSynchronization2(vk::True)
+                                         .setPNext(next);
+    if (synchronization2_supported) {
+      extensions.push_back(vk::KHRSynchronization2ExtensionName);
+      next = &synchronization2_features;
+    }
+    auto present_wait_features =
+        vk::PhysicalDevicePresentWaitFeaturesKHR{}.setPresentWait(vk::True).setPNext(next);
+    auto present_id_features = vk::PhysicalDevicePresentIdFeaturesKHR{}
+                                   .setPresentId(vk::True)
+                                   .setPNext(&present_wait_features);
+    if (m_present_wait_supported) {
+      extensions.push_back(vk::KHRPresentIdExtensionName);
+      extensions.push_back(vk::KHRPresentWaitExtensionName);
+      next = &present_id_features;
+    }
+    auto create_info = vk::DeviceCreateInfo{}
+                           .setQueueCreateInfos(queue_create_info)
+                           .setPNext(next)
+                           .setPEnabledExtensionNames(extensions);
+    m_device = physical_device.createDevice(create_info);
+
+    if (m_present_wait_supported) {
+      m_vk_wait_for_present_khr = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+          vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+    }
+    if (synchronization2_supported) {
+      m_vk_cmd_pipeline_barrier2_khr = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+          vkGetDeviceProcAddr(m_device, "vkCmdPipelineBarrier2KHR"));
+    }
+  }
+  ~add_device_with_optional_present_wait() {
+    m_memory_tracker.log_live_device_memory();
+    m_device.destroy();
+  }
+  auto get_device() { return m_device; }
+  bool get_present_wait_supported() { return m_present_wait_supported; }
+  device_memory_tracker& get_device_memory_tracker() { return m_memory_tracker; }
+  // null without VK_KHR_synchronization2
+  PFN_vkCmdPipelineBarrier2KHR get_vk_cmd_pipeline_barrier2() {
+    return m_vk_cmd_pipeline_barrier2_khr;
+  }
+  vk::Result wait_for_present(vk::SwapchainKHR swapchain, uint64_t present_id,
+                              uint64_t timeout) {
+    return vk::Result{
+        m_vk_wait_for_present_khr(m_device, swapchain, present_id, timeout)};
+  }
+
+private:
+  device_memory_tracker m_memory_tracker;
+  vk::Device m_device;
+  bool m_present_wait_supported;
+  PFN_vkWaitForPresentKHR m_vk_wait_for_present_khr = nullptr;
+  PFN_vkCmdPipelineBarrier2KHR m_vk_cmd_pipeline_barrier2_khr = nullptr;
+};
+
+template <class T>
+concept present_id_provider = requires(T t, vk::SwapchainKHR swapchain) {
+  { t.next_present_id(swapchain) } -> std::convertible_to<uint64_t>;
+};
+
+// remembers when the oldest input event that no frame has shown yet
+// arrived, so the present of the next frame can be timed from it. events come
+// straight from the window system callbacks, or from add_render_thread's
+// queue with the stamp its callbacks took
+template <class T> class add_input_timestamps : public T {
+public:
+  using parent = T;
+  add_input_timestamps(const configure auto& conf)
+      : parent{conf}, m_oldest_input{} {}
+  void process_key_event(int key, int state) {
+    stamp(std::chrono::steady_clock::now());
+    if constexpr (requires { parent::process_key_event(key, state); }) {
+      parent::process_key_event(key, state);
+    }
+  }
+  void process_pointer_motion_event(uint32_t x, uint32_t y) {
+    stamp(std::chrono::steady_clock::now());
+    if constexpr (requires { parent::process_pointer_motion_event(x, y); }) {
+      parent::process_pointer_motion_event(x, y);
+    }
+  }
+  void process_pointer_button_event(int button, int button_state) {
+    stamp(std::chrono::steady_clock::now());
+    if constexpr (requires { parent::process_pointer_button_event(button, button_state); }) {
+      parent::process_pointer_button_event(button, button_state);
+    }
+  }
+  void process_input_event(const input_event& event) {
+    if (event.type != input_event_type::resize) {
+      stamp(event.timestamp);
+    }
+    if constexpr (input_event_processable<parent>) {
+      parent::process_input_event(event);
+    }
+  }
+  // the stamp for the frame being presented, a default time point if no
+  // input arrived since the last one
+  std::chrono::steady_clock::time_point take_input_timestamp() {
+    return std::exchange(m_oldest_input, {});
+  }
+
+private:
+  void stamp(std::chrono::steady_clock::time_point time) {
+    if (m_oldest_input == std::chrono::steady_clock::time_point{}) {
+      m_oldest_input = time;
+    }
+  }
+  std::chrono::steady_clock::time_point m_oldest_input;
+};
+
+// makes up a pointer motion every synthetic_input_every frames, stamped as
+// it is made, and hands it to the layers below the way window system input
+// reaches them. it gives input to photon latency where no seat delivers
+// input, e.g. under weston's headless backend; the stamp is taken on the
+// drawing thread, so time an event spends queued before the frame is not in
+// it
+template <class T> class add_synthetic_input : public T {
+public:
+  using parent = T;
+  add_synthetic_input(const configure auto& conf)
+      : parent{conf}, m_every{get_configured_synthetic_input_every(conf)},
+        m_frame{0} {}
+  void draw() {
+    if (m_every != 0 && m_frame++ % m_every == 0) {
+      // a short stroke, so consecutive events move the pointer
+      auto x = static_cast<int32_t>(100 + m_frame / m_every % 16);
+      int32_t y = 100;
+      if constexpr (input_event_processable<parent>) {
+        parent::process_input_event(input_event{input_event_type::pointer_motion,
+                                                std::chrono::steady_clock::now(), x, y});
+      } else if constexpr (requires { parent::process_pointer_motion_event(0u, 0u); }) {
+        parent::process_pointer_motion_event(x, y);
+      }
+    }
+    parent::draw();
+  }
+
+private:
+  uint32_t m_every;
+  uint64_t m_frame;
+};
+
+template <class T>
+concept input_timestamp_provider = requires(T t) {
+  { t.take_input_timestamp() } -> std::same_as<std::chrono::steady_clock::time_point>;
+};
+
+// measures present latency, the time from presentKHR to the image reaching
+// the display, and input to photon latency, from the input event a frame
+// first reflects to the same point: add_dynamic_draw tags each present with
+// an id and a thread waits for the ids in order with vkWaitForPresentKHR.
+// where the window system tells when a present was shown, as wayland's
+// wp_presentation feedback does through add_frame_pacing, that time is used
+// for both instead, and the present ids only keep the thread busy. the
+// histograms go to add_frame_time_analyser's report. the thread is parked
+// while the swapchain is recreated; without VK_KHR_present_wait or
+// presentation feedback the layer does nothing
+template <class T> class add_present_latency : public T {
+public:
+  using parent = T;
+  add_present_latency(const configure auto& conf)
+      : parent{conf}, m_next_present_id{1}, m_head{0}, m_size{0},
+        m_waiting{false}, m_last_present{}, m_presentation_feedback{false} {
+    if (parent::get_present_wait_supported()) {
+      m_thread = std::jthread{[this](std::stop_token stop) { wait_presents(stop); }};
+    }
+  }
+  // called right before presentKHR, 0 leaves the present untagged
+  uint64_t next_present_id(vk::SwapchainKHR swapchain) {
+    auto input_time = std::chrono::steady_clock::time_point{};
+    if constexpr (input_timestamp_provider<parent>) {
+      input_time = parent::take_input_timestamp();
+    }
+    m_last_present = present_timing{std::chrono::steady_clock::now(), input_time};
+    if (!m_thread.joinable()) {
+      return 0;
+    }
+    {
+      std::lock_guard lock{m_mutex};
+      if (m_size == m_pending.size()) {
+        // the wait thread fell behind, skip this present
+        return 0;
+      }
+      m_pending[(m_head + m_size) % m_pending.size()] =
+          pending_present{m_next_present_id, swapchain, m_last_present};
+      m_size++;
+    }
+    m_wake.notify_one();
+    return m_next_present_id++;
+  }
+  void process_suboptimal_image() {
+    park_wait_thread();
+    parent::process_suboptimal_image();
+  }
+  void recreate_surface() {
+    park_wait_thread();
+    parent::recreate_surface();
+  }
+  // the present the last next_present_id() was called for, on the drawing
+  // thread
+  present_timing get_last_present() { return m_last_present; }
+  // `present` was shown at `time`, from any thread
+  void record_presentation(const present_timing& present,
+                           std::chrono::steady_clock::time_point time) {
+    std::lock_guard lock{m_mutex};
+    m_presentation_feedback = true;
+    m_present_latencies.record(time - present.present_time);
+    if (present.input_time != std::chrono::steady_clock::time_point{}) {
+      m_input_to_photon_latencies.record(time - present.input_time);
+    }
+  }
+  void collect_present_latencies(latency_histogram& present,
+                                 latency_histogram& input_to_photon) {
+    std::lock_guard lock{m_mutex};
+    present = m_present_latencies;
+    input_to_photon = m_input_to_photon_latencies;
+    m_present_latencies.clear();
+    m_input_to_photon_latencies.clear();
+  }
+
+private:
+  static constexpr auto wait_timeout = std::chrono::milliseconds{20};
+  struct pending_present {
+    uint64_t id;
+    vk::SwapchainKHR swapchain;
+    present_timing timing;
+  };
+
+  // drops the pending ids and returns once the thread left
+  // vkWaitForPresentKHR, so the swapchain can be destroyed
+  void park_wait_thread() {
+    std::unique_lock lock{m_mutex};
+    m_size = 0;
+    m_idle.wait(lock, [this] { return !m_waiting; });
+  }
+  void wait_presents(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+      pending_present present;
+      {
+        std::unique_lock lock{m_mutex};
+        if (!m_wake.wait(lock, stop, [this] { return m_size > 0; })) {
+          return;
+        }
+        present = m_pending[m_head];
+        m_waiting = true;
+      }
+      vk::Result result = parent::wait_for_present(
+          present.swapchain, present.id,
+          std::chrono::nanoseconds{wait_timeout}.count());
+      auto now = std::chrono::steady_clock::now();
+      {
+        std::lock_guard lock{m_mutex};
+        m_waiting = false;
+        // park_wait_thread may have dropped it in the meantime
+        bool still_pending = m_size > 0 && m_pending[m_head].id == present.id;
+        if (result != vk::Result::eTimeout && still_pending) {
+          m_head = (m_head + 1) % m_pending.size();
+          m_size--;
+        }
+        // presentation feedback is closer to the display, and one source
+        // keeps the histograms comparable
+        if (result == vk::Result::eSuccess && still_pending && !m_presentation_feedback) {
+          m_present_latencies.record(now - present.timing.present_time);
+          if (present.timing.input_time != std::chrono::steady_clock::time_point{}) {
+            m_input_to_photon_latencies.record(now - present.timing.input_time);
+          }
+        }
+      }
+      m_idle.notify_all();
+    }
+  }
+
+  uint64_t m_next_present_id;
+  std::array<pending_present, 16> m_pending;
+  uint32_t m_head;
+  uint32_t m_size;
+  bool m_waiting;
+  present_timing m_last_present;
+  bool m_presentation_feedback;
+  latency_histogram m_present_latencies;
+  latency_histogram m_input_to_photon_latencies;
+  std::mutex m_mutex;
+  std::condition_variable_any m_wake;
+  std::condition_variable_any m_idle;
+  // joined first, before the state it uses is destroyed
+  std::jthread m_thread;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <span>
+#include <vector>
+
+#include "vulkan_start.hpp"
+
+namespace vulkan_start {
+
+// a procedural generator describes geometry by a parameters type and
+//   static uint32_t get_point_count(const parameters&);
+//   static void generate(const parameters&, std::span<std::array<float, 4>>);
+// points are vec4 so the buffer matches a std430 vec4[] in the shaders
+template <class G>
+concept procedural_generator = requires(const typename G::parameters& p,
+                                        std::span<std::array<float, 4>> points) {
+    { G::get_point_count(p) } -> std::convertible_to<uint32_t>;
+    G::generate(p, points);
+    { p == p } -> std::convertible_to<bool>;
+};
+
+// helix sampled in segments, the curve of shaders/mesh.glsl; segment
+// count and samples per segment are fixed by the task and mesh shaders
+struct helix_generator {
+    static constexpr uint32_t segment_count = 16;
+    static constexpr uint32_t samples_per_segment = 128;
+    struct parameters {
+        float radius = 1.0f;
+        float segment_width = 10.0f;
+        bool operator==(const parameters&) const = default;
+    };
+    static uint32_t get_point_count(const parameters&) {
+        return segment_count * (samples_per_segment + 1);
+    }
+    static void generate(const parameters& p, std::span<std::array<float, 4>> points) {
+        for (uint32_t segment = 0; segment < segment_count; segment++) {
+            // segments alternate around 0: 0, 1, -1, 2, -2, ...
+            int sign = (segment % 2 == 1) ? 1 : -1;
+            int offset = sign * static_cast<int>((segment + 1) / 2);
+            float t_start = p.segment_width * offset;
+            for (uint32_t i = 0; i < samples_per_segment + 1; i++) {
+                float t = t_start + i * p.segment_width / samples_per_segment;
+                points[segment * (samples_per_segment + 1) + i] =
+                    {p.radius * std::cos(t), p.radius * std::sin(t), t, 1.0f};
+            }
+        }
+    }
+};
+
+// keeps the points of a procedural generator in a device local storage
+// buffer and regenerates them only when the parameters change, so the
+// per frame shaders only apply the transform
+template <procedural_generator G, uint32_t BINDING, class T>
+class add_procedural_geometry : public T {
+public:
+  using parent = T;
+  using parameters = typename G::parameters;
+  add_procedural_geometry(const configure auto& conf)
+      : parent{conf}, m_parameters{}, m_dirty{false}, m_point_count{0} {
+    create();
+  }
+  ~add_procedural_geometry() { destroy(); }
+  void create() {
+    vk::Device device = parent::get_device();
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    m_point_count = G::get_point_count(m_parameters);
+    vk::DeviceSize size = sizeof(std::array<float, 4>) * m_point_count;
+    m_buffer = device.createBuffer(
+        vk::BufferCreateInfo{}
+            .setSize(size)
+            .setUsage(vk::BufferUsageFlagBits::eStorageBuffer |
+                      vk::BufferUsageFlagBits::eTransferDst));
+    auto requirements = device.getBufferMemoryRequirements(m_buffer);
+    m_memory = device.allocateMemory(
+        vk::MemoryAllocateInfo{}
+            .setAllocationSize(requirements.size)
+            .setMemoryTypeIndex(find_memory_type_index(
+                physical_device, requirements.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eDeviceLocal)));
+    device.bindBufferMemory(m_buffer, m_memory, 0);
+    generate();
+    write_descriptor_sets();
+  }
+  void destroy() {
+    vk::Device device = parent::get_device();
+    device.destroyBuffer(m_buffer);
+    device.freeMemory(m_memory);
+  }
+  void set_procedural_geometry_parameters(const parameters& p) {
+    if (p != m_parameters) {
+      m_parameters = p;
+      m_dirty = true;
+    }
+  }
+  auto get_procedural_geometry_parameters() { return m_parameters; }
+  // called once per frame, does nothing unless the parameters changed
+  void update_procedural_geometry() {
+    if (!m_dirty) {
+      return;
+    }
+    m_dirty = false;
+    vk::Queue queue = parent::get_queue();
+    queue.waitIdle();
+    // a new size would need a new buffer, rewriting the descriptor sets
+    // the prerecorded command buffers use
+    if (G::get_point_count(m_parameters) != m_point_count) {
+      throw std::runtime_error{"procedural geometry point count changed"};
+    }
+    generate();
+  }
+  auto get_procedural_geometry_buffer() { return m_buffer; }
+
+private:
+  void generate() {
+    vk::Device device = parent::get_device();
+    vk::PhysicalDevice physical_device = parent::get_physical_device();
+    vk::DeviceSize size = sizeof(std::array<float, 4>) * m_point_count;
+    vk::Buffer staging = device.createBuffer(
+        vk::BufferCreateInfo{}
+            .setSize(size)
+            .setUsage(vk::BufferUsageFlagBits::eTransferSrc));
+    auto requirements = device.getBufferMemoryRequirements(staging);
+    vk::DeviceMemory staging_memory = device.allocateMemory(
+        vk::MemoryAllocateInfo{}
+            .setAllocationSize(requirements.size)
+            .setMemoryTypeIndex(find_memory_type_index(
+                physical_device, requirements.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eHostVisible |
+                    vk::MemoryPropertyFlagBits::eHostCoherent)));
+    device.bindBufferMemory(staging, staging_memory, 0);
+    void* ptr = device.mapMemory(staging_memory, 0, size);
+    G::generate(m_parameters,
+                std::span{reinterpret_cast<std::array<float, 4>*>(ptr), m_point_count});
+    device.unmapMemory(staging_memory);
+
+    water_chika_vulkan_submit_once(
+        device, parent::get_queue(), parent::get_command_pool(),
+        [this, staging, size](vk::CommandBuffer cmd) {
+          cmd.copyBuffer(staging, m_buffer, vk::BufferCopy{}.setSize(size));
+          auto barrier = vk::MemoryBarrier{}
+                             .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                             .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+          cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                              vk::PipelineStageFlagBits::eAllCommands, {},
+                              barrier, {}, {});
+        });
+    device.destroyBuffer(staging);
+    device.freeMemory(staging_memory);
+  }
+  void write_descriptor_sets() {
+    vk::Device device = parent::get_device();
+    std::vector<vk::DescriptorSet> sets = parent::get_descriptor_set();
+    auto buffer_info =
+        vk::DescriptorBufferInfo{}.setBuffer(m_buffer).setRange(vk::WholeSize);
+    std::vector<vk::WriteDescriptorSet> writes(sets.size());
+    for (uint32_t i = 0; i < sets.size(); i++) {
+      writes[i] = vk::WriteDescriptorSet{}
+                      .setDstSet(sets[i])
+                      .setDstBinding(BINDING)
+                      .setDescriptorCount(1)
+                      .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                      .setBufferInfo(buffer_info);
+    }
+    device.updateDescriptorSets(writes, {});
+  }
+
+  parameters m_parameters;
+  bool m_dirty;
+  uint32_t m_point_count;
+  vk::Buffer m_buffer;
+  vk::DeviceMemory m_memory;
+};
+
+template <class T> class add_procedural_geometry_update : public T {
+public:
+  using parent = T;
+  void upload_frame_data(uint32_t index) {
+    parent::update_procedural_geometry();
+    parent::upload_frame_data(index);
+  }
+};
+
+} // namespace vulkan_start
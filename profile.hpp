@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <vulkan_helper.hpp>
+
+namespace vulkan_start {
+
+using namespace vulkan_hpp_helper;
+
+// qualified name of T with every template argument list dropped, so a layer
+// is named without the rest of the stack, e.g.
+// vulkan_start::use_app::add_resources_and_draw
+template <class T> std::string get_layer_name() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    std::string_view signature = __FUNCSIG__;
+    auto first = signature.find("get_layer_name<") + std::string_view{"get_layer_name<"}.size();
+    auto last = signature.rfind(">(void)");
+#else
+    std::string_view signature = __PRETTY_FUNCTION__;
+    auto first = signature.find("T = ") + std::string_view{"T = "}.size();
+    auto last = std::min(signature.find(';', first), signature.rfind(']'));
+#endif
+    std::string_view type = signature.substr(first, last - first);
+    for (std::string_view keyword : {"class ", "struct "}) {
+        if (type.starts_with(keyword)) {
+            type.remove_prefix(keyword.size());
+        }
+    }
+    std::string name;
+    int depth = 0;
+    for (char c : type) {
+        if (c == '<') {
+            depth++;
+        } else if (c == '>') {
+            depth--;
+        } else if (depth == 0) {
+            name += c;
+        }
+    }
+    return name;
+}
+
+// collects the timed layer scopes of the process and writes them as a tree
+// to startup_profile.json when it exits. scopes nest per thread: a layer
+// constructed or recreated while another one's scope is open is its child
+class startup_profile {
+public:
+    static startup_profile& get() {
+        static startup_profile profile;
+        return profile;
+    }
+    void begin(std::string name) {
+        open_scopes().push_back(open_scope{std::move(name), std::chrono::steady_clock::now()});
+    }
+    void end(const char* phase) {
+        auto& scopes = open_scopes();
+        auto open = std::move(scopes.back());
+        scopes.pop_back();
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard lock{m_mutex};
+        m_scopes.push_back(scope{std::move(open.name), phase, open.start, now,
+                                 static_cast<uint32_t>(scopes.size())});
+    }
+    // the innermost layer this thread is constructing or recreating, empty
+    // outside of any scope
+    static std::string_view current_layer() {
+        auto& scopes = open_scopes();
+        return scopes.empty() ? std::string_view{} : std::string_view{scopes.back().name};
+    }
+    ~startup_profile() {
+        try {
+            write("startup_profile.json");
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+private:
+    struct scope {
+        std::string name;
+        const char* phase;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point end;
+        uint32_t depth;
+    };
+    struct open_scope {
+        std::string name;
+        std::chrono::steady_clock::time_point start;
+    };
+    static std::vector<open_scope>& open_scopes() {
+        thread_local std::vector<open_scope> scopes;
+        return scopes;
+    }
+    void write(const char* path) {
+        std::lock_guard lock{m_mutex};
+        if (m_scopes.empty()) {
+            return;
+        }
+        // outer scopes first, they end after the ones they contain
+        std::ranges::sort(m_scopes, [](const scope& a, const scope& b) {
+            return a.start != b.start ? a.start < b.start : a.depth < b.depth;
+        });
+        std::ofstream json{path};
+        if (!json) {
+            throw std::runtime_error{std::string{"failed to open "} + path};
+        }
+        json << "{";
+        const char* separator = "";
+        for (const char* phase : {"construct", "recreate_surface"}) {
+            json << separator << "\n  \"" << phase << "\": [";
+            size_t index = 0;
+            write_children(json, phase, index, 0, 2);
+            json << "\n  ]";
+            separator = ",";
+        }
+        json << "\n}\n";
+        std::clog << "wrote " << path << std::endl;
+    }
+    // writes the scopes of `phase` at `depth` from m_scopes[index] on, until
+    // one of a lower depth, and returns their total time
+    std::chrono::nanoseconds write_children(std::ofstream& json, const char* phase,
+                                            size_t& index, uint32_t depth, int indent) {
+        auto ms = [](std::chrono::nanoseconds t) { return t.count() / 1000000.0; };
+        std::chrono::nanoseconds total{};
+        const char* separator = "";
+        while (index < m_scopes.size()) {
+            const scope& s = m_scopes[index];
+            if (std::string_view{s.phase} != phase) {
+                index++;
+                continue;
+            }
+            if (s.depth < depth) {
+                break;
+            }
+            index++;
+            auto time = std::chrono::nanoseconds{s.end - s.start};
+            total += time;
+            std::string pad(2 * indent, ' ');
+            json << separator << "\n" << pad << "{\"name\": \"" << s.name
+                 << "\", \"total_ms\": " << ms(time) << ", \"children\": [";
+            auto children = write_children(json, phase, index, s.depth + 1, indent + 1);
+            json << (children.count() ? "\n" + pad : "") << "], \"self_ms\": "
+                 << ms(time - children) << "}";
+            separator = ",";
+        }
+        return total;
+    }
+
+    std::mutex m_mutex;
+    std::vector<scope> m_scopes;
+};
+
+// stamps the start of the layer built on P, after P is constructed. N is
+// the layer on the unprofiled P, only its name is used
+template <class P, class N> class profile_begin : public P {
+public:
+    using parent = P;
+    profile_begin(const configure auto& conf) : parent{conf} {
+        startup_profile::get().begin(get_layer_name<N>());
+    }
+};
+
+template <class L>
+concept defines_recreate_surface = requires {
+    { &L::recreate_surface } -> std::same_as<void (L::*)()>;
+};
+
+// ends the scope of layer L when its constructor returned, and times its
+// recreate_surface() if L defines one
+template <class L, bool = defines_recreate_surface<L>> class profile_end : public L {
+public:
+    using parent = L;
+    profile_end(const configure auto& conf) : parent{conf} {
+        startup_profile::get().end("construct");
+    }
+};
+template <class L> class profile_end<L, true> : public L {
+public:
+    using parent = L;
+    profile_end(const configure auto& conf) : parent{conf} {
+        startup_profile::get().end("construct");
+    }
+    void recreate_surface() {
+        startup_profile::get().begin(get_layer_name<L>());
+        parent::recreate_surface();
+        startup_profile::get().end("recreate_surface");
+    }
+};
+
+// rebuilds a stack with every layer between profile_begin and profile_end.
+// a layer is a template whose last argument is its parent; other types, and
+// stacks that are profiled already, are left as they are. a layer that
+// derives from a stack written out in its body, like the cube app's
+// add_resources_and_draw, is timed as one and profiles its own stack
+template <class T> struct add_layer_profiling {
+    using type = T;
+};
+template <class P, class N> struct add_layer_profiling<profile_begin<P, N>> {
+    using type = profile_begin<P, N>;
+};
+template <class L, bool B> struct add_layer_profiling<profile_end<L, B>> {
+    using type = profile_end<L, B>;
+};
+template <template <class> class L, class P>
+struct add_layer_profiling<L<P>> {
+    using type = profile_end<L<profile_begin<typename add_layer_profiling<P>::type, L<P>>>>;
+};
+template <template <auto, class> class L, auto V, class P>
+struct add_layer_profiling<L<V, P>> {
+    using type = profile_end<L<V, profile_begin<typename add_layer_profiling<P>::type, L<V, P>>>>;
+};
+template <template <class, class> class L, class A, class P>
+struct add_layer_profiling<L<A, P>> {
+    using type = profile_end<L<A, profile_begin<typename add_layer_profiling<P>::type, L<A, P>>>>;
+};
+template <template <class, auto, class> class L, class A, auto V, class P>
+struct add_layer_profiling<L<A, V, P>> {
+    using type = profile_end<L<A, V, profile_begin<typename add_layer_profiling<P>::type, L<A, V, P>>>>;
+};
+template <template <auto, auto, class> class L, auto V, auto W, class P>
+struct add_layer_profiling<L<V, W, P>> {
+    using type = profile_end<L<V, W, profile_begin<typename add_layer_profiling<P>::type, L<V, W, P>>>>;
+};
+
+// a stack as written, or with its layers timed when built with
+// VULKAN_START_PROFILE_STARTUP
+#ifdef VULKAN_START_PROFILE_STARTUP
+template <class T> using profiled = typename add_layer_profiling<T>::type;
+#else
+template <class T> using profiled = T;
+#endif
+
+} // namespace vulkan_start
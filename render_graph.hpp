@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan_helper.hpp>
+
+#include "vulkan_start.hpp"
+
+namespace vulkan_start {
+
+// how a pass uses a resource, in synchronization2 stages and accesses. the
+// layout is the one a pass needs an image in, buffers leave it undefined
+struct resource_use {
+    vk::PipelineStageFlags2 stages;
+    vk::AccessFlags2 access;
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+};
+
+inline constexpr auto copy_destination =
+    resource_use{vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite};
+inline constexpr auto vertex_shader_uniform_read =
+    resource_use{vk::PipelineStageFlagBits2::eVertexShader, vk::AccessFlagBits2::eUniformRead};
+inline constexpr auto mesh_shader_uniform_read =
+    resource_use{vk::PipelineStageFlagBits2::eTaskShaderEXT |
+                     vk::PipelineStageFlagBits2::eMeshShaderEXT,
+                 vk::AccessFlagBits2::eUniformRead};
+inline constexpr auto depth_attachment_read_write =
+    resource_use{vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                     vk::PipelineStageFlagBits2::eLateFragmentTests,
+                 vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                     vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                 vk::ImageLayout::eDepthStencilAttachmentOptimal};
+
+inline constexpr vk::AccessFlags2 write_access =
+    vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+    vk::AccessFlagBits2::eColorAttachmentWrite |
+    vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eTransferWrite |
+    vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+// stages of a synchronization2 mask for vkCmdPipelineBarrier, the split
+// stages become the one they were split from. `none` stands for an empty
+// mask, which the old barrier doesn't take
+inline vk::PipelineStageFlags to_pipeline_stage_flags(vk::PipelineStageFlags2 stages,
+                                                      vk::PipelineStageFlagBits none) {
+    using stage = vk::PipelineStageFlagBits2;
+    if (stages & (stage::eCopy | stage::eResolve | stage::eBlit | stage::eClear)) {
+        stages |= stage::eTransfer;
+    }
+    if (stages & (stage::eIndexInput | stage::eVertexAttributeInput)) {
+        stages |= stage::eVertexInput;
+    }
+    if (stages & stage::ePreRasterizationShaders) {
+        stages |= stage::eVertexShader | stage::eTessellationControlShader |
+                  stage::eTessellationEvaluationShader | stage::eGeometryShader;
+    }
+    auto flags = vk::PipelineStageFlags{
+        static_cast<VkPipelineStageFlags>(static_cast<VkPipelineStageFlags2>(stages))};
+    return flags ? flags : vk::PipelineStageFlags{none};
+}
+inline vk::AccessFlags to_access_flags(vk::AccessFlags2 access) {
+    using flag = vk::AccessFlagBits2;
+    if (access & (flag::eShaderSampledRead | flag::eShaderStorageRead)) {
+        access |= flag::eShaderRead;
+    }
+    if (access & flag::eShaderStorageWrite) {
+        access |= flag::eShaderWrite;
+    }
+    return vk::AccessFlags{static_cast<VkAccessFlags>(static_cast<VkAccessFlags2>(access))};
+}
+
+// the vkCmdPipelineBarrier2KHR of a stack's device, null when it has none
+template <class T> PFN_vkCmdPipelineBarrier2KHR find_pipeline_barrier2(T* stack) {
+    if constexpr (requires { stack->get_vk_cmd_pipeline_barrier2(); }) {
+        return stack->get_vk_cmd_pipeline_barrier2();
+    } else {
+        return nullptr;
+    }
+}
+
+// passes in submission order, each declaring the buffers and images it
+// reads and writes. compile() derives the barriers: one barrier call before
+// each pass that needs one, with only the stages and accesses of the last
+// writer and the readers since. a read waits for a write once, later reads
+// in stages it was made visible to don't
+class render_graph {
+public:
+    using resource = uint32_t;
+
+    // a buffer made outside of the graph, `last_use` is what happened to it
+    // before the first pass; the default is nothing to wait for
+    resource import_buffer(vk::Buffer buffer, resource_use last_use = {}) {
+        m_resources.push_back(resource_state{.buffer = buffer});
+        set_last_use(m_resources.back(), last_use);
+        return m_resources.size() - 1;
+    }
+    resource import_image(vk::Image image, vk::ImageSubresourceRange range,
+                          resource_use last_use = {}) {
+        m_resources.push_back(resource_state{.image = image, .range = range});
+        set_last_use(m_resources.back(), last_use);
+        return m_resources.size() - 1;
+    }
+    // a resource used twice by one pass is used once in both ways, which
+    // needs a single layout
+    void add_pass(std::string name, std::vector<std::pair<resource, resource_use>> uses,
+                  std::function<void(vk::CommandBuffer)> record) {
+        std::vector<std::pair<resource, resource_use>> merged;
+        for (auto& [r, use] : uses) {
+            auto same = std::ranges::find(merged, r, &std::pair<resource, resource_use>::first);
+            if (same == merged.end()) {
+                merged.emplace_back(r, use);
+                continue;
+            }
+            if (same->second.layout != use.layout) {
+                throw std::runtime_error{"pass " + name + " uses an image in two layouts"};
+            }
+            same->second.stages |= use.stages;
+            same->second.access |= use.access;
+        }
+        m_passes.push_back(
+            graph_pass{std::move(name), std::move(merged), std::move(record), {}, {}});
+    }
+    void compile() {
+        for (auto& pass : m_passes) {
+            for (auto& [r, use] : pass.uses) {
+                add_barrier(pass, r, use);
+            }
+        }
+    }
+    // without synchronization2 the barriers go through vkCmdPipelineBarrier,
+    // with the stages of all barriers of a pass merged
+    void execute(vk::CommandBuffer cmd, PFN_vkCmdPipelineBarrier2KHR pipeline_barrier2) {
+        for (auto& pass : m_passes) {
+            if (!pass.image_barriers.empty() || !pass.buffer_barriers.empty()) {
+                if (pipeline_barrier2) {
+                    auto dependency_info = vk::DependencyInfo{}
+                                               .setImageMemoryBarriers(pass.image_barriers)
+                                               .setBufferMemoryBarriers(pass.buffer_barriers);
+                    pipeline_barrier2(cmd, &static_cast<const VkDependencyInfo&>(dependency_info));
+                } else {
+                    pipeline_barrier(cmd, pass);
+                }
+            }
+            if (pass.record) {
+                pass.record(cmd);
+            }
+        }
+    }
+
+private:
+    struct resource_state {
+        vk::Buffer buffer;
+        vk::Image image;
+        vk::ImageSubresourceRange range;
+        // the last write, and the reads since, that the next write waits for
+        vk::PipelineStageFlags2 write_stages;
+        vk::AccessFlags2 write_access;
+        vk::PipelineStageFlags2 read_stages;
+        // where the last write is visible already
+        vk::PipelineStageFlags2 visible_stages;
+        vk::AccessFlags2 visible_access;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+    struct graph_pass {
+        std::string name;
+        std::vector<std::pair<resource, resource_use>> uses;
+        std::function<void(vk::CommandBuffer)> record;
+        std::vector<vk::ImageMemoryBarrier2> image_barriers;
+        std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+    };
+
+    static void set_last_use(resource_state& state, resource_use use) {
+        bool writes = static_cast<bool>(use.access & write_access);
+        state.write_stages = writes ? use.stages : vk::PipelineStageFlags2{};
+        state.write_access = use.access & write_access;
+        state.read_stages = writes ? vk::PipelineStageFlags2{} : use.stages;
+        state.layout = use.layout;
+    }
+    void add_barrier(graph_pass& pass, resource r, resource_use use) {
+        auto& state = m_resources[r];
+        bool is_image = static_cast<bool>(state.image);
+        bool transition = is_image && use.layout != state.layout;
+        auto src_stages = state.write_stages;
+        auto src_access = state.write_access;
+        if (use.access & write_access || transition) {
+            // waits for every use since the last write, reads need no
+            // availability
+            src_stages |= state.read_stages;
+            state.write_stages = use.stages;
+            state.write_access = use.access & write_access;
+            state.read_stages = {};
+            state.visible_stages = {};
+            state.visible_access = {};
+            if (!src_stages && !transition) {
+                return;
+            }
+        } else {
+            state.read_stages |= use.stages;
+            if (!state.write_access || (!(use.stages & ~state.visible_stages) &&
+                                        !(use.access & ~state.visible_access))) {
+                return;
+            }
+            state.visible_stages |= use.stages;
+            state.visible_access |= use.access;
+        }
+        if (is_image) {
+            pass.image_barriers.push_back(vk::ImageMemoryBarrier2{}
+                                              .setSrcStageMask(src_stages)
+                                              .setSrcAccessMask(src_access)
+                                              .setDstStageMask(use.stages)
+                                              .setDstAccessMask(use.access)
+                                              .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                              .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                              .setOldLayout(state.layout)
+                                              .setNewLayout(use.layout)
+                                              .setImage(state.image)
+                                              .setSubresourceRange(state.range));
+            state.layout = use.layout;
+        } else {
+            pass.buffer_barriers.push_back(vk::BufferMemoryBarrier2{}
+                                               .setSrcStageMask(src_stages)
+                                               .setSrcAccessMask(src_access)
+                                               .setDstStageMask(use.stages)
+                                               .setDstAccessMask(use.access)
+                                               .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                               .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                               .setBuffer(state.buffer)
+                                               .setSize(vk::WholeSize));
+        }
+    }
+    void pipeline_barrier(vk::CommandBuffer cmd, const graph_pass& pass) {
+        vk::PipelineStageFlags2 src_stages;
+        vk::PipelineStageFlags2 dst_stages;
+        std::vector<vk::ImageMemoryBarrier> image_barriers;
+        std::vector<vk::BufferMemoryBarrier> buffer_barriers;
+        for (auto& b : pass.image_barriers) {
+            src_stages |= b.srcStageMask;
+            dst_stages |= b.dstStageMask;
+            image_barriers.push_back(vk::ImageMemoryBarrier{}
+                                         .setSrcAccessMask(to_access_flags(b.srcAccessMask))
+                                         .setDstAccessMask(to_access_flags(b.dstAccessMask))
+                                         .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                         .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                         .setOldLayout(b.oldLayout)
+                                         .setNewLayout(b.newLayout)
+                                         .setImage(b.image)
+                                         .setSubresourceRange(b.subresourceRange));
+        }
+        for (auto& b : pass.buffer_barriers) {
+            src_stages |= b.srcStageMask;
+            dst_stages |= b.dstStageMask;
+            buffer_barriers.push_back(vk::BufferMemoryBarrier{}
+                                          .setSrcAccessMask(to_access_flags(b.srcAccessMask))
+                                          .setDstAccessMask(to_access_flags(b.dstAccessMask))
+                                          .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                          .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                          .setBuffer(b.buffer)
+                                          .setSize(b.size));
+        }
+        cmd.pipelineBarrier(
+            to_pipeline_stage_flags(src_stages, vk::PipelineStageFlagBits::eTopOfPipe),
+            to_pipeline_stage_flags(dst_stages, vk::PipelineStageFlagBits::eBottomOfPipe), {}, {},
+            buffer_barriers, image_barriers);
+    }
+
+    std::vector<resource_state> m_resources;
+    std::vector<graph_pass> m_passes;
+};
+
+} // namespace vulkan_start
@@ -0,0 +1,19 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location=0) in vec3 vertex;
+layout(location=0) out vec3 color;
+
+// every storage buffer of the app, the push constant picks the frame's
+// object buffer and the draw's first instance the object in it
+layout(std430, binding=0) readonly buffer Objects{
+    mat4 transform[];
+} objects[];
+
+layout(push_constant) uniform Constants{
+    uint object_buffer;
+} constants;
+void main() {
+    gl_Position = objects[constants.object_buffer].transform[gl_InstanceIndex] * vec4(vertex, 1);
+    color = (vertex+1)/2;
+}
@@ -0,0 +1,12 @@
+#version 460
+
+layout(location=0) in vec3 vertex;
+layout(location=0) out vec3 color;
+
+layout(std430, binding=0) readonly buffer Objects{
+    mat4 transform[];
+} objects;
+void main() {
+    gl_Position = objects.transform[gl_InstanceIndex] * vec4(vertex, 1);
+    color = (vertex+1)/2;
+}
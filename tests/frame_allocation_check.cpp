@@ -0,0 +1,90 @@
+// built with VULKAN_START_COUNT_ALLOCATIONS: a frame that allocates after
+// the warm-up must throw, allocations of other threads during a frame must
+// not
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "allocation_check.hpp"
+
+using namespace vulkan_start;
+
+struct test_configure : empty_configure {
+    // frame that allocates on the drawing thread, none if past the run
+    uint64_t allocating_frame = UINT64_MAX;
+};
+
+// stands in for the app below the check. a thread of its own allocates all
+// the time, and every frame waits until it allocated at least once
+class fake_frames {
+public:
+    fake_frames(const test_configure& conf)
+        : m_allocating_frame{conf.allocating_frame}, m_frame{0},
+          m_background_allocations{0},
+          m_thread{[this](std::stop_token stop) {
+              while (!stop.stop_requested()) {
+                  m_background_allocation = std::make_unique<uint64_t>(0);
+                  m_background_allocations.fetch_add(1, std::memory_order_release);
+              }
+          }} {}
+    void draw() {
+        uint64_t seen = m_background_allocations.load(std::memory_order_acquire);
+        while (m_background_allocations.load(std::memory_order_acquire) == seen) {
+            std::this_thread::yield();
+        }
+        if (m_frame == m_allocating_frame) {
+            m_allocation = std::make_unique<uint64_t>(m_frame);
+        }
+        m_frame++;
+    }
+    vk::SwapchainKHR get_swapchain() { return {}; }
+
+private:
+    uint64_t m_allocating_frame;
+    uint64_t m_frame;
+    std::unique_ptr<uint64_t> m_allocation;
+    std::unique_ptr<uint64_t> m_background_allocation;
+    std::atomic<uint64_t> m_background_allocations;
+    std::jthread m_thread;
+};
+
+using checked_frames = add_frame_allocation_check<fake_frames>;
+
+// frame whose check threw, UINT64_MAX if none of `count` frames did
+uint64_t draw_frames(uint64_t allocating_frame, uint64_t count) {
+    auto conf = test_configure{};
+    conf.allocating_frame = allocating_frame;
+    checked_frames frames{conf};
+    for (uint64_t i = 0; i < count; i++) {
+        try {
+            frames.draw();
+        } catch (std::runtime_error& e) {
+            std::clog << e.what() << std::endl;
+            return i;
+        }
+    }
+    return UINT64_MAX;
+}
+
+int main() {
+    constexpr uint64_t frame_count = 64;
+    constexpr uint64_t warmup = checked_frames::warmup;
+    int result = 0;
+    if (draw_frames(UINT64_MAX, frame_count) != UINT64_MAX) {
+        std::cerr << "other threads' allocations failed the check" << std::endl;
+        result = 1;
+    }
+    if (draw_frames(warmup - 1, frame_count) != UINT64_MAX) {
+        std::cerr << "an allocation during the warm-up failed the check" << std::endl;
+        result = 1;
+    }
+    if (draw_frames(warmup + 8, frame_count) != warmup + 8) {
+        std::cerr << "an allocation after the warm-up passed the check" << std::endl;
+        result = 1;
+    }
+    return result;
+}
@@ -0,0 +1,107 @@
+// every index of a parallel_for runs exactly once, also with nested loops
+// and an lvalue function, and tasks start only after the ones they wait for
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "job_system.hpp"
+
+using namespace vulkan_start;
+
+// runs of each index of a `count` element loop in chunks of `grain`
+bool check_parallel_for(job_system& jobs, uint32_t count, uint32_t grain) {
+    auto runs = std::make_unique<std::atomic<uint32_t>[]>(count);
+    auto function = [&runs](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            runs[i].fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    jobs.parallel_for(count, grain, function);
+    for (uint32_t i = 0; i < count; i++) {
+        if (runs[i].load() != 1) {
+            std::cerr << "index " << i << " of " << count << " in chunks of " << grain
+                      << " ran " << runs[i].load() << " times" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_nested_parallel_for(job_system& jobs) {
+    constexpr uint32_t outer = 64;
+    constexpr uint32_t inner = 256;
+    std::vector<std::atomic<uint32_t>> runs(outer * inner);
+    jobs.parallel_for(outer, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t o = begin; o < end; o++) {
+            jobs.parallel_for(inner, 16, [&](uint32_t inner_begin, uint32_t inner_end) {
+                for (uint32_t i = inner_begin; i < inner_end; i++) {
+                    runs[o * inner + i].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+    });
+    for (auto& r : runs) {
+        if (r.load() != 1) {
+            std::cerr << "a nested parallel_for index ran " << r.load() << " times" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// a -> b, a -> c, b and c -> d: each task records its place in the order
+bool check_task_order(job_system& jobs) {
+    std::atomic<uint32_t> next{0};
+    uint32_t a_place = 0, b_place = 0, c_place = 0, d_place = 0;
+    job_system::task a{[&] { a_place = next++; }};
+    job_system::task b{[&] { b_place = next++; }};
+    job_system::task c{[&] { c_place = next++; }};
+    job_system::task d{[&] { d_place = next++; }};
+    a.then(b);
+    a.then(c);
+    b.then(d);
+    c.then(d);
+    // submitted last first, each only starts once released
+    jobs.submit(d);
+    jobs.submit(c);
+    jobs.submit(b);
+    if (b.is_done() || c.is_done() || d.is_done()) {
+        std::cerr << "a task ran before the task it waits for was submitted" << std::endl;
+        return false;
+    }
+    jobs.submit(a);
+    jobs.wait(d);
+    if (!(a_place < b_place && a_place < c_place && b_place < d_place && c_place < d_place)) {
+        std::cerr << "tasks ran out of order: a " << a_place << " b " << b_place << " c "
+                  << c_place << " d " << d_place << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    int result = 0;
+    for (uint32_t thread_count : {1u, 4u}) {
+        job_system jobs{thread_count};
+        for (uint32_t count : {0u, 1u, 7u, 1000u, 100000u}) {
+            for (uint32_t grain : {1u, 3u, 64u, 200000u}) {
+                if (!check_parallel_for(jobs, count, grain)) {
+                    result = 1;
+                }
+            }
+        }
+        if (!check_nested_parallel_for(jobs)) {
+            result = 1;
+        }
+        for (uint32_t i = 0; i < 100; i++) {
+            if (!check_task_order(jobs)) {
+                result = 1;
+                break;
+            }
+        }
+    }
+    return result;
+}
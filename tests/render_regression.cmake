@@ -0,0 +1,48 @@
+# runs one demo headless for FRAMES fixed step frames, compares its last
+# frame with tests/reference/<app>.ppm and the cpu times it logged with
+# tests/reference/<app>_timings.txt. run by ctest with cmake -P, the paths
+# and settings come in as -D definitions; with UPDATE the run's frame and
+# times become the new reference instead. a missing reference fails
+set(reference ${REFERENCE_DIR}/${APP}.ppm)
+set(baseline ${REFERENCE_DIR}/${APP}_timings.txt)
+if(NOT UPDATE AND (NOT EXISTS ${reference} OR NOT EXISTS ${baseline}))
+  message(FATAL_ERROR "no reference for ${APP} in ${REFERENCE_DIR}, build the "
+                      "update_references target on the ci image and check it in")
+endif()
+
+# the first and the last frame are captured, the last one is _000001
+math(EXPR capture_every "${FRAMES} - 1")
+file(REMOVE ${APP}_000001.ppm)
+execute_process(
+  COMMAND ${DEMO} ${APP} --headless --fixed-step=60 --frames=${FRAMES}
+          --capture=${APP}_ --capture-format=ppm --capture-every=${capture_every}
+  ERROR_FILE ${APP}.log
+  RESULT_VARIABLE result)
+file(READ ${APP}.log log)
+message("${log}")
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${APP} failed: ${result}")
+endif()
+
+if(UPDATE)
+  file(MAKE_DIRECTORY ${REFERENCE_DIR})
+  configure_file(${APP}_000001.ppm ${reference} COPYONLY)
+  execute_process(COMMAND ${CHECK_TIMINGS} ${baseline} ${APP}.log --update
+                  RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed to write ${baseline}")
+  endif()
+  return()
+endif()
+
+execute_process(COMMAND ${COMPARE_IMAGES} ${reference} ${APP}_000001.ppm
+                        --tolerance=${TOLERANCE}
+                RESULT_VARIABLE image_result)
+execute_process(COMMAND ${CHECK_TIMINGS} ${baseline} ${APP}.log --threshold=${THRESHOLD}
+                RESULT_VARIABLE timing_result)
+if(NOT image_result EQUAL 0)
+  message(FATAL_ERROR "${APP} renders differently from ${reference}")
+endif()
+if(NOT timing_result EQUAL 0)
+  message(FATAL_ERROR "${APP} is slower than ${baseline}")
+endif()
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace vulkan_start {
+
+// column-major, same memory layout as a GLSL mat4 in a std140 uniform block
+struct alignas(16) mat4 {
+    std::array<float, 16> m;
+
+    static constexpr mat4 identity() {
+        return mat4{{1, 0, 0, 0,
+                     0, 1, 0, 0,
+                     0, 0, 1, 0,
+                     0, 0, 0, 1}};
+    }
+    constexpr float& at(int column, int row) { return m[column * 4 + row]; }
+    constexpr float at(int column, int row) const { return m[column * 4 + row]; }
+};
+
+inline mat4 operator*(const mat4& a, const mat4& b) {
+    mat4 res{};
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            float sum = 0;
+            for (int k = 0; k < 4; k++) {
+                sum += a.at(k, r) * b.at(c, k);
+            }
+            res.at(c, r) = sum;
+        }
+    }
+    return res;
+}
+
+inline mat4 make_translation(float x, float y, float z) {
+    auto res = mat4::identity();
+    res.at(3, 0) = x;
+    res.at(3, 1) = y;
+    res.at(3, 2) = z;
+    return res;
+}
+
+inline mat4 make_scale(float x, float y, float z) {
+    auto res = mat4::identity();
+    res.at(0, 0) = x;
+    res.at(1, 1) = y;
+    res.at(2, 2) = z;
+    return res;
+}
+
+// w = z + 1, the projection the cube and mesh shaders used to build
+inline mat4 make_simple_perspective() {
+    auto res = mat4::identity();
+    res.at(2, 3) = 1;
+    return res;
+}
+
+struct quat {
+    float x, y, z, w;
+
+    static constexpr quat identity() { return quat{0, 0, 0, 1}; }
+};
+
+inline quat make_rotation(float axis_x, float axis_y, float axis_z, float angle) {
+    float s = std::sin(angle / 2);
+    return quat{axis_x * s, axis_y * s, axis_z * s, std::cos(angle / 2)};
+}
+
+inline quat operator*(const quat& a, const quat& b) {
+    return quat{
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+}
+
+// transforms stored as structure of arrays, so a batch update loads
+// one register per component instead of gathering from every object
+class transform_soa {
+public:
+    void resize(std::size_t count) {
+        for (auto* v : components()) {
+            v->resize(count);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            rotation_w[i] = 1;
+            scale[i] = 1;
+        }
+    }
+    std::size_t size() const { return position_x.size(); }
+    void set_position(std::size_t i, float x, float y, float z) {
+        position_x[i] = x;
+        position_y[i] = y;
+        position_z[i] = z;
+    }
+    void set_rotation(std::size_t i, quat q) {
+        rotation_x[i] = q.x;
+        rotation_y[i] = q.y;
+        rotation_z[i] = q.z;
+        rotation_w[i] = q.w;
+    }
+    void set_scale(std::size_t i, float s) { scale[i] = s; }
+
+    std::vector<float> position_x, position_y, position_z;
+    std::vector<float> rotation_x, rotation_y, rotation_z, rotation_w;
+    std::vector<float> scale;
+
+private:
+    std::array<std::vector<float>*, 8> components() {
+        return {&position_x, &position_y, &position_z,
+                &rotation_x, &rotation_y, &rotation_z, &rotation_w,
+                &scale};
+    }
+};
+
+namespace simd {
+
+struct scalar_lanes {
+    static constexpr std::size_t width = 1;
+    float v;
+    static scalar_lanes load(const float* p) { return {*p}; }
+    static scalar_lanes broadcast(float f) { return {f}; }
+    void store(float* p) const { *p = v; }
+    friend scalar_lanes operator+(scalar_lanes a, scalar_lanes b) { return {a.v + b.v}; }
+    friend scalar_lanes operator-(scalar_lanes a, scalar_lanes b) { return {a.v - b.v}; }
+    friend scalar_lanes operator*(scalar_lanes a, scalar_lanes b) { return {a.v * b.v}; }
+};
+
+#if defined(__AVX2__)
+struct float_lanes {
+    static constexpr std::size_t width = 8;
+    __m256 v;
+    static float_lanes load(const float* p) { return {_mm256_loadu_ps(p)}; }
+    static float_lanes broadcast(float f) { return {_mm256_set1_ps(f)}; }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+    friend float_lanes operator+(float_lanes a, float_lanes b) { return {_mm256_add_ps(a.v, b.v)}; }
+    friend float_lanes operator-(float_lanes a, float_lanes b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend float_lanes operator*(float_lanes a, float_lanes b) { return {_mm256_mul_ps(a.v, b.v)}; }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct float_lanes {
+    static constexpr std::size_t width = 4;
+    __m128 v;
+    static float_lanes load(const float* p) { return {_mm_loadu_ps(p)}; }
+    static float_lanes broadcast(float f) { return {_mm_set1_ps(f)}; }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+    friend float_lanes operator+(float_lanes a, float_lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+    friend float_lanes operator-(float_lanes a, float_lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+    friend float_lanes operator*(float_lanes a, float_lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+};
+#elif defined(__ARM_NEON)
+struct float_lanes {
+    static constexpr std::size_t width = 4;
+    float32x4_t v;
+    static float_lanes load(const float* p) { return {vld1q_f32(p)}; }
+    static float_lanes broadcast(float f) { return {vdupq_n_f32(f)}; }
+    void store(float* p) const { vst1q_f32(p, v); }
+    friend float_lanes operator+(float_lanes a, float_lanes b) { return {vaddq_f32(a.v, b.v)}; }
+    friend float_lanes operator-(float_lanes a, float_lanes b) { return {vsubq_f32(a.v, b.v)}; }
+    friend float_lanes operator*(float_lanes a, float_lanes b) { return {vmulq_f32(a.v, b.v)}; }
+};
+#else
+using float_lanes = scalar_lanes;
+#endif
+
+// computes view_projection * translate * rotate * scale * mesh for objects
+// [begin, end) in steps of L::width, returns the first index not processed;
+// mesh is an affine matrix shared by all objects, e.g. the dequantization
+// of the vertex positions
+template <class L>
+std::size_t compose_transforms(const mat4& view_projection,
+                               const transform_soa& transforms,
+                               const mat4& mesh,
+                               std::span<mat4> out,
+                               std::size_t begin, std::size_t end) {
+    auto one = L::broadcast(1.0f);
+    auto two = L::broadcast(2.0f);
+    std::array<L, 16> vp;
+    for (int i = 0; i < 16; i++) {
+        vp[i] = L::broadcast(view_projection.m[i]);
+    }
+    std::array<L, 16> local;
+    for (int i = 0; i < 16; i++) {
+        local[i] = L::broadcast(mesh.m[i]);
+    }
+
+    std::size_t i = begin;
+    for (; i + L::width <= end; i += L::width) {
+        auto px = L::load(&transforms.position_x[i]);
+        auto py = L::load(&transforms.position_y[i]);
+        auto pz = L::load(&transforms.position_z[i]);
+        auto qx = L::load(&transforms.rotation_x[i]);
+        auto qy = L::load(&transforms.rotation_y[i]);
+        auto qz = L::load(&transforms.rotation_z[i]);
+        auto qw = L::load(&transforms.rotation_w[i]);
+        auto s = L::load(&transforms.scale[i]);
+
+        auto xx = qx * qx, yy = qy * qy, zz = qz * qz;
+        auto xy = qx * qy, xz = qx * qz, yz = qy * qz;
+        auto wx = qw * qx, wy = qw * qy, wz = qw * qz;
+
+        // model matrix columns, rotation scaled uniformly
+        std::array<std::array<L, 3>, 4> model{{
+            {(one - two * (yy + zz)) * s, two * (xy + wz) * s, two * (xz - wy) * s},
+            {two * (xy - wz) * s, (one - two * (xx + zz)) * s, two * (yz + wx) * s},
+            {two * (xz + wy) * s, two * (yz - wx) * s, (one - two * (xx + yy)) * s},
+            {px, py, pz},
+        }};
+        std::array<std::array<L, 3>, 4> model_mesh;
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 3; r++) {
+                model_mesh[c][r] = model[0][r] * local[c * 4 + 0] +
+                                   model[1][r] * local[c * 4 + 1] +
+                                   model[2][r] * local[c * 4 + 2];
+            }
+        }
+        for (int r = 0; r < 3; r++) {
+            model_mesh[3][r] = model_mesh[3][r] + model[3][r];
+        }
+
+        alignas(32) std::array<std::array<float, L::width>, 16> lanes;
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                auto v = vp[0 * 4 + r] * model_mesh[c][0] +
+                         vp[1 * 4 + r] * model_mesh[c][1] +
+                         vp[2 * 4 + r] * model_mesh[c][2];
+                if (c == 3) {
+                    v = v + vp[3 * 4 + r];
+                }
+                v.store(lanes[c * 4 + r].data());
+            }
+        }
+        for (std::size_t l = 0; l < L::width; l++) {
+            for (int e = 0; e < 16; e++) {
+                out[i + l].m[e] = lanes[e][l];
+            }
+        }
+    }
+    return i;
+}
+
+} // namespace simd
+
+// objects [begin, end), so ranges can be composed on different threads
+inline void compose_transforms(const mat4& view_projection,
+                               const transform_soa& transforms,
+                               const mat4& mesh,
+                               std::span<mat4> out,
+                               std::size_t begin, std::size_t end) {
+    auto i = simd::compose_transforms<simd::float_lanes>(
+        view_projection, transforms, mesh, out, begin, end);
+    simd::compose_transforms<simd::scalar_lanes>(
+        view_projection, transforms, mesh, out, i, end);
+}
+
+inline void compose_transforms(const mat4& view_projection,
+                               const transform_soa& transforms,
+                               const mat4& mesh,
+                               std::span<mat4> out) {
+    compose_transforms(view_projection, transforms, mesh, out, 0,
+                       std::min(transforms.size(), out.size()));
+}
+
+} // namespace vulkan_start
@@ -0,0 +1,33 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace vulkan_start {
+constinit thread_local uint64_t heap_allocation_count{0};
+}
+
+#ifdef VULKAN_START_COUNT_ALLOCATIONS
+
+// counts every heap allocation of the calling thread for
+// add_frame_allocation_check, the array and nothrow forms forward to these
+void* operator new(std::size_t size) {
+    vulkan_start::heap_allocation_count++;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    vulkan_start::heap_allocation_count++;
+    auto align = static_cast<std::size_t>(alignment);
+    size = (size + align - 1) / align * align;
+    if (void* p = std::aligned_alloc(align, size == 0 ? align : size)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
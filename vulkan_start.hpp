@@ -1,9 +1,23 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <numeric>
 #include <string>
+#include <thread>
 #include <vulkan_helper.hpp>
 
+#include "allocation_check.hpp"
+#include "clock.hpp"
+#include "input_queue.hpp"
+#include "job_system.hpp"
+#include "latency_histogram.hpp"
+#include "profile.hpp"
+
 namespace vulkan_start {
 
 using namespace vulkan_hpp_helper;
@@ -11,6 +25,7 @@ enum class platform {
     win32,
     wayland,
     display,
+    headless,
 };
 
 template <class T> class rename_images : public T {
@@ -51,6 +66,13 @@ public:
     add_window() = delete;
 };
 
+template<class T>
+class add_frame_pacing : public T
+{
+public:
+    add_frame_pacing() = delete;
+};
+
 };
 
 template <class T>
@@ -83,15 +105,194 @@ class add_swapchain_image_extent
 #else
 #include "vulkan_start_wayland.hpp"
 #include "cube_display.hpp"
+#include "vulkan_start_headless.hpp"
 #endif
 
 namespace vulkan_start {
 using namespace vulkan_hpp_helper;
 using namespace std::literals;
 
+// the event loop runs the app from its constructor and is left out of the
+// profile, which would otherwise time the whole run as its startup
 template <platform PLATFORM, template<typename> typename C> class run_on_platform
   : public
-  use_platform<PLATFORM>::template add_event_loop<
+  typename use_platform<PLATFORM>::template add_event_loop<
+  profiled<
+  typename use_platform<PLATFORM>::template add_frame_pacing<
+  add_replay<
+  C<
+	add_instance<
+	typename use_platform<PLATFORM>::template add_platform_needed_extensions<
+	add_surface_extension<
+	add_empty_extensions<
+	typename use_platform<PLATFORM>::template add_window<
+  empty_class
+  >>>>>>>>>>
+{};
+
+// runs draw() of the app on its own thread. the window system callbacks of
+// the event loop above only stamp their events and push them to a lock free
+// ring, the render thread applies them before each frame, so a blocked
+// present or fence wait never stalls event dispatch and the other way round.
+// an app that tracks damage is only drawn when it needs to be, in between the
+// render thread sleeps until the next event. where the window can block on
+// its events, the event loop's draw() does that and the render thread wakes
+// it when it fails
+template<class T>
+class add_render_thread : public T {
+public:
+    using parent = T;
+    add_render_thread(const configure auto& conf) : parent{conf},
+        m_resize_overflow{false}, m_overflowed_size{0}, m_dropped_event_count{0},
+        m_input_queue_delay{}, m_event_sequence{0}, m_failed{false} {
+        // from now on the render thread only learns the window size from
+        // resize events
+        if constexpr (requires { parent::set_surface_resolution(0, 0); }) {
+            auto [width, height] = parent::get_surface_resolution();
+            parent::set_surface_resolution(width, height);
+        }
+        m_thread = std::jthread{[this](std::stop_token stop) { render(stop); }};
+    }
+    ~add_render_thread() {
+        m_thread.request_stop();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+    // called by the event loop, it waits for window system events and
+    // rethrows what the render thread threw
+    void draw() {
+        if (m_failed.load(std::memory_order_acquire)) {
+            std::rethrow_exception(m_exception);
+        }
+        if constexpr (requires { parent::wait_for_events(); }) {
+            parent::wait_for_events();
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+    }
+    void recreate_surface() {
+        push(input_event_type::resize, 0, 0);
+    }
+    // a resize to the window size the event thread saw
+    void recreate_surface(int width, int height) {
+        push(input_event_type::resize, width, height);
+    }
+    void process_key_event(int key, int state) {
+        push(input_event_type::key, key, state);
+    }
+    void process_pointer_motion_event(uint32_t x, uint32_t y) {
+        push(input_event_type::pointer_motion, x, y);
+    }
+    void process_pointer_button_event(int button, int button_state) {
+        push(input_event_type::pointer_button, button, button_state);
+    }
+    void process_pointer_axis_event(uint32_t axis, int value) {
+        push(input_event_type::pointer_axis, axis, value);
+    }
+    auto get_dropped_input_event_count() {
+        return m_dropped_event_count.load(std::memory_order_relaxed);
+    }
+    // time the last event spent in the ring, only valid on the render thread
+    auto get_input_queue_delay() {
+        return m_input_queue_delay;
+    }
+private:
+    void push(input_event_type type, int32_t a, int32_t b) {
+        auto event = input_event{type, std::chrono::steady_clock::now(), a, b};
+        if (!m_queue.try_push(event)) {
+            // a resize must not get lost, input may
+            if (type == input_event_type::resize) {
+                m_overflowed_size.store(pack_size(a, b), std::memory_order_relaxed);
+                m_resize_overflow.store(true, std::memory_order_release);
+            } else {
+                m_dropped_event_count.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        wake();
+    }
+    void wake() {
+        m_event_sequence.fetch_add(1, std::memory_order_release);
+        m_event_sequence.notify_one();
+    }
+    static uint64_t pack_size(int32_t width, int32_t height) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(width)) << 32 |
+               static_cast<uint32_t>(height);
+    }
+    // the size of a resize event, 0 by 0 when it carried none
+    void resize(int32_t width, int32_t height) {
+        if constexpr (requires { parent::set_surface_resolution(width, height); }) {
+            if (width > 0 && height > 0) {
+                parent::set_surface_resolution(width, height);
+            }
+        }
+        parent::recreate_surface();
+    }
+    void render(std::stop_token stop) {
+        std::stop_callback wake_on_stop{stop, [this] { wake(); }};
+        try {
+            while (!stop.stop_requested()) {
+                uint32_t seen_events = m_event_sequence.load(std::memory_order_acquire);
+                // a paced frame starts late, and the input it applies with it
+                if constexpr (requires { parent::wait_for_frame_start(); }) {
+                    parent::wait_for_frame_start();
+                }
+                input_event event;
+                while (m_queue.try_pop(event)) {
+                    m_input_queue_delay = std::chrono::steady_clock::now() - event.timestamp;
+                    if (event.type == input_event_type::resize) {
+                        resize(event.a, event.b);
+                        continue;
+                    }
+                    if constexpr (input_event_processable<parent>) {
+                        parent::process_input_event(event);
+                    }
+                }
+                if (m_resize_overflow.exchange(false, std::memory_order_acq_rel)) {
+                    uint64_t size = m_overflowed_size.load(std::memory_order_relaxed);
+                    resize(static_cast<int32_t>(size >> 32), static_cast<int32_t>(size));
+                }
+                if constexpr (damage_trackable<parent>) {
+                    if (!parent::needs_redraw()) {
+                        if constexpr (requires { parent::cancel_frame_start(); }) {
+                            parent::cancel_frame_start();
+                        }
+                        m_event_sequence.wait(seen_events, std::memory_order_acquire);
+                        continue;
+                    }
+                }
+                parent::draw();
+            }
+        } catch (...) {
+            m_exception = std::current_exception();
+            m_failed.store(true, std::memory_order_release);
+            if constexpr (requires { parent::wake_event_loop(); }) {
+                parent::wake_event_loop();
+            }
+        }
+    }
+
+    spsc_ring<input_event, 256> m_queue;
+    std::atomic<bool> m_resize_overflow;
+    // size of the latest resize that didn't fit in the ring
+    std::atomic<uint64_t> m_overflowed_size;
+    std::atomic<uint64_t> m_dropped_event_count;
+    std::chrono::steady_clock::duration m_input_queue_delay;
+    // bumped for every event, the idle render thread waits on it
+    std::atomic<uint32_t> m_event_sequence;
+    std::atomic<bool> m_failed;
+    std::exception_ptr m_exception;
+    // joined first, before the state it uses is destroyed
+    std::jthread m_thread;
+};
+
+template <platform PLATFORM, template<typename> typename C> class run_on_platform_with_render_thread
+  : public
+  typename use_platform<PLATFORM>::template add_event_loop<
+  profiled<
+  add_render_thread<
+  typename use_platform<PLATFORM>::template add_frame_pacing<
+  add_replay<
   C<
 	add_instance<
 	typename use_platform<PLATFORM>::template add_platform_needed_extensions<
@@ -99,9 +300,86 @@ template <platform PLATFORM, template<typename> typename C> class run_on_platfor
 	add_empty_extensions<
 	typename use_platform<PLATFORM>::template add_window<
   empty_class
-  >>>>>>>
+  >>>>>>>>>>>
 {};
 
+// draws only when something changed: input, a resize, an animation that is
+// running or an invalidate() call. otherwise draw() returns at once and the
+// last presented image stays on screen. add_render_thread and the display
+// run loop block on their event sources while nothing needs drawing
+template<class T>
+class add_render_on_demand : public T {
+public:
+    using parent = T;
+    add_render_on_demand(const configure auto& conf) : parent{conf}, m_damaged{true} {
+    }
+    void invalidate() {
+        m_damaged = true;
+    }
+    bool needs_redraw() {
+        if constexpr (requires { parent::is_animating(); }) {
+            if (parent::is_animating()) {
+                return true;
+            }
+        }
+        return m_damaged;
+    }
+    void draw() {
+        if (!needs_redraw()) {
+            return;
+        }
+        m_damaged = false;
+        parent::draw();
+    }
+    void recreate_surface() {
+        invalidate();
+        parent::recreate_surface();
+    }
+    void process_input_event(const input_event& event) {
+        invalidate();
+        if constexpr (input_event_processable<parent>) {
+            parent::process_input_event(event);
+        }
+    }
+    void process_key_event(int key, int state) {
+        invalidate();
+        if constexpr (requires { parent::process_key_event(key, state); }) {
+            parent::process_key_event(key, state);
+        }
+    }
+    void process_pointer_motion_event(uint32_t x, uint32_t y) {
+        invalidate();
+        if constexpr (requires { parent::process_pointer_motion_event(x, y); }) {
+            parent::process_pointer_motion_event(x, y);
+        }
+    }
+    void process_pointer_button_event(int button, int button_state) {
+        invalidate();
+        if constexpr (requires { parent::process_pointer_button_event(button, button_state); }) {
+            parent::process_pointer_button_event(button, button_state);
+        }
+    }
+    void process_pointer_axis_event(uint32_t axis, int value) {
+        invalidate();
+        if constexpr (requires { parent::process_pointer_axis_event(axis, value); }) {
+            parent::process_pointer_axis_event(axis, value);
+        }
+    }
+private:
+    bool m_damaged;
+};
+
+template <template<typename> typename C>
+class on_demand {
+public:
+    template<class T>
+    class app : public add_render_on_demand<C<T>> {
+    public:
+        using parent = add_render_on_demand<C<T>>;
+        app(const configure auto& conf) : parent{conf} {}
+    };
+};
+
 template <std::invocable<> CALL, class T> class add_file_path : public T {
 public:
     auto get_file_path() { return CALL{}(); }
@@ -124,30 +402,94 @@ template <std::invocable<> CALL, vk::ShaderStageFlagBits STAGE, class T> class a
     >>>>>>>>>>>
 {};
 
+// same as add_spirv_file_to_pipeline_stages, but the file is read and the
+// shader module created on the job system from construction on, which only
+// needs the device. get_pipeline_stages() waits for it, so placed right
+// above the device the work overlaps with the swapchain, depth images and
+// pipeline layout built in between
+template <std::invocable<> CALL, vk::ShaderStageFlagBits STAGE, class T>
+class add_deferred_spirv_file_to_pipeline_stages : public T {
+public:
+    using parent = T;
+    add_deferred_spirv_file_to_pipeline_stages(const configure auto& conf) : parent{conf},
+        m_shader_module{parent::get_job_system(), [device = vk::Device{parent::get_device()}] {
+            return create_shader_module(device, CALL{}());
+        }} {
+    }
+    ~add_deferred_spirv_file_to_pipeline_stages() {
+        // not created if it threw and a layer above never called get()
+        if (m_shader_module.has_value()) {
+            vk::Device device = parent::get_device();
+            device.destroyShaderModule(m_shader_module.get());
+        }
+    }
+    auto get_pipeline_stages() {
+        auto stages = parent::get_pipeline_stages();
+        stages.push_back(vk::PipelineShaderStageCreateInfo{}
+                             .setStage(STAGE)
+                             .setModule(m_shader_module.get())
+                             .setPName("main"));
+        return stages;
+    }
+private:
+    static vk::ShaderModule create_shader_module(vk::Device device, const std::string& path) {
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        if (!file) {
+            throw std::runtime_error{"failed to open " + path};
+        }
+        auto size = static_cast<size_t>(file.tellg());
+        if (size == 0 || size % sizeof(uint32_t) != 0) {
+            throw std::runtime_error{"not a spirv file " + path};
+        }
+        std::vector<uint32_t> code(size / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(code.data()), size);
+        return device.createShaderModule(vk::ShaderModuleCreateInfo{}.setCode(code));
+    }
+    deferred<vk::ShaderModule> m_shader_module;
+};
+
 using namespace std::chrono;
+// taken during static initialization, the start of the startup time
+inline const auto process_start_time = steady_clock::now();
+
+// measures cpu frame time, and every few seconds logs its percentiles next
+// to the present and input to photon latencies of layers below that
+// measure them. it also logs how long the first frame took to start and
+// reports what is left when the app ends, so short runs get numbers too
 template<class T>
 class add_frame_time_analyser : public T{
 public:
     using parent = T;
+    static constexpr auto report_interval = 5s;
     add_frame_time_analyser(const configure auto& conf) : parent{conf},
-        m_frame_time{}, m_frame_index{}, m_last_time_point{}, m_previous_index{}{
+        m_frame_time{}, m_frame_index{}, m_last_time_point{}, m_previous_index{},
+        m_last_frame_start{}, m_last_report{steady_clock::now()}{
+    }
+    ~add_frame_time_analyser() {
+        if (m_frame_times.get_count() > 0) {
+            report();
+        }
     }
     void draw() {
         auto now = steady_clock::now();
+        if (m_frame_index == 0) {
+            std::clog << "startup " << duration<double, std::milli>{now - process_start_time}.count()
+                << "ms" << std::endl;
+        }
         if (now - m_last_time_point > 500ms && m_previous_index != m_frame_index) {
             m_frame_time = (now - m_last_time_point) / (m_frame_index - m_previous_index);
-            double fps = 1000000000.0/m_frame_time.count();
-            /*std::clog
-                << "frame time: "
-                << std::setw(10)
-                << m_frame_time.count()/1000000.0
-                << "ms"
-                << "fps: "
-                << fps
-                << "\t\r";*/
             m_last_time_point = now;
             m_previous_index = m_frame_index;
         }
+        if (m_frame_index > 0) {
+            m_frame_times.record(now - m_last_frame_start);
+        }
+        m_last_frame_start = now;
+        if (now - m_last_report > report_interval) {
+            report();
+            m_last_report = now;
+        }
 
         parent::draw();
 
@@ -157,10 +499,79 @@ public:
         return m_frame_time;
     }
 private:
+    void report() {
+        log("frame time", m_frame_times);
+        m_frame_times.clear();
+        if constexpr (present_latency_collectable<parent>) {
+            parent::collect_present_latencies(m_present_latencies, m_input_to_photon_latencies);
+            log(", present latency", m_present_latencies);
+            log(", input to photon", m_input_to_photon_latencies);
+        }
+        std::clog << std::endl;
+    }
+    static void log(const char* name, const latency_histogram& histogram) {
+        auto ms = [](nanoseconds t) { return t.count() / 1000000.0; };
+        std::clog << name << " p50 " << ms(histogram.get_percentile(0.5))
+            << "ms p99 " << ms(histogram.get_percentile(0.99))
+            << "ms max " << ms(histogram.get_max())
+            << "ms (" << histogram.get_count() << ")";
+    }
     nanoseconds m_frame_time;
     uint64_t m_frame_index;
     time_point<steady_clock, nanoseconds> m_last_time_point;
     uint64_t m_previous_index;
+    time_point<steady_clock, nanoseconds> m_last_frame_start;
+    time_point<steady_clock, nanoseconds> m_last_report;
+    latency_histogram m_frame_times;
+    latency_histogram m_present_latencies;
+    latency_histogram m_input_to_photon_latencies;
 };
 
+// owns the job system of the app, layers above share it for their parallel
+// work through get_job_system()
+template<class T>
+class add_job_system : public T{
+public:
+    using parent = T;
+    add_job_system(const configure auto& conf) : parent{conf}, m_job_system{}{
+    }
+    job_system& get_job_system() {
+        return m_job_system;
+    }
+private:
+    job_system m_job_system;
+};
+
+inline uint32_t find_memory_type_index(vk::PhysicalDevice physical_device,
+                                       uint32_t memory_type_bits,
+                                       vk::MemoryPropertyFlags properties) {
+    auto memory_properties = physical_device.getMemoryProperties();
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        if ((memory_type_bits & (1u << i)) &&
+            (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error{"failed to find suitable memory type"};
+}
+
+// records with `record` into a temporary command buffer and waits for it,
+// for one time initialization of resources created by a layer
+template <std::invocable<vk::CommandBuffer> F>
+void water_chika_vulkan_submit_once(vk::Device device, vk::Queue queue,
+                                    vk::CommandPool cmd_pool, F record) {
+  auto cmds = device.allocateCommandBuffers(
+      vk::CommandBufferAllocateInfo{}
+          .setCommandPool(cmd_pool)
+          .setLevel(vk::CommandBufferLevel::ePrimary)
+          .setCommandBufferCount(1));
+  auto cmd = cmds[0];
+  cmd.begin(vk::CommandBufferBeginInfo{});
+  record(cmd);
+  cmd.end();
+  queue.submit(vk::SubmitInfo{}.setCommandBuffers(cmd));
+  queue.waitIdle();
+  device.freeCommandBuffers(cmd_pool, cmd);
+}
+
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdexcept>
+
+#include <vulkan_helper.hpp>
+
+#include "cube_display.hpp"
+
+namespace vulkan_start{
+
+// presents to a VK_EXT_headless_surface, which shows nothing, so a run
+// needs neither a compositor nor a display: what CI on a software device
+// like lavapipe wants. it runs on add_run_loop like the display platform
+template<>
+class use_platform<platform::headless> {
+public:
+template <class T> class add_vulkan_surface : public T {
+public:
+  using parent = T;
+  static constexpr auto default_extent = vk::Extent2D{1280, 720};
+  add_vulkan_surface(const configure auto& conf) : parent{conf}, m_surface_extent{default_extent} {
+      if constexpr (requires { conf.image_width; conf.image_height; }) {
+          if (conf.image_width != 0 && conf.image_height != 0) {
+              m_surface_extent = vk::Extent2D{conf.image_width, conf.image_height};
+          }
+      }
+      create_surface();
+  }
+  ~add_vulkan_surface() {
+      destroy_surface();
+  }
+  void create_surface() {
+      auto instance = parent::get_instance();
+      m_surface = instance.createHeadlessSurfaceEXT(vk::HeadlessSurfaceCreateInfoEXT{});
+  }
+  void destroy_surface() {
+      auto instance = parent::get_instance();
+      instance.destroySurfaceKHR(m_surface);
+  }
+  auto get_surface() { return m_surface; }
+  // the surface has no size of its own, it is the configured one
+  auto get_surface_resolution() { return m_surface_extent; }
+
+private:
+  vk::SurfaceKHR m_surface;
+  vk::Extent2D m_surface_extent;
+}; // class add_vulkan_surface
+
+
+template<class T>
+class add_platform_needed_extensions : public T {
+public:
+  using parent = T;
+  add_platform_needed_extensions(const configure auto& conf) : parent{conf} {
+  }
+  auto get_extensions() {
+    auto ext = T::get_extensions();
+    ext.push_back(vk::EXTHeadlessSurfaceExtensionName);
+    return ext;
+  }
+}; // class add_platform_needed_extensions
+
+template<class T>
+class add_event_loop : public add_run_loop<T> {
+public:
+    using parent = add_run_loop<T>;
+    add_event_loop(const configure auto& conf) : parent{conf} {
+    }
+}; // class add_event_loop
+
+// nothing is shown, so frames are drawn back to back unless the app sets a
+// rate with set_target_frame_rate
+template<class T>
+class add_window : public block_run_loop_signals<T> {
+public:
+    using parent = block_run_loop_signals<T>;
+    add_window(const configure auto& conf) : parent{conf} {}
+    static constexpr uint32_t get_target_frame_rate() { return 0; }
+};
+
+// there is no refresh to pace to
+template<class T>
+class add_frame_pacing : public T {
+public:
+    using parent = T;
+    add_frame_pacing(const configure auto& conf) : parent{conf} {}
+};
+
+}; // class use_platform<platform::headless>
+
+template<>
+class use_platform_add_swapchain_image_extent<platform::headless> {
+public:
+template<class T>
+class add_swapchain_image_extent
+    : public add_swapchain_image_extent_equal_surface_resolution<T> {
+};
+};
+
+} //namespace vulkan_start
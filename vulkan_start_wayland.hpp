@@ -1,6 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include <wayland_helper.hpp>
+#include "presentation-time-client-protocol.h"
+#include "input_queue.hpp"
+#include "latency_histogram.hpp"
 
 #include <xkb_helper.hpp>
 #include <posix.hpp>
@@ -65,7 +81,13 @@ public:
         th->size_changed(width, height);
     }
     void size_changed(int width, int height) {
-        parent::recreate_surface();
+        // a render thread takes the size with the resize, it must not read
+        // the window's own while this thread updates it
+        if constexpr (requires { parent::recreate_surface(width, height); }) {
+            parent::recreate_surface(width, height);
+        } else {
+            parent::recreate_surface();
+        }
     }
 };
 
@@ -248,14 +270,316 @@ using add_pollfds_loop =
       T>>>>>>>>>>>>>>>>>
 ; // template add_pollfds
 
+// the window, and for add_render_thread a way to block the event thread
+// until the display has events or the render thread wakes it
 template<class T>
 class add_window : public wayland_helper::add_wayland_surface<T>
 {
 public:
     using parent = wayland_helper::add_wayland_surface<T>;
-    add_window(const configure auto& conf) : parent{conf} {}
+    add_window(const configure auto& conf) : parent{conf} {
+        m_wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (m_wakeup_fd < 0) {
+            throw std::runtime_error{"failed to create eventfd"};
+        }
+    }
+    ~add_window() {
+        close(m_wakeup_fd);
+    }
+    // reads and dispatches the display's events, blocking until there are
+    // some or wake_event_loop() is called
+    void wait_for_events() {
+        wl_display* display = parent::get_wayland_display();
+        while (wl_display_prepare_read(display) != 0) {
+            wl_display_dispatch_pending(display);
+        }
+        wl_display_flush(display);
+        auto fds = std::array{
+            pollfd{.fd = wl_display_get_fd(display), .events = POLLIN},
+            pollfd{.fd = m_wakeup_fd, .events = POLLIN},
+        };
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+            wl_display_cancel_read(display);
+            throw std::runtime_error{"failed to poll the wayland display"};
+        }
+        if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(display) < 0) {
+                throw std::runtime_error{"failed to read wayland display events"};
+            }
+        } else {
+            wl_display_cancel_read(display);
+        }
+        if (fds[1].revents & POLLIN) {
+            // another read may have taken the count already
+            uint64_t count;
+            if (read(m_wakeup_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                throw std::runtime_error{"failed to read the event loop wakeup"};
+            }
+        }
+        wl_display_dispatch_pending(display);
+    }
+    // callable from any thread
+    void wake_event_loop() {
+        uint64_t one = 1;
+        // a full counter has a wakeup pending already
+        if (write(m_wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            throw std::runtime_error{"failed to wake the event loop"};
+        }
+    }
+private:
+    int m_wakeup_fd;
 }; // class add_window
 
+// starts each frame just in time for the compositor's next refresh. it binds
+// wp_presentation, asks for feedback on every commit and learns from the
+// presented timestamps when refreshes happen and how long a frame takes from
+// its start to being shown; draw() sleeps until that long before the next
+// refresh, so time and input are sampled as late as possible. the budget
+// grows by an eighth of a refresh on a missed refresh and shrinks slowly
+// while frames make it. without wp_presentation, with a presentation clock
+// other than CLOCK_MONOTONIC, or with frame_pacing configured off, frames
+// start right away. the presented timestamps also go to the layers below
+// that measure presents, as the time the frame's present was shown.
+// feedback events arrive on the thread dispatching the display, which may
+// not be the one drawing
+template<class T>
+class add_frame_pacing : public T {
+public:
+    using parent = T;
+    add_frame_pacing(const configure auto& conf) : parent{conf},
+        m_presentation{nullptr}, m_clock_id{CLOCK_MONOTONIC}, m_next_slot{0},
+        m_refresh{}, m_last_presented{}, m_budget{std::chrono::milliseconds{4}},
+        m_frame_started{false} {
+        if constexpr (requires { conf.frame_pacing; }) {
+            if (!conf.frame_pacing) {
+                return;
+            }
+        }
+        wl_display* display = parent::get_wayland_display();
+        wl_event_queue* queue = wl_display_create_queue(display);
+        wl_registry* registry = wl_display_get_registry(display);
+        wl_proxy_set_queue(reinterpret_cast<wl_proxy*>(registry), queue);
+        wl_registry_add_listener(registry, &registry_listener, this);
+        // the first roundtrip binds, the second delivers clock_id
+        wl_display_roundtrip_queue(display, queue);
+        if (m_presentation) {
+            wp_presentation_add_listener(m_presentation, &presentation_listener, this);
+            wl_display_roundtrip_queue(display, queue);
+            // feedback is dispatched with the rest of the window's events
+            wl_proxy_set_queue(reinterpret_cast<wl_proxy*>(m_presentation), nullptr);
+        }
+        wl_registry_destroy(registry);
+        wl_event_queue_destroy(queue);
+        if (m_presentation && m_clock_id != CLOCK_MONOTONIC) {
+            std::clog << "wp_presentation clock is not CLOCK_MONOTONIC, frames are not paced" << std::endl;
+        }
+    }
+    ~add_frame_pacing() {
+        for (auto& slot : m_slots) {
+            if (slot.feedback) {
+                wp_presentation_feedback_destroy(slot.feedback);
+            }
+        }
+        if (m_presentation) {
+            wp_presentation_destroy(m_presentation);
+        }
+    }
+    // sleeps until the frame should start, once per frame; add_render_thread
+    // calls it before it applies queued input
+    void wait_for_frame_start() {
+        if (m_frame_started) {
+            return;
+        }
+        m_frame_started = true;
+        auto now = std::chrono::steady_clock::now();
+        auto start = now;
+        {
+            std::lock_guard lock{m_mutex};
+            if (m_refresh.count() > 0 && m_last_presented != std::chrono::steady_clock::time_point{}) {
+                auto refreshes = (now + m_budget - m_last_presented + m_refresh - std::chrono::nanoseconds{1}) / m_refresh;
+                m_target = m_last_presented + refreshes * m_refresh;
+                start = m_target - m_budget;
+            } else {
+                m_target = {};
+            }
+        }
+        if (start > now) {
+            std::this_thread::sleep_until(start);
+        }
+    }
+    // the frame wait_for_frame_start() waited for is not drawn, the next
+    // one starts from a fresh target
+    void cancel_frame_start() {
+        m_frame_started = false;
+    }
+    void draw() {
+        wait_for_frame_start();
+        m_frame_started = false;
+        bool redraw = true;
+        if constexpr (damage_trackable<parent>) {
+            redraw = parent::needs_redraw();
+        }
+        feedback_slot* slot = nullptr;
+        if (redraw && m_presentation && m_clock_id == CLOCK_MONOTONIC) {
+            slot = &request_feedback();
+        }
+        uint64_t present_count = 0;
+        if constexpr (requires { parent::get_present_count(); }) {
+            present_count = parent::get_present_count();
+        }
+        parent::draw();
+        if constexpr (requires { parent::get_present_count(); }) {
+            // nothing was committed, e.g. acquire failed: the feedback would
+            // go with the next frame's commit and its target
+            if (slot && parent::get_present_count() == present_count) {
+                drop_feedback(*slot);
+                slot = nullptr;
+            }
+        }
+        if constexpr (presentation_recordable<parent>) {
+            if (slot) {
+                set_present(*slot, parent::get_last_present());
+            }
+        }
+    }
+    auto get_refresh_interval() {
+        std::lock_guard lock{m_mutex};
+        return m_refresh;
+    }
+    auto get_frame_budget() {
+        std::lock_guard lock{m_mutex};
+        return m_budget;
+    }
+private:
+    struct feedback_slot {
+        add_frame_pacing* pacing;
+        wp_presentation_feedback* feedback;
+        std::chrono::steady_clock::time_point target;
+        // the frame's present, known once its draw() returned
+        present_timing present;
+        bool present_known;
+        // when the feedback came before that
+        std::chrono::steady_clock::time_point presented;
+    };
+    // the feedback applies to the next commit of the surface, which is the
+    // present of this frame
+    feedback_slot& request_feedback() {
+        std::lock_guard lock{m_mutex};
+        auto& slot = m_slots[m_next_slot];
+        if (slot.feedback) {
+            // the compositor is far behind, give up on the oldest
+            wp_presentation_feedback_destroy(slot.feedback);
+        }
+        m_next_slot = (m_next_slot + 1) % m_slots.size();
+        slot.pacing = this;
+        slot.target = m_target;
+        slot.present_known = false;
+        slot.presented = {};
+        slot.feedback = wp_presentation_feedback(m_presentation, parent::get_wayland_surface());
+        wp_presentation_feedback_add_listener(slot.feedback, &feedback_listener, &slot);
+        return slot;
+    }
+    void drop_feedback(feedback_slot& slot) {
+        std::lock_guard lock{m_mutex};
+        // events for it are ignored from now on
+        wp_presentation_feedback_destroy(slot.feedback);
+        slot.feedback = nullptr;
+    }
+    // whichever of the present and its feedback comes second records it
+    void set_present(feedback_slot& slot, const present_timing& present) {
+        std::lock_guard lock{m_mutex};
+        if (slot.presented != std::chrono::steady_clock::time_point{}) {
+            parent::record_presentation(present, slot.presented);
+            slot.presented = {};
+        } else {
+            slot.present = present;
+            slot.present_known = true;
+        }
+    }
+    void presented(feedback_slot& slot, std::chrono::steady_clock::time_point time,
+                   std::chrono::nanoseconds refresh) {
+        std::lock_guard lock{m_mutex};
+        m_last_presented = time;
+        if (refresh.count() > 0) {
+            m_refresh = refresh;
+        }
+        if (slot.target != std::chrono::steady_clock::time_point{} && m_refresh.count() > 0) {
+            if (time > slot.target + m_refresh / 2) {
+                m_budget += m_refresh / 8;
+            } else {
+                m_budget -= std::chrono::microseconds{50};
+            }
+            m_budget = std::clamp<std::chrono::nanoseconds>(m_budget, std::chrono::milliseconds{1}, 2 * m_refresh);
+        }
+        if constexpr (presentation_recordable<parent>) {
+            if (slot.present_known) {
+                parent::record_presentation(slot.present, time);
+                slot.present_known = false;
+            } else {
+                slot.presented = time;
+            }
+        }
+        wp_presentation_feedback_destroy(slot.feedback);
+        slot.feedback = nullptr;
+    }
+    void discarded(feedback_slot& slot) {
+        std::lock_guard lock{m_mutex};
+        wp_presentation_feedback_destroy(slot.feedback);
+        slot.feedback = nullptr;
+    }
+
+    static void registry_global(void* data, wl_registry* registry, uint32_t name,
+                                const char* interface, uint32_t version) {
+        auto th = reinterpret_cast<add_frame_pacing*>(data);
+        if (std::strcmp(interface, wp_presentation_interface.name) == 0) {
+            th->m_presentation = reinterpret_cast<wp_presentation*>(
+                wl_registry_bind(registry, name, &wp_presentation_interface, 1));
+        }
+    }
+    static void registry_global_remove(void*, wl_registry*, uint32_t) {}
+    static void presentation_clock_id(void* data, wp_presentation*, uint32_t clock_id) {
+        reinterpret_cast<add_frame_pacing*>(data)->m_clock_id = clock_id;
+    }
+    static void feedback_sync_output(void*, wp_presentation_feedback*, wl_output*) {}
+    static void feedback_presented(void* data, wp_presentation_feedback*,
+                                   uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+                                   uint32_t refresh, uint32_t, uint32_t, uint32_t) {
+        auto& slot = *reinterpret_cast<feedback_slot*>(data);
+        auto seconds = (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+        // steady_clock is CLOCK_MONOTONIC
+        auto time = std::chrono::steady_clock::time_point{
+            std::chrono::seconds{seconds} + std::chrono::nanoseconds{tv_nsec}};
+        slot.pacing->presented(slot, time, std::chrono::nanoseconds{refresh});
+    }
+    static void feedback_discarded(void* data, wp_presentation_feedback*) {
+        auto& slot = *reinterpret_cast<feedback_slot*>(data);
+        slot.pacing->discarded(slot);
+    }
+    static constexpr wl_registry_listener registry_listener{
+        .global = registry_global,
+        .global_remove = registry_global_remove,
+    };
+    static constexpr wp_presentation_listener presentation_listener{
+        .clock_id = presentation_clock_id,
+    };
+    static constexpr wp_presentation_feedback_listener feedback_listener{
+        .sync_output = feedback_sync_output,
+        .presented = feedback_presented,
+        .discarded = feedback_discarded,
+    };
+
+    wp_presentation* m_presentation;
+    uint32_t m_clock_id;
+    std::array<feedback_slot, 8> m_slots{};
+    uint32_t m_next_slot;
+    std::mutex m_mutex;
+    std::chrono::nanoseconds m_refresh;
+    std::chrono::steady_clock::time_point m_last_presented;
+    std::chrono::nanoseconds m_budget;
+    std::chrono::steady_clock::time_point m_target;
+    bool m_frame_started;
+}; // class add_frame_pacing
+
 }; // use_platform<platform::wayland>
 
 
@@ -267,8 +591,31 @@ class add_swapchain_image_extent
     : public add_swapchain_image_extent_equal_surface_resolution<T> {
 public:
     using parent = add_swapchain_image_extent_equal_surface_resolution<T>;
-    add_swapchain_image_extent(const configure auto& conf) : parent{conf} {
+    add_swapchain_image_extent(const configure auto& conf) : parent{conf}, m_extent{},
+        m_resolution{} {
+        if constexpr (requires { conf.image_width; conf.image_height; }) {
+            m_extent = vk::Extent2D{conf.image_width, conf.image_height};
+        }
+    }
+    // the buffer size is the window size on wayland, so a configured size
+    // sizes the window
+    vk::Extent2D get_swapchain_image_extent() {
+        if (m_extent.width != 0 && m_extent.height != 0) {
+            return m_extent;
+        }
+        if (m_resolution.width != 0 && m_resolution.height != 0) {
+            return m_resolution;
+        }
+        return parent::get_swapchain_image_extent();
     }
+    // the window size as a resize event carried it, used instead of the
+    // window's own by a thread that doesn't dispatch the window's events
+    void set_surface_resolution(int width, int height) {
+        m_resolution = vk::Extent2D{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+    }
+private:
+    vk::Extent2D m_extent;
+    vk::Extent2D m_resolution;
 };
 };
 
@@ -193,5 +193,11 @@ private:
 	  add_window_process<
     empty_class>>>>>> m_window;
 }; // class add_window
+
+template <class T> class add_frame_pacing : public T {
+public:
+    using parent = T;
+    add_frame_pacing(const configure auto& conf) : parent{conf} {}
+}; // class add_frame_pacing
 }; // class use_platform<platform::win32>
 } // namespace vulkan_start